@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+/* The six planes of a view-projection, for rejecting what cannot be seen before it is drawn.
+ * Tests are conservative: they may keep something that is out of view near the corners, never the other way.
+ */
+class Frustum {
+private:
+	/* a, b, c, d of the left, right, bottom, top, near and far planes: the inside is where a x + b y + c z + d >= 0 */
+	float planes[6][4];
+
+public:
+	explicit Frustum(glm::mat4 const &vp);
+
+	/* Replaces visible with the indices of the spheres (center xyz, radius w) that may be seen, in order.
+	 * Tests four spheres at a time where SSE is.
+	 */
+	void test_spheres(glm::vec4 const *spheres, size_t count, std::vector<size_t> &visible) const;
+	/* Whether the box may be seen: false only if it is entirely outside one of the planes */
+	bool test_box(glm::vec3 const &min, glm::vec3 const &max) const;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "gpu_profiler.hpp"
+
+#include <epoxy/egl.h>
+#include <epoxy/gl.h>
+
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/* Command line of the headless mode:
+ *   --headless [--frames N] [--size WxH] [--step PROGRESS] [--output PREFIX] [--raw] [--seed N] [--set NAME=VALUE]... [--profile PREFIX]
+ */
+struct headless_options {
+	int frames{60};
+	int width{800}, height{600};
+	/* animation progress added every frame */
+	float step{1.0f / 60};
+	/* frames are written to <output>NNNN.png, or to <output>NNNN.rgba as top-down RGBA8 rows with --raw */
+	std::string output{"frame"};
+	bool raw{false};
+	/* seed of everything random in the scene, so that runs are reproducible */
+	unsigned seed{0};
+	/* if set, the profile of the passes is written to <profile>.csv and <profile>.json */
+	std::string profile;
+	/* scene specific settings */
+	std::map<std::string, std::string> settings;
+
+	template<typename T>
+	T setting(std::string const &name, T const &fallback) const {
+		auto const it{settings.find(name)};
+		if (it == settings.end())
+			return fallback;
+		std::istringstream stream(it->second);
+		T result;
+		if (!(stream >> result))
+			throw std::invalid_argument("bad value of " + name + ": " + it->second);
+		return result;
+	}
+};
+
+/* Returns false if there is no --headless, throws std::invalid_argument on malformed options. */
+bool parse_headless_options(int argc, char **argv, headless_options &options);
+
+/* Prints the statistics of the profiler and exports them if --profile asks to, returns false with the error set on failure */
+bool write_profile(GpuProfiler &profiler, headless_options const &options, std::string &error);
+
+/* Surfaceless EGL context with an offscreen framebuffer, needs no display:
+ * on a box without a GPU Mesa renders it with llvmpipe.
+ */
+class HeadlessContext {
+private:
+	EGLDisplay display;
+	EGLContext context;
+	GLuint framebuffer, color, depth;
+	/* GL_TIMESTAMP queries around a frame */
+	GLuint timers[2];
+	int width, height;
+
+	void write_frame(std::string const &path, bool raw) const;
+
+public:
+	/* Creates and makes current the context, throws std::runtime_error on failure. */
+	HeadlessContext(int width, int height);
+	HeadlessContext(HeadlessContext const &other) = delete;
+	~HeadlessContext();
+
+	/* Calls render(progress, error) for every frame with the offscreen framebuffer bound,
+	 * prints CPU (submission) and GPU (GL_TIMESTAMP difference) time of each frame and writes the frames out.
+	 * Returns false once render does.
+	 */
+	bool run(headless_options const &options, std::function<bool(float progress, std::string &error)> const &render, std::string &error);
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "frustum.hpp"
+#include "gpu_profiler.hpp"
+#include "scene_object.hpp"
+#include "program.hpp"
+#include "uniform_blocks.hpp"
+
+#define GLM_FORCE_SWIZZLE
+#include <glm/mat4x4.hpp>
+
+#include <epoxy/gl.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/* The scene and everything drawing it, with no widgets attached:
+ * Hw2Window drives it from a Gtk::GLArea, the headless mode from an offscreen framebuffer.
+ */
+class Hw2Renderer {
+public:
+	enum display_mode_t {
+		SCENE,
+		SCENE_FROM_SUN,
+		SHADOWMAP
+	};
+
+	/* Frame state, set before gl_render */
+	float progress{0};
+	display_mode_t display_mode{SCENE};
+	/* Uploads the meshes as SceneObject::PACKED_VERTICIES, read by gl_init */
+	bool packed_verticies{true};
+	/* Largest error of the levels of detail of the bunnies on the screen, in pixels, see SceneObject::select_lod;
+	 * gl_init builds no levels with 0
+	 */
+	float lod_error{1};
+	/* Keeps the shadows of the casters that do not move in a shadow map of their own and redraws the shadow map only
+	 * when a caster moves, see gl_update_shadowmap; off, every frame draws all the casters
+	 */
+	bool shadow_cache{true};
+	glm::mat4 camera_view{1};
+
+	float const view_range{.3};
+
+	/* Times every pass of gl_render */
+	GpuProfiler profiler;
+
+private:
+	struct _gl {
+		std::unique_ptr<Program> scene_program, shadowmap_program, depth_program;
+		UniformBlocks blocks;
+
+		static GLsizei constexpr shadowmap_size{2048};
+		static float constexpr fov{60};
+		GLuint framebuffer;
+		GLuint shadowmap;
+		/* the shadows of the static casters alone, copied into shadowmap under the dynamic ones */
+		GLuint static_framebuffer;
+		GLuint static_shadowmap;
+
+		glm::vec3 light_position;
+		glm::vec3 light_color;
+		float light_power;
+
+		glm::vec3 sun_position;
+		glm::vec3 sun_color;
+		float sun_power;
+
+		glm::mat4 sun_proj, sun_view;
+
+		static int constexpr acolytes_count{6};
+		std::unique_ptr<SceneObject> statue, acolytes[acolytes_count], base_plane;
+		/* all of the above in the drawing order */
+		std::vector<SceneObject const *> objects;
+		/* the same split into the casters that stay and the animated ones, with their model matrices in the shadow maps;
+		 * no matrices means no shadow map yet
+		 */
+		std::vector<SceneObject const *> static_casters, dynamic_casters;
+		std::vector<glm::mat4> static_models, dynamic_models;
+
+		/* scratch of gl_draw_objects */
+		std::vector<glm::vec4> spheres;
+		std::vector<size_t> visible;
+	} gl;
+
+	/* Draw into a viewport height pixels high */
+	void gl_render_scene(glm::mat4 const &view, glm::mat4 const &proj, int height);
+	/* Brings gl.shadowmap up to date with the casters, with the viewport of the shadow map set; leaves gl.framebuffer bound */
+	void gl_update_shadowmap();
+	/* The shadow map as colors, with the full program */
+	void gl_render_shadowmap();
+	/* Draws the objects the camera may see at their levels of detail for a viewport height pixels high,
+	 * counting the drawn and the culled ones and the faces drawn in profiler under the name;
+	 * depth draws them with the positions only, see SceneObject::draw_depth
+	 */
+	void gl_draw_objects(
+		std::vector<SceneObject const *> const &objects, Program const &program,
+		glm::mat4 const &view, glm::mat4 const &proj, int height,
+		std::string const &name, bool depth = false
+	);
+
+public:
+	Hw2Renderer();
+
+	/* Needs a current GL context, returns false with the error set on failure */
+	bool gl_init(std::string &error);
+	void gl_finit();
+	/* Draws into the bound framebuffer of the given size */
+	void gl_render(int width, int height);
+};
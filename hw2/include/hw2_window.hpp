@@ -1,7 +1,6 @@
 #pragma once
 
-#include "scene_object.hpp"
-#include "program.hpp"
+#include "hw2_renderer.hpp"
 
 #define GLM_FORCE_SWIZZLE
 #include <glm/mat4x4.hpp>
@@ -11,12 +10,11 @@
 #include <gtkmm/combobox.h>
 #include <gtkmm/eventbox.h>
 #include <gtkmm/glarea.h>
+#include <gtkmm/label.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/togglebutton.h>
 #include <gtkmm/window.h>
 
-#include <epoxy/gl.h>
-
 #include <memory>
 
 class Hw2Window: public Gtk::Window {
@@ -27,40 +25,15 @@ private:
 	Gtk::EventBox *area_eventbox;
 	Gtk::ToggleButton *animate;
 	Gtk::ComboBox *display_mode_combobox;
-	Gtk::Button *reset_position, *reset_animation;
+	Gtk::Button *reset_position, *reset_animation, *profile_export;
+	Gtk::Label *profile_stats;
 
 	Glib::RefPtr<Gtk::ListStore> display_mode_list_store;
 
-	enum display_mode_t {
-		SCENE,
-		SCENE_FROM_SUN,
-		SHADOWMAP
-	};
-
-	struct _gl {
-		std::unique_ptr<Program> scene_program, shadowmap_program;
-
-		static GLsizei constexpr shadowmap_size{2048};
-		static float constexpr fov{60};
-		GLuint framebuffer;
-		GLuint shadowmap;
-
-		glm::vec3 light_position;
-		glm::vec3 light_color;
-		float light_power;
-
-		glm::vec3 sun_position;
-		glm::vec3 sun_color;
-		float sun_power;
-
-		glm::mat4 sun_proj, sun_view;
-
-		static int constexpr acolytes_count{6};
-		std::unique_ptr<SceneObject> statue, acolytes[acolytes_count], base_plane;
-	} gl;
+	Hw2Renderer renderer;
 
 	guint ticker_id;
-	float view_range;
+	gint64 profile_shown_time{0};
 
 	struct {
 		enum {
@@ -88,15 +61,13 @@ private:
 	void gl_init();
 	void gl_finit();
 	bool gl_render(Glib::RefPtr<Gdk::GLContext> const &context);
-	void gl_render_scene(glm::mat4 const &view, glm::mat4 const &proj);
-	void gl_render_shadowmap();
-	void gl_draw_objects(Program const &program, glm::mat4 const &v, glm::mat4 const &p);
 
 	glm::mat4 get_camera_view() const;
 
 	void animate_toggled();
 	void reset_position_clicked();
 	void reset_animation_clicked();
+	void profile_export_clicked();
 	void display_mode_changed();
 	bool mouse_pressed(GdkEventButton *event);
 	bool mouse_released(GdkEventButton *event);
@@ -6,6 +6,7 @@
 #include <glm/vec3.hpp>
 
 #include <array>
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -17,8 +18,37 @@ public:
 		glm::vec3 norm;
 		glm::vec3 color;
 	};
+	using face = std::array<GLuint, 3>;
+
+	/* Binary mesh file: this header, then packed verticies, then faces. */
+	struct binary_header {
+		char magic[4];
+		uint32_t version;
+		uint32_t verticies_count;
+		uint32_t faces_count;
+	};
+	static uint32_t constexpr binary_version{1};
+
+	/* Points into the binary mesh memory, nothing is copied. */
+	struct binary_view {
+		vertex_data const *verticies;
+		size_t verticies_count;
+		face const *faces;
+		size_t faces_count;
+	};
+
+	/* Box and sphere around the vertex positions; the sphere is centered in the box, so it is no bigger than the box */
+	struct bounds_t {
+		glm::vec3 min, max;
+		glm::vec3 center;
+		float radius;
+	};
 
 	static Object load(std::string const &obj);
+	static Object load(char const *data, size_t size);
+	static Object load_binary(void const *data, size_t size);
+	static binary_view view_binary(void const *data, size_t size);
+	static bounds_t compute_bounds(vertex_data const *verticies, size_t count);
 	friend std::ostream &operator<<(std::ostream &s, Object const &o);
 
 private:
@@ -26,10 +56,62 @@ private:
 
 public:
 	std::vector<vertex_data> verticies;
-	std::vector<std::array<GLuint, 3>> faces;
-	
-	void recalculate_normals();
+	std::vector<face> faces;
+
+	void save_binary(std::ostream &s) const;
+
+	/* Angle-weighted normals of the faces around each vertex, computed on up to threads threads (0 for every core) */
+	void recalculate_normals(unsigned threads = 0);
 	void normals_as_colors();
+
+	/* How many verticies a FIFO post-transform cache of cache_size entries transforms for the faces in their order,
+	 * per face (ACMR, 0.5 at best for big meshes, 3 at worst) and per vertex (ATVR, 1 at best)
+	 */
+	struct cache_stats {
+		float acmr, atvr;
+	};
+	cache_stats analyze_vertex_cache(size_t cache_size) const;
+	/* Reorders the faces for the post-transform cache (Tipsify, Sander et al. 2007), then splits them into clusters
+	 * whose ACMR is at most overdraw_threshold times the one of Tipsify and orders the clusters so that the ones
+	 * facing out of the mesh go first and occlude the rest; a threshold of 0 keeps the order of Tipsify
+	 */
+	void optimize_faces(size_t cache_size = 16, float overdraw_threshold = 1.05f);
+	/* Renumbers the verticies in the order the faces first use them, dropping the unused ones */
+	void optimize_vertex_fetch();
+
+	/* Levels of detail of a mesh over the same verticies, from the mesh itself to coarser and coarser ones */
+	struct lod_chain {
+		struct level {
+			/* of faces */
+			size_t first, count;
+			/* how far the surface may have moved from the mesh, in model units */
+			float error;
+		};
+		/* faces of every level one after another */
+		std::vector<face> faces;
+		std::vector<level> levels;
+	};
+	/* Collapses edges of the mesh down to target_faces faces, or as far as it goes, with the quadric error metric;
+	 * the faces use the same verticies, the borders and the seams stay. Sets the error to the farthest a kept vertex is
+	 * from the planes of the faces collapsed into it.
+	 */
+	static std::vector<face> simplify(binary_view const &mesh, size_t target_faces, float &error);
+	/* Up to max_levels levels, each with half the faces of the previous one, none with fewer than min_faces */
+	static lod_chain build_lods(binary_view const &mesh, size_t max_levels, size_t min_faces);
 };
 
 std::ostream &operator<<(std::ostream &s, Object const &o);
+
+/* Binary mesh mapped from a file, the view is valid while the object lives. */
+class MappedMesh {
+private:
+	void *data;
+	size_t size;
+
+public:
+	explicit MappedMesh(std::string const &path);
+	MappedMesh(MappedMesh const &other) = delete;
+	~MappedMesh();
+
+	Object::binary_view view() const;
+};
@@ -1,31 +1,71 @@
 #pragma once
 
 #include "object.hpp"
+#include "program.hpp"
+#include "uniform_blocks.hpp"
 
 #include <epoxy/gl.h>
 #include <glm/glm.hpp>
 
 #include <set>
+#include <vector>
 
 class SceneObject {
+public:
+	/* Layout of the verticies in the GPU buffer, the shaders read both the same */
+	enum vertex_format_t {
+		/* Object::vertex_data as it is, 36 bytes a vertex */
+		FLOAT_VERTICIES,
+		/* 16 bytes a vertex: positions as 16-bit fractions of the cube around the mesh, which the model matrix
+		 * scales back, normals as GL_INT_2_10_10_10_REV and colors as RGBA8. The normals come out of the model matrix
+		 * scaled by the side of the cube, so the shaders have to normalize them, and the positions are only right
+		 * through the model matrix.
+		 */
+		PACKED_VERTICIES
+	};
+
 private:
 	GLuint vao{0};
 	GLuint elems{0}, data{0};
-	size_t elems_count;
+	/* the positions alone, in the format of the data buffer, with the elements for the depth passes */
+	GLuint depth_vao{0};
+	GLuint positions{0};
+	/* the faces of every level of detail one after another, the first level is the mesh itself */
+	std::vector<Object::lod_chain::level> lods;
+	/* of the mesh, in model space */
+	Object::bounds_t bounds;
+	/* from the space of the buffer to the model one */
+	glm::mat4 dequantize{1};
+	size_t vertex_bytes;
+
+	/* The verticies of the mesh with the given faces, split into the levels */
+	SceneObject(Object::binary_view const &mesh, vertex_format_t format,
+		Object::face const *faces, size_t faces_count, std::vector<Object::lod_chain::level> levels);
+	/* Points the attributes at Program's fixed locations, with the VAO and the data buffer bound */
+	static void set_attributes(vertex_format_t format);
 
 public:
 	glm::mat4 position{1.0}, animation_position{1.0};
 
-	SceneObject(Object const &obj);
+	SceneObject(Object const &obj, vertex_format_t format = FLOAT_VERTICIES);
+	explicit SceneObject(Object::binary_view const &mesh, vertex_format_t format = FLOAT_VERTICIES);
+	/* With the levels of detail of Object::build_lods over the verticies of the mesh, all in the same buffers */
+	SceneObject(Object::binary_view const &mesh, vertex_format_t format, Object::lod_chain const &chain);
 	~SceneObject();
 
-	void draw(
-		glm::mat4 const &v, glm::mat4 const &p,
-		GLuint m_attribute, GLuint v_attribute, GLuint p_attribute,
-		GLuint mv_attribute, GLuint mvp_attribute
-	) const;
+	/* Binds the blocks of the model matrix the program uses and draws the given level of detail */
+	void draw(UniformBlocks &blocks, Program const &program, size_t lod = 0) const;
+	/* The same with only the positions for vertex_position_model, for programs writing nothing but depth */
+	void draw_depth(UniformBlocks &blocks, Program const &program, size_t lod = 0) const;
+	/* Bounds of the mesh moved by position * animation_position: the box around the moved box and the moved sphere */
+	Object::bounds_t get_bounds() const;
+	/* Size of the vertex buffers, the positions of the depth passes too */
+	size_t get_vertex_bytes() const;
+	/* Faces of a level of detail */
+	size_t get_faces_count(size_t lod) const;
+	/* The coarsest level of detail whose error, scaled like the radius of the bounding sphere when projected with
+	 * view and proj onto a viewport height pixels high, stays within max_error pixels; 0 with a max_error of 0
+	 */
+	size_t select_lod(glm::mat4 const &view, glm::mat4 const &proj, float height, float max_error) const;
 
-	void set_attribute_to_position(GLuint attribute) const;
-	void set_attribute_to_normal(GLuint attribute) const;
-	void set_attribute_to_color(GLuint attribute) const;
 };
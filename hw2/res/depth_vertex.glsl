@@ -0,0 +1,13 @@
+#version 330 core
+
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
+
+in vec3 vertex_position_model;
+
+void main() {
+	gl_Position = mvp * vec4(vertex_position_model, 1);
+}
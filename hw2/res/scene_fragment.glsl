@@ -1,7 +1,16 @@
 #version 330 core
 
-uniform mat4 mv;
-uniform mat4 v;
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
 uniform vec3 light_world;
 uniform vec3 light_color;
 uniform float light_power;
@@ -1,6 +1,10 @@
 #version 330 core
 
-uniform mat4 mvp;
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
 
 in vec3 vertex_position_model;
 
@@ -0,0 +1,79 @@
+#include "frustum.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRUSTUM_X86
+#endif
+
+Frustum::Frustum(glm::mat4 const &vp) {
+	/* rows of the matrix, a point is inside when -w <= x, y, z <= w of its clip coordinates */
+	glm::vec4 rows[4];
+	for (int i{0}; i != 4; ++i)
+		rows[i] = glm::vec4(vp[0][i], vp[1][i], vp[2][i], vp[3][i]);
+	for (int i{0}; i != 3; ++i) {
+		glm::vec4 const sides[2]{rows[3] + rows[i], rows[3] - rows[i]};
+		for (int j{0}; j != 2; ++j) {
+			/* normalized, so that the distances compare with radii */
+			glm::vec4 const plane{sides[j] / glm::length(glm::vec3(sides[j]))};
+			for (int k{0}; k != 4; ++k)
+				planes[2 * i + j][k] = plane[k];
+		}
+	}
+}
+
+#ifdef FRUSTUM_X86
+__attribute__((target("sse2")))
+static size_t test_spheres_sse(float const (&planes)[6][4], glm::vec4 const *spheres, size_t count, std::vector<size_t> &visible) {
+	size_t i{0};
+	for (; i + 4 <= count; i += 4) {
+		__m128 x{_mm_loadu_ps(&spheres[i][0])};
+		__m128 y{_mm_loadu_ps(&spheres[i + 1][0])};
+		__m128 z{_mm_loadu_ps(&spheres[i + 2][0])};
+		__m128 r{_mm_loadu_ps(&spheres[i + 3][0])};
+		/* one lane per sphere */
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+		__m128 const minus_r{_mm_sub_ps(_mm_setzero_ps(), r)};
+		__m128 outside{_mm_setzero_ps()};
+		for (auto const &p: planes) {
+			__m128 distance{_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), x), _mm_mul_ps(_mm_set1_ps(p[1]), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[2]), z), _mm_set1_ps(p[3]))
+			)};
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, minus_r));
+		}
+		int const mask{_mm_movemask_ps(outside)};
+		for (int j{0}; j != 4; ++j)
+			if ((mask & (1 << j)) == 0)
+				visible.push_back(i + j);
+	}
+	return i;
+}
+#endif
+
+void Frustum::test_spheres(glm::vec4 const *spheres, size_t count, std::vector<size_t> &visible) const {
+	visible.clear();
+	size_t i{0};
+#ifdef FRUSTUM_X86
+	i = test_spheres_sse(planes, spheres, count, visible);
+#endif
+	for (; i != count; ++i) {
+		glm::vec4 const &s{spheres[i]};
+		bool inside{true};
+		for (auto const &p: planes)
+			inside = inside && p[0] * s.x + p[1] * s.y + p[2] * s.z + p[3] >= -s.w;
+		if (inside)
+			visible.push_back(i);
+	}
+}
+
+bool Frustum::test_box(glm::vec3 const &min, glm::vec3 const &max) const {
+	for (auto const &p: planes) {
+		/* the corner furthest along the normal */
+		glm::vec3 const corner{p[0] >= 0 ? max.x : min.x, p[1] >= 0 ? max.y : min.y, p[2] >= 0 ? max.z : min.z};
+		if (p[0] * corner.x + p[1] * corner.y + p[2] * corner.z + p[3] < 0)
+			return false;
+	}
+	return true;
+}
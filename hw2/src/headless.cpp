@@ -0,0 +1,217 @@
+#include "headless.hpp"
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using std::string;
+
+bool parse_headless_options(int argc, char **argv, headless_options &options) {
+	bool headless{false};
+	for (int i{1}; i < argc; ++i) {
+		string const arg{argv[i]};
+		auto value{[&]() -> string {
+			if (i + 1 == argc)
+				throw std::invalid_argument(arg + " needs a value");
+			return argv[++i];
+		}};
+		if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--frames") {
+			options.frames = std::stoi(value());
+		} else if (arg == "--size") {
+			string const size{value()};
+			if (std::sscanf(size.c_str(), "%dx%d", &options.width, &options.height) != 2)
+				throw std::invalid_argument("--size expects WxH, got " + size);
+		} else if (arg == "--step") {
+			options.step = std::stof(value());
+		} else if (arg == "--output") {
+			options.output = value();
+		} else if (arg == "--raw") {
+			options.raw = true;
+		} else if (arg == "--seed") {
+			options.seed = std::stoul(value());
+		} else if (arg == "--profile") {
+			options.profile = value();
+		} else if (arg == "--set") {
+			string const setting{value()};
+			size_t const eq{setting.find('=')};
+			if (eq == string::npos)
+				throw std::invalid_argument("--set expects NAME=VALUE, got " + setting);
+			options.settings[setting.substr(0, eq)] = setting.substr(eq + 1);
+		} else if (headless) {
+			throw std::invalid_argument("unknown option " + arg);
+		}
+	}
+	if (headless && (options.frames < 0 || options.width <= 0 || options.height <= 0))
+		throw std::invalid_argument("frames and size must be positive");
+	return headless;
+}
+
+bool write_profile(GpuProfiler &profiler, headless_options const &options, string &error) {
+	if (options.profile.empty())
+		return true;
+	profiler.finish();
+	std::cout << profiler.format_stats();
+	return profiler.export_files(options.profile, error);
+}
+
+HeadlessContext::HeadlessContext(int width, int height):
+	width(width),
+	height(height)
+{
+	char const *client_extensions{eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS)};
+	display = EGL_NO_DISPLAY;
+	if (client_extensions != nullptr && std::strstr(client_extensions, "EGL_MESA_platform_surfaceless") != nullptr)
+		display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+		throw std::runtime_error("EGL: no display");
+	if (!epoxy_has_egl_extension(display, "EGL_KHR_surfaceless_context")) {
+		eglTerminate(display);
+		throw std::runtime_error("EGL: no EGL_KHR_surfaceless_context");
+	}
+
+	eglBindAPI(EGL_OPENGL_API);
+	EGLint const config_attributes[]{
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs;
+	if (!eglChooseConfig(display, config_attributes, &config, 1, &configs) || configs == 0)
+		config = EGL_NO_CONFIG_KHR;
+	EGLint const context_attributes[]{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		eglTerminate(display);
+		throw std::runtime_error("EGL: cannot create an OpenGL 3.3 context");
+	}
+
+	/* framebuffer */ {
+		glGenRenderbuffers(1, &color);
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(display, context);
+			eglTerminate(display);
+			throw std::runtime_error("Failed to create framebuffer.");
+		}
+		glViewport(0, 0, width, height);
+		/* Gtk::GLArea with a depth buffer enables the test for the renderers */
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	glGenQueries(2, timers);
+
+	std::cout << "Rendering headless on " << glGetString(GL_RENDERER) << " (version " << glGetString(GL_VERSION) << ")" << std::endl;
+}
+
+HeadlessContext::~HeadlessContext() {
+	glDeleteQueries(2, timers);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteRenderbuffers(1, &color);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+}
+
+void HeadlessContext::write_frame(string const &path, bool raw) const {
+	size_t const stride{static_cast<size_t>(width) * 4};
+	std::vector<unsigned char> pixels(stride * height), flipped(stride * height);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	/* GL rows go bottom-up */
+	for (int y{0}; y < height; ++y)
+		std::copy_n(&pixels[stride * (height - 1 - y)], stride, &flipped[stride * y]);
+
+	if (raw) {
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<char const *>(flipped.data()), flipped.size());
+		if (!file)
+			throw std::runtime_error("Cannot write " + path);
+		return;
+	}
+
+	GdkPixbuf *pixbuf{gdk_pixbuf_new_from_data(
+		flipped.data(), GDK_COLORSPACE_RGB, /* has_alpha = */ TRUE, 8,
+		width, height, stride, nullptr, nullptr
+	)};
+	GError *error{nullptr};
+	gboolean saved{gdk_pixbuf_save(pixbuf, path.c_str(), "png", &error, nullptr)};
+	g_object_unref(pixbuf);
+	if (!saved) {
+		string message{"Cannot write " + path + ": " + error->message};
+		g_error_free(error);
+		throw std::runtime_error(message);
+	}
+}
+
+bool HeadlessContext::run(
+	headless_options const &options,
+	std::function<bool(float progress, string &error)> const &render,
+	string &error
+) {
+	using clock = std::chrono::steady_clock;
+	double cpu_total{0}, gpu_total{0}, cpu_max{0}, gpu_max{0};
+	for (int frame{0}; frame < options.frames; ++frame) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+
+		auto const start{clock::now()};
+		glQueryCounter(timers[0], GL_TIMESTAMP);
+		bool const rendered{render(frame * options.step, error)};
+		glQueryCounter(timers[1], GL_TIMESTAMP);
+		double const cpu_ms{std::chrono::duration<double, std::milli>(clock::now() - start).count()};
+		if (!rendered)
+			return false;
+
+		/* not GL_TIME_ELAPSED: llvmpipe returns garbage for the first such query */
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(timers[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(timers[1], GL_QUERY_RESULT, &end);
+		double const gpu_ms{(end - begin) / 1e6};
+		cpu_total += cpu_ms;
+		gpu_total += gpu_ms;
+		cpu_max = std::max(cpu_max, cpu_ms);
+		gpu_max = std::max(gpu_max, gpu_ms);
+
+		char name[16];
+		std::snprintf(name, sizeof(name), "%04d.%s", frame, options.raw ? "rgba" : "png");
+		write_frame(options.output + name, options.raw);
+
+		std::printf("frame %4d: cpu %8.3f ms, gpu %8.3f ms\n", frame, cpu_ms, gpu_ms);
+	}
+	if (options.frames != 0)
+		std::printf(
+			"%d frames %dx%d: cpu %.3f ms avg, %.3f ms max; gpu %.3f ms avg, %.3f ms max\n",
+			options.frames, width, height,
+			cpu_total / options.frames, cpu_max, gpu_total / options.frames, gpu_max
+		);
+	return true;
+}
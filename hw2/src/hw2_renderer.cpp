@@ -0,0 +1,390 @@
+#include "hw2_renderer.hpp"
+
+#include <epoxy/gl.h>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <giomm/resource.h>
+
+#include <algorithm>
+#include <iostream>
+
+using Gio::Resource;
+
+/* Names of the uniforms, hashed at compile time */
+namespace uniforms {
+	static constexpr Program::name
+		light_world{"light_world"},
+		light_color{"light_color"},
+		light_power{"light_power"},
+		tosun_world{"tosun_world"},
+		sun_color{"sun_color"},
+		sun_power{"sun_power"},
+		shadowmap{"shadowmap"},
+		shadowmap_vp{"shadowmap_vp"};
+}
+
+Hw2Renderer::Hw2Renderer() {
+	gl.light_position = glm::vec3(0, .1, .5);
+	gl.light_color = glm::vec3(1, 1, 1);
+	gl.light_power = .04;
+
+	gl.sun_position = glm::vec3(-.1, .1, -.1);
+	gl.sun_color = glm::vec3(1, .95, .5);
+	gl.sun_power = .9;
+}
+
+bool Hw2Renderer::gl_init(std::string &error) {
+	auto load_resource{[](std::string const &path) -> std::tuple<char const *, size_t> {
+		auto resource_bytes{Resource::lookup_data_global(path)};
+		gsize resource_size;
+		auto resource{static_cast<const char*>(resource_bytes->get_data(resource_size))};
+		return {resource, resource_size};
+	}};
+
+	auto load_mesh{[&load_resource](std::string const &path) -> ::Object::binary_view {
+		char const *data;
+		size_t size;
+		std::tie(data, size) = load_resource(path);
+		return ::Object::view_binary(data, size);
+	}};
+
+	/* shaders */ {
+		/* scene */ {
+			std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/scene_vertex.glsl")));
+			std::string fragment(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/scene_fragment.glsl")));
+			std::string error_string;
+			gl.scene_program = Program::build_program({{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}}, error_string);
+			if (gl.scene_program == nullptr) {
+				error = "Program Scene: " + error_string;
+				return false;
+			}
+		}
+
+		/* shadowmap */ {
+			std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/shadowmap_vertex.glsl")));
+			std::string fragment(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/shadowmap_fragment.glsl")));
+			std::string error_string;
+			gl.shadowmap_program = Program::build_program({{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}}, error_string);
+			if (gl.shadowmap_program == nullptr) {
+				error = "Program Shadowmap: " + error_string;
+				return false;
+			}
+		}
+
+		/* depth, only the depth test and no fragment shader */ {
+			std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/depth_vertex.glsl")));
+			std::string error_string;
+			gl.depth_program = Program::build_program({{GL_VERTEX_SHADER, vertex}}, error_string);
+			if (gl.depth_program == nullptr) {
+				error = "Program Depth: " + error_string;
+				return false;
+			}
+		}
+	}
+
+	gl.blocks.gl_init();
+
+	/* framebuffers, of the shadow map and of the static shadows */ {
+		auto create{[](GLuint &framebuffer, GLuint &texture) {
+			glGenFramebuffers(1, &framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(
+				GL_TEXTURE_2D, /* mipmap_level = */ 0,
+				GL_DEPTH_COMPONENT16,
+				_gl::shadowmap_size, _gl::shadowmap_size, 0,
+				GL_DEPTH_COMPONENT, GL_FLOAT,
+				nullptr
+			);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, /* mipmap_level = */ 0);
+			glDrawBuffer(GL_NONE);
+
+			bool const complete{glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE};
+			if (!complete) {
+				glDeleteFramebuffers(1, &framebuffer);
+				glDeleteTextures(1, &texture);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return complete;
+		}};
+		if (!create(gl.framebuffer, gl.shadowmap)) {
+			error = "Failed to create framebuffer.";
+			return false;
+		}
+		if (!create(gl.static_framebuffer, gl.static_shadowmap)) {
+			error = "Failed to create framebuffer.";
+			glDeleteFramebuffers(1, &gl.framebuffer);
+			glDeleteTextures(1, &gl.shadowmap);
+			return false;
+		}
+	}
+
+	/* scene */ {
+		auto const format{packed_verticies ? SceneObject::PACKED_VERTICIES : SceneObject::FLOAT_VERTICIES};
+		/* rabbit */ {
+			/* halving the faces down to a few hundred */
+			auto const lods{[this](::Object::binary_view const &mesh) {
+				return ::Object::build_lods(mesh, lod_error > 0 ? 6 : 1, 512);
+			}};
+			auto const acolyte{load_mesh("/net/ldvsoft/spbau/gl/stanford_bunny.mesh")};
+			auto const acolyte_lods{lods(acolyte)};
+			for (int i{0}; i != gl.acolytes_count; ++i) {
+				auto a{static_cast<float>(2 * M_PI / gl.acolytes_count * i)};
+				gl.acolytes[i] = std::make_unique<SceneObject>(acolyte, format, acolyte_lods);
+				gl.acolytes[i]->position = glm::rotate(a, glm::vec3(0, 1, 0))
+					* glm::translate(glm::vec3(.18, 0, 0))
+					* glm::scale(glm::vec3(.3, .3, .3))
+					* glm::translate(glm::vec3(0, -.03, 0));
+			}
+
+			/* the Makefile makes the statue out of the same model with other colors, so the levels of the acolytes fit it */
+			auto const statue{load_mesh("/net/ldvsoft/spbau/gl/stanford_bunny_statue.mesh")};
+			bool const same_faces{
+				statue.verticies_count == acolyte.verticies_count
+				&& statue.faces_count == acolyte.faces_count
+				&& std::equal(statue.faces, statue.faces + statue.faces_count, acolyte.faces)
+			};
+			gl.statue = std::make_unique<SceneObject>(statue, format, same_faces ? acolyte_lods : lods(statue));
+			gl.statue->position = glm::translate(glm::vec3(0, -.03, 0));
+		}
+
+		/* base plane */ {
+			gl.base_plane = std::make_unique<SceneObject>(load_mesh("/net/ldvsoft/spbau/gl/plane.mesh"), format);
+		}
+
+		gl.objects.assign({gl.base_plane.get(), gl.statue.get()});
+		for (auto const &acolyte: gl.acolytes)
+			gl.objects.push_back(acolyte.get());
+		/* only the statue jumps */
+		gl.static_casters.assign({gl.base_plane.get()});
+		for (auto const &acolyte: gl.acolytes)
+			gl.static_casters.push_back(acolyte.get());
+		gl.dynamic_casters.assign({gl.statue.get()});
+		gl.static_models.clear();
+		gl.dynamic_models.clear();
+		gl.sun_proj = glm::ortho<float>(
+			/* X ragne : */ -view_range, +view_range,
+			/* Y ragne : */ -view_range, +view_range,
+			/* planes  : */ -10, 10
+		);
+		gl.sun_view = glm::lookAt(
+			/* from = */ gl.sun_position,
+			/* to   = */ glm::vec3(0, 0, 0),
+			/* up   = */ glm::vec3(0, 1, 0)
+		);
+	}
+
+	size_t vertex_bytes{0};
+	for (auto const *object: gl.objects)
+		vertex_bytes += object->get_vertex_bytes();
+	std::cout << "Rendering on " << glGetString(GL_RENDERER) << ", " << vertex_bytes / 1024 << " KiB of verticies" << std::endl;
+	return true;
+}
+
+void Hw2Renderer::gl_finit() {
+	profiler.gl_finit();
+	for (GLuint framebuffer: {gl.framebuffer, gl.static_framebuffer})
+		glDeleteFramebuffers(1, &framebuffer);
+	for (GLuint texture: {gl.shadowmap, gl.static_shadowmap})
+		glDeleteTextures(1, &texture);
+	gl.objects.clear();
+	gl.static_casters.clear();
+	gl.dynamic_casters.clear();
+	for (int i{0}; i != gl.acolytes_count; ++i)
+		gl.acolytes[i] = nullptr;
+	gl.statue = nullptr;
+	gl.base_plane = nullptr;
+	gl.scene_program = nullptr;
+	gl.shadowmap_program = nullptr;
+	gl.depth_program = nullptr;
+	gl.blocks.gl_finit();
+}
+
+void Hw2Renderer::gl_render(int width, int height) {
+	profiler.begin_frame();
+	gl.blocks.begin_frame();
+	glClearColor(0, 0, 0, 1);
+
+	/* animate */ {
+		double a{cos(progress * 10 * M_PI) * M_PI / 6}, b{progress * 30 * M_PI}, r{.3};
+		//std::cout << progress << " " << a << " " << b << std::endl;
+		gl.light_position = glm::vec3(
+			r * cos(a) * sin(b),
+			.2 + r * sin(a),
+			r * cos(a) * cos(b)
+		);
+
+		gl.statue->animation_position = glm::translate(glm::vec3(0, std::max<float>(0, sin(progress * 4 * M_PI)) * .01, 0));
+	}
+
+	/* shadowmap */ {
+		GLint old_buffer, old_vp[4];
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
+		glGetIntegerv(GL_VIEWPORT, old_vp);
+
+		glViewport(0, 0, gl.shadowmap_size, gl.shadowmap_size);
+		gl_update_shadowmap();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+		glViewport(old_vp[0], old_vp[1], old_vp[2], old_vp[3]);
+	}
+
+	glm::mat4 cam_proj{glm::perspective(
+		/* vertical fov = */ glm::radians(gl.fov),
+		/* ratio        = */ static_cast<float>(width) / height,
+		/* planes       : */ .01f, 1000.0f
+	)};
+
+	/* pass */ {
+		GpuProfiler::pass pass(profiler, "scene");
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		switch (display_mode) {
+		case SCENE:
+			gl_render_scene(camera_view, cam_proj, height);
+			break;
+		case SCENE_FROM_SUN:
+			gl_render_scene(gl.sun_view, gl.sun_proj, height);
+			break;
+		case SHADOWMAP:
+			gl_render_shadowmap();
+			break;
+		}
+	}
+
+	profiler.end_frame();
+	glFlush();
+}
+
+void Hw2Renderer::gl_render_scene(glm::mat4 const &view, glm::mat4 const &proj, int height) {
+	gl.blocks.set_camera(view, proj);
+	gl.scene_program->use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, gl.shadowmap);
+
+	glm::mat4 shadowmap_vp{gl.sun_proj * gl.sun_view};
+
+	glUniform3fv(gl.scene_program->get_uniform(uniforms::light_world), 1, &gl.light_position[0]);
+	glUniform3fv(gl.scene_program->get_uniform(uniforms::light_color), 1, &gl.light_color[0]);
+	glUniform1f (gl.scene_program->get_uniform(uniforms::light_power), gl.light_power);
+
+	glUniform3fv(gl.scene_program->get_uniform(uniforms::tosun_world), 1, &gl.sun_position[0]);
+	glUniform3fv(gl.scene_program->get_uniform(uniforms::sun_color  ), 1, &gl.sun_color[0]);
+	glUniform1f (gl.scene_program->get_uniform(uniforms::sun_power), gl.sun_power);
+
+	glUniform1i (gl.scene_program->get_uniform(uniforms::shadowmap), 0 /*gl.shadowmap*/);
+	glUniformMatrix4fv(
+		gl.scene_program->get_uniform(uniforms::shadowmap_vp),
+		1, GL_FALSE,
+		&shadowmap_vp[0][0]
+	);
+
+	gl_draw_objects(gl.objects, *gl.scene_program, view, proj, height, "scene");
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
+
+/* Whether the casters have the given model matrices, which become theirs */
+static bool same_models(std::vector<SceneObject const *> const &casters, std::vector<glm::mat4> &models) {
+	bool same{models.size() == casters.size()};
+	models.resize(casters.size());
+	for (size_t i{0}; i != casters.size(); ++i) {
+		glm::mat4 const model{casters[i]->position * casters[i]->animation_position};
+		same = same && model == models[i];
+		models[i] = model;
+	}
+	return same;
+}
+
+/* The sun and its view do not change, so the shadows stay until a caster moves. The static casters are drawn into their
+ * own shadow map once, then every time the dynamic ones move it is copied into the shadow map and they are drawn over it.
+ */
+void Hw2Renderer::gl_update_shadowmap() {
+	gl.blocks.set_camera(gl.sun_view, gl.sun_proj);
+	gl.depth_program->use();
+	if (!shadow_cache) {
+		/* the next frame with the cache draws everything anew */
+		gl.static_models.clear();
+		gl.dynamic_models.clear();
+		GpuProfiler::pass pass(profiler, "shadowmap");
+		glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		gl_draw_objects(gl.objects, *gl.depth_program, gl.sun_view, gl.sun_proj, gl.shadowmap_size, "shadowmap", true);
+	} else {
+		bool const static_moved{!same_models(gl.static_casters, gl.static_models)};
+		bool const dynamic_moved{!same_models(gl.dynamic_casters, gl.dynamic_models)};
+		if (static_moved) {
+			GpuProfiler::pass pass(profiler, "shadowmap static");
+			glBindFramebuffer(GL_FRAMEBUFFER, gl.static_framebuffer);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			gl_draw_objects(gl.static_casters, *gl.depth_program, gl.sun_view, gl.sun_proj, gl.shadowmap_size, "shadowmap static", true);
+		}
+		if (static_moved || dynamic_moved) {
+			GpuProfiler::pass pass(profiler, "shadowmap dynamic");
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, gl.static_framebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gl.framebuffer);
+			glBlitFramebuffer(
+				0, 0, gl.shadowmap_size, gl.shadowmap_size,
+				0, 0, gl.shadowmap_size, gl.shadowmap_size,
+				GL_DEPTH_BUFFER_BIT, GL_NEAREST
+			);
+			glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
+			gl_draw_objects(gl.dynamic_casters, *gl.depth_program, gl.sun_view, gl.sun_proj, gl.shadowmap_size, "shadowmap dynamic", true);
+		}
+		profiler.add_counter("shadowmap static redrawn", static_moved);
+		profiler.add_counter("shadowmap redrawn", static_moved || dynamic_moved);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
+	glUseProgram(0);
+}
+
+void Hw2Renderer::gl_render_shadowmap() {
+	gl.blocks.set_camera(gl.sun_view, gl.sun_proj);
+	gl.shadowmap_program->use();
+
+	gl_draw_objects(gl.objects, *gl.shadowmap_program, gl.sun_view, gl.sun_proj, gl.shadowmap_size, "shadowmap view");
+
+	glUseProgram(0);
+}
+
+void Hw2Renderer::gl_draw_objects(
+	std::vector<SceneObject const *> const &objects, Program const &program,
+	glm::mat4 const &view, glm::mat4 const &proj, int height,
+	std::string const &name, bool depth
+) {
+	Frustum const frustum(proj * view);
+	/* spheres first, all at once, then the boxes of those left */
+	gl.spheres.clear();
+	for (auto const *object: objects) {
+		auto const bounds{object->get_bounds()};
+		gl.spheres.emplace_back(bounds.center, bounds.radius);
+	}
+	frustum.test_spheres(gl.spheres.data(), gl.spheres.size(), gl.visible);
+	size_t drawn{0}, faces{0};
+	for (size_t i: gl.visible) {
+		auto const *object{objects[i]};
+		auto const bounds{object->get_bounds()};
+		if (!frustum.test_box(bounds.min, bounds.max))
+			continue;
+		size_t const lod{object->select_lod(view, proj, height, lod_error)};
+		if (depth)
+			object->draw_depth(gl.blocks, program, lod);
+		else
+			object->draw(gl.blocks, program, lod);
+		faces += object->get_faces_count(lod);
+		++drawn;
+	}
+	profiler.add_counter(name + " drawn", drawn);
+	profiler.add_counter(name + " culled", objects.size() - drawn);
+	profiler.add_counter(name + " faces", faces);
+}
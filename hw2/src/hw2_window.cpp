@@ -56,6 +56,8 @@ Hw2Window::Hw2Window(
 	builder->get_widget("display_mode_combobox", display_mode_combobox);
 	builder->get_widget("reset_position_button", reset_position);
 	builder->get_widget("reset_animation_button", reset_animation);
+	builder->get_widget("profile_export_button", profile_export);
+	builder->get_widget("profile_stats_label", profile_stats);
 
 	ticker_id = gtk_widget_add_tick_callback(GTK_WIDGET(area->gobj()), tick_wrapper, this, nullptr);
 
@@ -64,22 +66,22 @@ Hw2Window::Hw2Window(
 	area->set_has_depth_buffer();
 	/* options */ {
 		/* scene */ {
-			static_assert(SCENE == 0);
+			static_assert(Hw2Renderer::SCENE == 0);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Scene");
 		}
 		/* scene_from_sum */ {
-			static_assert(SCENE_FROM_SUN == 1);
+			static_assert(Hw2Renderer::SCENE_FROM_SUN == 1);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Scene (from sun)");
 		}
 		/* shadowmap */ {
-			static_assert(SHADOWMAP == 2);
+			static_assert(Hw2Renderer::SHADOWMAP == 2);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Shadowmap");
 		}
 
-		display_mode_combobox->set_active(SCENE);
+		display_mode_combobox->set_active(Hw2Renderer::SCENE);
 	}
 
 	area->signal_realize  ().connect(sigc::mem_fun(*this, &Hw2Window::gl_init));
@@ -96,17 +98,9 @@ Hw2Window::Hw2Window(
 	animate->signal_toggled().connect(sigc::mem_fun(*this, &Hw2Window::animate_toggled));
 	reset_position->signal_clicked ().connect(sigc::mem_fun(*this, &Hw2Window::reset_position_clicked));
 	reset_animation->signal_clicked().connect(sigc::mem_fun(*this, &Hw2Window::reset_animation_clicked));
+	profile_export->signal_clicked ().connect(sigc::mem_fun(*this, &Hw2Window::profile_export_clicked));
 	display_mode_combobox->signal_changed().connect(sigc::mem_fun(*this, &Hw2Window::display_mode_changed));
 
-	gl.light_position = glm::vec3(0, .1, .5);
-	gl.light_color = glm::vec3(1, 1, 1);
-	gl.light_power = .04;
-
-	gl.sun_position = glm::vec3(-.1, .1, -.1);
-	gl.sun_color = glm::vec3(1, .95, .5);
-	gl.sun_power = .9;
-	view_range = .3;
-
 	reset_position_clicked();
 	reset_animation_clicked();
 }
@@ -120,244 +114,34 @@ void Hw2Window::gl_init() {
 	if (area->has_error())
 		return;
 
-	auto load_resource{[this](std::string const &path) -> std::tuple<char const *, size_t> {
-		auto resource_bytes{Resource::lookup_data_global(path)};
-		gsize resource_size;
-		auto resource{static_cast<const char*>(resource_bytes->get_data(resource_size))};
-		return {resource, resource_size};
-	}};
-
-	auto report_error{[this](std::string const &msg) -> void {
-		Error error(hw2_error_quark, 0, msg);
-		area->set_error(error);
-		std::cout << "ERROR: " << msg << std::endl;
-	}};
-
-	/* shaders */ {
-		/* scene */ {
-			std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/scene_vertex.glsl")));
-			std::string fragment(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/scene_fragment.glsl")));
-			std::string error_string;
-			gl.scene_program = Program::build_program({{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}}, error_string);
-			if (gl.scene_program == nullptr) {
-				report_error("Program Scene: " + error_string);
-				return;
-			}
-		}
-
-		/* shadowmap */ {
-			std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/shadowmap_vertex.glsl")));
-			std::string fragment(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/shadowmap_fragment.glsl")));
-			std::string error_string;
-			gl.shadowmap_program = Program::build_program({{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}}, error_string);
-			if (gl.shadowmap_program == nullptr) {
-				report_error("Program Shadowmap: " + error_string);
-				return;
-			}
-		}
-	}
-
-	/* framebuffer */ {
-		glGenFramebuffers(1, &gl.framebuffer);
-		glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
-
-		glGenTextures(1, &gl.shadowmap);
-		glBindTexture(GL_TEXTURE_2D, gl.shadowmap);
-		glTexImage2D(
-			GL_TEXTURE_2D, /* mipmap_level = */ 0,
-			GL_DEPTH_COMPONENT16,
-			gl.shadowmap_size, gl.shadowmap_size, 0,
-			GL_DEPTH_COMPONENT, GL_FLOAT,
-			nullptr
-		);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, gl.shadowmap, /* mipmap_level = */ 0);
-		glDrawBuffer(GL_NONE);
-
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			area->set_error(Error(hw2_error_quark, 0, "Failed to create framebuffer."));
-			glDeleteFramebuffers(1, &gl.framebuffer);
-			glDeleteTextures(1, &gl.shadowmap);
-			return;
-		}
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	std::string error;
+	if (!renderer.gl_init(error)) {
+		area->set_error(Error(hw2_error_quark, 0, error));
+		std::cout << "ERROR: " << error << std::endl;
 	}
-
-	/* scene */ {
-		/* rabbit */ {
-			::Object obj{::Object::load(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/stanford_bunny.obj")))};
-			obj.recalculate_normals();
-			for (int i{0}; i != gl.acolytes_count; ++i) {
-				auto a{static_cast<float>(2 * M_PI / gl.acolytes_count * i)};
-				gl.acolytes[i] = std::make_unique<SceneObject>(obj);
-				gl.acolytes[i]->position = glm::rotate(a, glm::vec3(0, 1, 0))
-					* glm::translate(glm::vec3(.18, 0, 0))
-					* glm::scale(glm::vec3(.3, .3, .3))
-					* glm::translate(glm::vec3(0, -.03, 0));
-			}
-
-			obj.normals_as_colors();
-			gl.statue = std::make_unique<SceneObject>(obj);
-			gl.statue->position = glm::translate(glm::vec3(0, -.03, 0));
-		}
-
-		/* base plane */ {
-			::Object obj{::Object::load(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/plane.obj")))};
-			gl.base_plane = std::make_unique<SceneObject>(obj);
-		}
-		gl.sun_proj = glm::ortho<float>(
-			/* X ragne : */ -view_range, +view_range,
-			/* Y ragne : */ -view_range, +view_range,
-			/* planes  : */ -10, 10
-		);
-		gl.sun_view = glm::lookAt(
-			/* from = */ gl.sun_position,
-			/* to   = */ glm::vec3(0, 0, 0),
-			/* up   = */ glm::vec3(0, 1, 0)
-		);
-	}
-
-	std::cout << "Rendering on " << glGetString(GL_RENDERER) << std::endl;
 }
 
 void Hw2Window::gl_finit() {
 	area->make_current();
 	if (area->has_error())
 		return;
-	for (int i{0}; i != gl.acolytes_count; ++i)
-		gl.acolytes[i] = nullptr;
-	gl.statue = nullptr;
-	gl.base_plane = nullptr;
-	gl.scene_program = nullptr;
-	gl.shadowmap_program = nullptr;
+	renderer.gl_finit();
 }
 
 bool Hw2Window::gl_render(RefPtr<GLContext> const &context) {
 	static_cast<void>(context);
-//	check("Hw2Window::gl_render before...");
 
 	if (area->has_error())
 		return false;
 
-	glClearColor(0, 0, 0, 1);
-
-	/* animate */ {
-		double a{cos(animation.progress * 10 * M_PI) * M_PI / 6}, b{animation.progress * 30 * M_PI}, r{.3};
-		//std::cout << animation.progress << " " << a << " " << b << std::endl;
-		gl.light_position = glm::vec3(
-			r * cos(a) * sin(b),
-			.2 + r * sin(a),
-			r * cos(a) * cos(b)
-		);
-
-		gl.statue->animation_position = glm::translate(glm::vec3(0, std::max<float>(0, sin(animation.progress * 4 * M_PI)) * .01, 0));
-	}
-
-	/* shadowmap */ {
-		GLint old_buffer, old_vp[4];
-		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
-		glGetIntegerv(GL_VIEWPORT, old_vp);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
-		glViewport(0, 0, gl.shadowmap_size, gl.shadowmap_size);
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		gl_render_shadowmap();
-
-		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
-		glViewport(old_vp[0], old_vp[1], old_vp[2], old_vp[3]);
-	}
-
-	glm::mat4 cam_proj{glm::perspective(
-		/* vertical fov = */ glm::radians(gl.fov),
-		/* ratio        = */ static_cast<float>(area->get_width()) / area->get_height(),
-		/* planes       : */ .01f, 1000.0f
-	)};
-
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	switch (display_mode_combobox->get_active_row_number()) {
-	case SCENE:
-		gl_render_scene(get_camera_view(), cam_proj);
-		break;
-	case SCENE_FROM_SUN:
-		gl_render_scene(gl.sun_view, gl.sun_proj);
-		break;
-	case SHADOWMAP:
-		gl_render_shadowmap();
-		break;
-	}
-
-	glFlush();
+	renderer.progress = animation.progress;
+	renderer.display_mode = static_cast<Hw2Renderer::display_mode_t>(display_mode_combobox->get_active_row_number());
+	renderer.camera_view = get_camera_view();
+	renderer.gl_render(area->get_width(), area->get_height());
 
 	return false;
 }
 
-void Hw2Window::gl_render_scene(glm::mat4 const &view, glm::mat4 const &proj) {
-	gl.scene_program->use();
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gl.shadowmap);
-
-	glm::mat4 shadowmap_vp{gl.sun_proj * gl.sun_view};
-
-	glUniform3fv(gl.scene_program->get_uniform("light_world"), 1, &gl.light_position[0]);
-	glUniform3fv(gl.scene_program->get_uniform("light_color"), 1, &gl.light_color[0]);
-	glUniform1f (gl.scene_program->get_uniform("light_power"), gl.light_power);
-
-	glUniform3fv(gl.scene_program->get_uniform("tosun_world"), 1, &gl.sun_position[0]);
-	glUniform3fv(gl.scene_program->get_uniform("sun_color"  ), 1, &gl.sun_color[0]);
-	glUniform1f (gl.scene_program->get_uniform("sun_power"), gl.sun_power);
-
-	glUniform1i (gl.scene_program->get_uniform("shadowmap"), 0 /*gl.shadowmap*/);
-	glUniformMatrix4fv(
-		gl.scene_program->get_uniform("shadowmap_vp"),
-		1, GL_FALSE,
-		&shadowmap_vp[0][0]
-	);
-
-	gl_draw_objects(*gl.scene_program, view, proj);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUseProgram(0);
-}
-
-void Hw2Window::gl_render_shadowmap() {
-	gl.shadowmap_program->use();
-
-	gl_draw_objects(*gl.shadowmap_program, gl.sun_view, gl.sun_proj);
-
-	glUseProgram(0);
-}
-
-void Hw2Window::gl_draw_objects(Program const &program, glm::mat4 const &v, glm::mat4 const &p) {
-	auto draw_object{[&](SceneObject const *object) -> void {
-		auto pos{program.get_attribute("vertex_position_model")};
-		auto nor{program.get_attribute("vertex_normal_model")};
-		auto clr{program.get_attribute("vertex_color")};
-		if (pos != Program::no_id)
-			object->set_attribute_to_position(pos);
-		if (nor != Program::no_id)
-			object->set_attribute_to_normal(nor);
-		if (clr != Program::no_id)
-			object->set_attribute_to_color(clr);
-		object->draw(
-			v, p,
-			program.get_uniform("m"), program.get_uniform("v"), program.get_uniform("p"),
-			program.get_uniform("mv"), program.get_uniform("mvp")
-		);
-	}};
-
-	draw_object(gl.base_plane.get());
-	draw_object(gl.statue.get());
-	for (int i{0}; i != gl.acolytes_count; ++i)
-		draw_object(gl.acolytes[i].get());
-}
-
 glm::mat4 Hw2Window::get_camera_view() const {
 	return glm::rotate(navigation.yangle, glm::vec3(1, 0, 0)) *
 		glm::rotate(navigation.xangle, glm::vec3(0, -1, 0)) *
@@ -387,6 +171,14 @@ void Hw2Window::reset_animation_clicked() {
 	area->queue_render();
 }
 
+void Hw2Window::profile_export_clicked() {
+	std::string error;
+	if (renderer.profiler.export_files("profile", error))
+		std::cout << "Profile written to profile.csv and profile.json" << std::endl;
+	else
+		std::cout << "ERROR: " << error << std::endl;
+}
+
 void Hw2Window::tick(gint64 new_time) {
 	gint64 delta{new_time - animation.start_time};
 	double seconds_delta{delta / static_cast<double>(G_USEC_PER_SEC)};
@@ -433,11 +225,15 @@ void Hw2Window::tick(gint64 new_time) {
 			flag = true;
 		}
 		if (flag) {
-			direction *= view_range / 20;
+			direction *= renderer.view_range / 20;
 			navigation.camera_position += glm::vec3(inverse(get_camera_view()) * glm::vec4(direction, 0));
 			area->queue_render();
 		}
 	}
+	/* profile */ if (new_time - profile_shown_time >= G_USEC_PER_SEC / 2) {
+		profile_shown_time = new_time;
+		profile_stats->set_text(renderer.profiler.format_stats());
+	}
 }
 
 void Hw2Window::display_mode_changed() {
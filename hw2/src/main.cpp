@@ -1,10 +1,47 @@
+#include "headless.hpp"
 #include "hw2_app.hpp"
+#include "hw2_renderer.hpp"
 #include "object.hpp"
 
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <giomm/init.h>
+
 #include <iostream>
+#include <stdexcept>
 #include <iterator>
 #include <fstream>
 
+/* Renders the animation from the default camera into files, see headless.hpp.
+ * Settings: packed (0 to upload the meshes without Hw2Renderer::packed_verticies, 1 by default),
+ * lod (Hw2Renderer::lod_error in pixels, 0 for no levels of detail, 1 by default),
+ * shadows (0 to draw the shadow map every frame without Hw2Renderer::shadow_cache, 1 by default).
+ */
+static int run_headless(headless_options const &options) {
+	Gio::init();
+	HeadlessContext context(options.width, options.height);
+	Hw2Renderer renderer;
+	renderer.packed_verticies = options.setting<int>("packed", 1) != 0;
+	renderer.lod_error = options.setting<float>("lod", 1);
+	renderer.shadow_cache = options.setting<int>("shadows", 1) != 0;
+	/* the initial camera of the window */
+	renderer.camera_view = glm::translate(-glm::vec3(0, .2, .2));
+
+	std::string error;
+	bool const ok{renderer.gl_init(error) && context.run(options, [&](float progress, std::string &) {
+		renderer.progress = progress;
+		renderer.gl_render(options.width, options.height);
+		return true;
+	}, error) && write_profile(renderer.profiler, options, error)};
+	renderer.gl_finit();
+	if (!ok) {
+		std::cerr << "ERROR: " << error << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
 int main(int argc, char **argv) {
 //	(void) argc;
 //	(void) argv;
@@ -16,6 +53,15 @@ int main(int argc, char **argv) {
 //		std::cout << obj << std::endl;
 //	}
 
+	try {
+		headless_options options;
+		if (parse_headless_options(argc, argv, options))
+			return run_headless(options);
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
 	try {
 		auto app{Hw2App::create(argc, argv)};
 		app->run();
@@ -0,0 +1,76 @@
+#include "uniform_blocks.hpp"
+
+void UniformBlocks::gl_init() {
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	orphan();
+}
+
+void UniformBlocks::gl_finit() {
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void UniformBlocks::orphan() {
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	used = 0;
+	frame_written = frame_inverse_written = false;
+}
+
+void UniformBlocks::write(Program::block_t block, void const *data, size_t size) {
+	size_t const offset{(used + alignment - 1) / alignment * alignment};
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	glBindBufferRange(GL_UNIFORM_BUFFER, block, buffer, offset, size);
+	used = offset + size;
+}
+
+void UniformBlocks::begin_frame() {
+	orphan();
+}
+
+void UniformBlocks::set_camera(glm::mat4 const &v, glm::mat4 const &p) {
+	frame.v = v;
+	frame.p = p;
+	frame.vp = p * v;
+	/* v = [R | t] puts the eye at -transpose(R) * t */
+	glm::vec3 const t(v[3]);
+	frame.eye_world = glm::vec4(-glm::dot(glm::vec3(v[0]), t), -glm::dot(glm::vec3(v[1]), t), -glm::dot(glm::vec3(v[2]), t), 1);
+	frame_inverse_computed = false;
+	frame_written = frame_inverse_written = false;
+}
+
+void UniformBlocks::set_object(Program const &program, glm::mat4 const &m) {
+	/* room for all four blocks, so that none of them is orphaned after being bound */
+	size_t constexpr most{sizeof(frame_block) + sizeof(frame_inverse_block) + 2 * sizeof(object_block)};
+	if (used + most + 4 * alignment > capacity)
+		orphan();
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+
+	if (program.uses_block(Program::FRAME_BLOCK) && !frame_written) {
+		write(Program::FRAME_BLOCK, &frame, sizeof(frame));
+		frame_written = true;
+	}
+	if (program.uses_block(Program::FRAME_INVERSE_BLOCK) && !frame_inverse_written) {
+		if (!frame_inverse_computed) {
+			frame_inverse.v_inv = glm::inverse(frame.v);
+			frame_inverse.p_inv = glm::inverse(frame.p);
+			frame_inverse.vp_inv = glm::inverse(frame.vp);
+			frame_inverse_computed = true;
+		}
+		write(Program::FRAME_INVERSE_BLOCK, &frame_inverse, sizeof(frame_inverse));
+		frame_inverse_written = true;
+	}
+
+	bool const inverse{program.uses_block(Program::OBJECT_INVERSE_BLOCK)};
+	if (!program.uses_block(Program::OBJECT_BLOCK) && !inverse)
+		return;
+	object_block const object{m, frame.v * m, frame.vp * m};
+	if (program.uses_block(Program::OBJECT_BLOCK))
+		write(Program::OBJECT_BLOCK, &object, sizeof(object));
+	if (inverse) {
+		object_block const object_inverse{glm::inverse(object.m), glm::inverse(object.mv), glm::inverse(object.mvp)};
+		write(Program::OBJECT_INVERSE_BLOCK, &object_inverse, sizeof(object_inverse));
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <epoxy/gl.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Counts the samples of named draws passing the depth and stencil tests per frame, with GL_SAMPLES_PASSED,
+ * and never stalls for them, the way GpuProfiler times passes:
+ * the queries of a frame are read frames_in_flight frames later, and a frame whose results are not there yet is skipped.
+ * A name may be counted several times in a frame, the counts add up, but the counted blocks may not nest.
+ * Like GpuProfiler passes, the counts of a name are kept apart by a variant, such as the light count,
+ * for the last max_variants variants.
+ */
+class FragmentCounter {
+public:
+	static size_t constexpr frames_in_flight{4};
+	static size_t constexpr max_variants{16};
+
+	/* Counts the rest of the enclosing block */
+	class count {
+	private:
+		FragmentCounter &counter;
+
+	public:
+		count(FragmentCounter &counter, char const *name, uint64_t variant);
+		count(count const &other) = delete;
+		~count();
+	};
+
+private:
+	struct query {
+		std::string name;
+		uint64_t variant;
+		GLuint id;
+	};
+	struct frame {
+		std::vector<query> queries;
+		size_t used{0};
+		bool pending{false};
+	};
+	struct variant_count {
+		uint64_t variant;
+		uint64_t count;
+	};
+
+	frame frames[frames_in_flight];
+	size_t current{0};
+	bool in_frame{false};
+	/* the latest frame count of every name and variant, the last used variant at the back */
+	std::map<std::string, std::deque<variant_count>> counts;
+
+	void collect(frame &f);
+
+public:
+	FragmentCounter() = default;
+	FragmentCounter(FragmentCounter const &other) = delete;
+
+	void gl_finit();
+
+	/* Starts a frame, collecting the one frames_in_flight frames ago */
+	void begin_frame();
+
+	/* The latest count of the name by its variant, in the variant order */
+	std::vector<std::pair<uint64_t, uint64_t>> get_counts(std::string const &name) const;
+};
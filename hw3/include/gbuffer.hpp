@@ -0,0 +1,51 @@
+#pragma once
+
+#include <epoxy/gl.h>
+
+#include <string>
+
+/* The framebuffer of the deferred passes and its textures.
+ * The textures are allocated once per size, as immutable storage where GL 4.2 or ARB_texture_storage allows,
+ * and the framebuffer is checked for completeness right after, so an unchanged size costs nothing per frame.
+ *
+ * The wide layout keeps albedo and world normals in RGB16F textures, 14 bytes a pixel with the 16-bit depth.
+ * The compact one keeps albedo in SRGB8_ALPHA8, written with GL_FRAMEBUFFER_SRGB enabled,
+ * and octahedral normals in RG16, 10 bytes a pixel. Shaders encode and decode the normals with res/gbuffer.glsl.
+ * Positions are not stored in either: they are reconstructed from the depth.
+ */
+class GBuffer {
+public:
+	enum texture_t {
+		ALBEDO,
+		NORMAL,
+		DEPTH,
+		TEXTURES_COUNT
+	};
+
+private:
+	GLuint framebuffer{0};
+	GLuint textures[TEXTURES_COUNT]{};
+	int width{0}, height{0};
+	bool immutable{false};
+	bool compact{false};
+
+	bool allocate(std::string &error);
+	void free_textures();
+
+public:
+	GBuffer() = default;
+	GBuffer(GBuffer const &other) = delete;
+
+	void gl_init();
+	void gl_finit();
+
+	/* Layout of the following frames, takes effect on the next resize */
+	void set_compact(bool compact);
+	bool is_compact() const;
+	/* Reallocates the textures if the size or the layout changed, returns false with the error set if the framebuffer is incomplete */
+	bool resize(int width, int height, std::string &error);
+	/* Binds the framebuffer with its viewport for drawing into the textures */
+	void bind() const;
+
+	GLuint get_texture(texture_t texture) const;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <epoxy/gl.h>
+
+#include <array>
+#include <cstddef>
+
+/* The GL state the renderer sets, with the calls that would not change it skipped.
+ * Nothing is known after invalidate(), so the next setting of everything is issued; with caching off, every setting is.
+ */
+class GlState {
+public:
+	static size_t constexpr texture_units{8};
+
+	/* Fixed-function state of a group of draws; the defaults are what the renderer starts a frame with */
+	struct raster {
+		bool depth_test{true};
+		GLenum depth_func{GL_LESS};
+		bool depth_mask{true};
+		bool color_mask{true};
+		/* additive, GL_ONE + GL_ONE */
+		bool blend{false};
+		bool cull{false};
+		GLenum cull_face{GL_BACK};
+		bool stencil{false};
+		bool srgb{false};
+	};
+
+private:
+	template<typename T>
+	struct cached {
+		T value;
+		bool known{false};
+	};
+
+	bool caching{true};
+	size_t calls{0};
+
+	cached<Program const *> program;
+	cached<GLuint> active_texture;
+	/* target and name */
+	cached<std::array<GLuint, 2>> textures[texture_units];
+	cached<bool> depth_test, depth_mask, color_mask, blend, cull, stencil, srgb;
+	cached<GLenum> depth_func, cull_face;
+	cached<std::array<GLuint, 2>> blend_func;
+	/* func, ref, mask */
+	cached<std::array<GLuint, 3>> stencil_func;
+	/* sfail, dpfail, dppass of the front and the back faces */
+	cached<std::array<GLenum, 3>> stencil_ops[2];
+
+	/* Whether the value needs to be set, counting the call if so */
+	template<typename T>
+	bool change(cached<T> &c, T const &value);
+	void set_capability(cached<bool> &c, GLenum capability, bool enabled);
+
+public:
+	void set_caching(bool caching);
+	/* Forgets the state, for when something else may have changed it */
+	void invalidate();
+	/* Sets the defaults back: no program, no textures, the default raster and stencil */
+	void reset();
+	/* Calls issued since the last take_calls, which clears them */
+	size_t take_calls();
+
+	void use_program(Program const *program);
+	void bind_texture(GLuint unit, GLenum target, GLuint texture);
+	void set_raster(raster const &r);
+	void set_stencil_func(GLenum func, GLint ref, GLuint mask);
+	/* face is GL_FRONT, GL_BACK or GL_FRONT_AND_BACK */
+	void set_stencil_op(GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass);
+};
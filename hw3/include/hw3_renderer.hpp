@@ -0,0 +1,176 @@
+#pragma once
+
+#include "fragment_counter.hpp"
+#include "frustum.hpp"
+#include "gbuffer.hpp"
+#include "gl_state.hpp"
+#include "gpu_profiler.hpp"
+#include "light_tiles.hpp"
+#include "render_queue.hpp"
+#include "scene_object.hpp"
+#include "program.hpp"
+#include "uniform_blocks.hpp"
+
+#define GLM_FORCE_SWIZZLE
+#include <glm/mat4x4.hpp>
+
+#include <epoxy/gl.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/* The scene and everything drawing it, with no widgets attached:
+ * Hw3Window drives it from a Gtk::GLArea, the headless mode from an offscreen framebuffer.
+ */
+class Hw3Renderer {
+public:
+	enum display_mode_t {
+		DEFERRED,
+		DEFERRED_LIGHTS,
+		DEFERRED_LIGHTS_CULLED,
+		BUFFER_ALBEDO,
+		BUFFER_NORMAL,
+		BUFFER_DEPTH,
+		SCENE_SINGLE_LIGHT,
+		DEFERRED_TILED,
+		DEFERRED_STENCIL
+	};
+
+	/* Frame state, set before gl_render */
+	float progress{0};
+	display_mode_t display_mode{DEFERRED};
+	/* G-buffer layout, see GBuffer */
+	bool compact_gbuffer{false};
+	/* Uploads the meshes as SceneObject::PACKED_VERTICIES, read by gl_init */
+	bool packed_verticies{true};
+	/* Largest error of the levels of detail of the bunnies on the screen, in pixels, see SceneObject::select_lod;
+	 * gl_init builds no levels with 0
+	 */
+	float lod_error{1};
+	/* Draws through a sorted RenderQueue and skips the state calls that change nothing;
+	 * off, every group of draws sets its whole state and resets it after, as gl_render used to
+	 */
+	bool render_queue{true};
+	glm::mat4 camera_view{1};
+
+	float const view_range{.2};
+
+	/* Times every pass of gl_render */
+	GpuProfiler profiler;
+	/* Counts the samples that shade lights by the light count: the light volumes, or the full screen pass of tiles */
+	FragmentCounter fragments;
+
+private:
+	struct _gl {
+		std::unique_ptr<Program>
+			buffer_program,
+			deferred_program,
+			light_program,
+			scene_program,
+			stencil_program,
+			texture_program,
+			tiled_program;
+		UniformBlocks blocks;
+		GlState state;
+		RenderQueue queue;
+		/* of the frame */
+		size_t draws;
+		/* the id of the view of texture_program, see queue_texture */
+		int texture_view;
+
+		static float constexpr fov{60};
+		GBuffer gbuffer;
+
+		/* inputs of the tiled pass: the lights, the ranges of the tiles and their lists, see LightTiles */
+		struct texture_buffer {
+			GLuint buffer, texture;
+		};
+		texture_buffer tiled_lights, tiled_ranges, tiled_indices;
+		GLint max_texture_buffer_size;
+
+		struct light {
+			glm::vec3 position;
+			glm::vec3 color;
+			float power;
+			float speed;
+			float radius;
+		};
+
+		static int constexpr acolytes_count{6};
+		std::unique_ptr<SceneObject> statue, acolytes[acolytes_count], base_plane;
+		/* all of the above in the drawing order, and those in view of the frame */
+		std::vector<SceneObject const *> objects, visible_objects;
+		/* the levels of detail of the visible objects */
+		std::vector<size_t> visible_lods;
+
+		std::unique_ptr<SceneObject> light_sphere, texture_rect;
+		std::vector<light> lights;
+		/* the lights in view as instances of light_sphere, refilled every frame */
+		std::vector<SceneObject::instance> light_instances;
+
+		/* scratch of cull */
+		std::vector<glm::vec4> spheres;
+		std::vector<size_t> visible;
+	} gl;
+
+	/* Source of the new lights */
+	std::default_random_engine random;
+
+	LightTiles light_tiles;
+
+	/* Fills gl.visible_objects and gl.light_instances with what the camera of the frame may see, counting the rest in profiler */
+	void cull(Frustum const &frustum);
+	/* Fills gl.visible_lods for the camera of the frame and a viewport height pixels high, counting the faces in profiler */
+	void select_lods(glm::mat4 const &proj, int height);
+
+	/* Passes of gl.queue, in their order */
+	enum queue_pass_t : uint8_t {
+		GBUFFER_PASS,
+		SCENE_PASS,
+		TEXTURE_PASS,
+		VOLUMES_PASS,
+		SPHERES_PASS,
+		SPHERES_CULLED_PASS
+	};
+
+	/* Sets the passes of gl.queue for the frame */
+	void set_queue_passes();
+	/* Uniforms of the first light, and of the G-buffer on the units 0 to 2 */
+	void set_light_uniforms(Program const &program) const;
+	void set_gbuffer_uniforms(Program const &program) const;
+
+	/* Record into gl.queue, for the camera of the frame set to gl.blocks */
+	void queue_objects(queue_pass_t pass, Program const &program);
+	/* The full screen view of the G-buffer with the given id of texture_program, 3 is the ambient light */
+	void queue_texture(int id);
+	void queue_lights(queue_pass_t pass, Program const &program);
+	/* Replays gl.queue */
+	void gl_flush();
+
+	/* Draw right away through gl.state */
+	/* Shades only the pixels whose G-buffer depth is inside a light volume, see gl_draw_lights_stencil */
+	void gl_render_stencil();
+	bool gl_render_tiled(std::string &error);
+	void gl_draw_lights_stencil();
+
+public:
+	/* Lights are random, the same seed gives the same lights */
+	explicit Hw3Renderer(unsigned seed);
+
+	/* Keeps the first lights and makes up the new ones */
+	void set_lights_count(size_t count);
+
+	/* Need a current GL context, return false with the error set on failure */
+	bool gl_init(std::string &error);
+	void gl_finit();
+	/* Draws into the bound framebuffer of the given size */
+	bool gl_render(int width, int height, std::string &error);
+
+	/* GPU time and samples of the lighting by the light count:
+	 * volumes (the deferred modes) against stencil (the stencil mode) and tiles (the tiled mode),
+	 * the last GpuProfiler::max_variants light counts
+	 */
+	std::string format_lighting() const;
+};
@@ -1,22 +1,21 @@
 #pragma once
 
-#include "scene_object.hpp"
-#include "program.hpp"
+#include "hw3_renderer.hpp"
 
 #define GLM_FORCE_SWIZZLE
 #include <glm/mat4x4.hpp>
 
 #include <gtkmm/builder.h>
 #include <gtkmm/button.h>
+#include <gtkmm/checkbutton.h>
 #include <gtkmm/combobox.h>
 #include <gtkmm/eventbox.h>
 #include <gtkmm/glarea.h>
+#include <gtkmm/label.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/togglebutton.h>
 #include <gtkmm/window.h>
 
-#include <epoxy/gl.h>
-
 #include <memory>
 
 class Hw3Window: public Gtk::Window {
@@ -27,50 +26,17 @@ private:
 	Gtk::EventBox *area_eventbox;
 	Gtk::ToggleButton *animate;
 	Gtk::ComboBox *display_mode_combobox;
-	Gtk::Button *reset_position, *reset_animation;
+	Gtk::CheckButton *compact_gbuffer;
+	Gtk::Button *reset_position, *reset_animation, *profile_export;
+	Gtk::Label *profile_stats, *lighting_stats;
 
 	Glib::RefPtr<Gtk::ListStore> display_mode_list_store;
 	Glib::RefPtr<Gtk::Adjustment> lights_adjustment;
 
-	enum display_mode_t {
-		DEFERRED,
-		DEFERRED_LIGHTS,
-		DEFERRED_LIGHTS_CULLED,
-		BUFFER_ALBEDO,
-		BUFFER_NORMAL,
-		BUFFER_DEPTH,
-		SCENE_SINGLE_LIGHT
-	};
-
-	struct _gl {
-		std::unique_ptr<Program>
-			buffer_program,
-			deferred_program,
-			light_program,
-			scene_program,
-			texture_program;
-
-		static float constexpr fov{60};
-		GLuint framebuffer;
-		GLuint albedo_texture, normal_texture, depth_texture;
-
-		struct light {
-			glm::vec3 position;
-			glm::vec3 color;
-			float power;
-			float speed;
-			float radius;
-		};
-
-		static int constexpr acolytes_count{6};
-		std::unique_ptr<SceneObject> statue, acolytes[acolytes_count], base_plane;
-
-		std::unique_ptr<SceneObject> light_sphere, texture_rect;
-		std::vector<light> lights;
-	} gl;
+	Hw3Renderer renderer;
 
 	guint ticker_id;
-	float view_range;
+	gint64 profile_shown_time{0};
 
 	struct {
 		enum {
@@ -98,19 +64,13 @@ private:
 	void gl_init();
 	void gl_finit();
 	bool gl_render(Glib::RefPtr<Gdk::GLContext> const &context);
-	void gl_render_buffer(Program const &program, glm::mat4 const &view, glm::mat4 const &proj);
-	void gl_render_lights(glm::mat4 const &view, glm::mat4 const &proj);
-	void gl_render_deferred(glm::mat4 const &view, glm::mat4 const &proj);
-	void gl_render_texture(int id);
-	void gl_draw_objects(Program const &program, glm::mat4 const &v, glm::mat4 const &p);
-	void gl_draw_lights(Program const &program, glm::mat4 const &v, glm::mat4 const &p);
-	void gl_draw_object(SceneObject const &object, Program const &program, glm::mat4 const &v, glm::mat4 const &p);
 
 	glm::mat4 get_camera_view() const;
 
 	void animate_toggled();
 	void reset_position_clicked();
 	void reset_animation_clicked();
+	void profile_export_clicked();
 	void lights_changed();
 	void display_mode_changed();
 	bool mouse_pressed(GdkEventButton *event);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "scene_object.hpp"
+#include "thread_pool.hpp"
+
+#define GLM_FORCE_SWIZZLE
+#include <glm/mat4x4.hpp>
+
+#include <epoxy/gl.h>
+
+#include <vector>
+
+/* Lights binned into screen tiles of tile_size pixels for the tiled deferred pass:
+ * every tile gets the list of the lights whose sphere may cover some of its pixels.
+ * Binning is split between the threads of its pool once there are enough lights, and stays on the calling thread before.
+ */
+class LightTiles {
+public:
+	static int constexpr tile_size{32};
+
+private:
+	/* tiles covered by a light, [x0, x1) x [y0, y1), empty if it is not seen */
+	struct rect {
+		int x0, y0, x1, y1;
+	};
+
+	ThreadPool pool;
+
+	int columns{0}, rows{0};
+	std::vector<rect> rects;
+	/* kept between frames, so that they do not reallocate */
+	std::vector<std::vector<GLuint>> tile_lists;
+	std::vector<GLuint> ranges, indices;
+
+	rect project(glm::vec4 const &position_radius, glm::mat4 const &v, glm::mat4 const &p, int width, int height) const;
+
+public:
+	/* Bins the lights (positions and radii of the instances) for a viewport of the given size.
+	 * The projection is to be a symmetric perspective one, as glm::perspective makes.
+	 */
+	void bin(std::vector<SceneObject::instance> const &lights, glm::mat4 const &v, glm::mat4 const &p, int width, int height);
+
+	int get_columns() const;
+	int get_rows() const;
+	/* Per tile, row by row from the bottom: offset of its list in get_indices() and the list length */
+	std::vector<GLuint> const &get_ranges() const;
+	/* Light numbers of the tile lists, one after another */
+	std::vector<GLuint> const &get_indices() const;
+};
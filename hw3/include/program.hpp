@@ -2,25 +2,111 @@
 
 #include <epoxy/gl.h>
 
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
+/* Linked shader program. Active uniforms and attributes are reflected once at link time,
+ * so looking a location up is a search over a few integers: no strings and no driver queries.
+ */
 class Program {
+public:
+	/* FNV-1a hash of a uniform or attribute name.
+	 * Declare names as static constexpr constants, so that they are hashed at compile time.
+	 * Debug builds also keep the text, valid while the name is, to check lookups against hash collisions.
+	 */
+	class name {
+	private:
+		uint32_t value;
+#ifndef NDEBUG
+		char const *text;
+		size_t length;
+#endif
+
+		static constexpr uint32_t hash(char const *s, size_t length) {
+			uint32_t result{2166136261u};
+			for (size_t i{0}; i != length; ++i)
+				result = (result ^ static_cast<unsigned char>(s[i])) * 16777619u;
+			return result;
+		}
+
+	public:
+		template<size_t N>
+		constexpr name(char const (&s)[N]):
+			value{hash(s, N - 1)}
+#ifndef NDEBUG
+			, text{s}, length{N - 1}
+#endif
+		{}
+		explicit name(std::string const &s):
+			value{hash(s.data(), s.size())}
+#ifndef NDEBUG
+			, text{s.data()}, length{s.size()}
+#endif
+		{}
+
+		constexpr uint32_t get() const {
+			return value;
+		}
+#ifndef NDEBUG
+		std::string get_text() const {
+			return {text, length};
+		}
+#endif
+	};
+
+	/* Uniform blocks found by name and bound to the binding point of their number, see UniformBlocks */
+	enum block_t {
+		FRAME_BLOCK,
+		FRAME_INVERSE_BLOCK,
+		OBJECT_BLOCK,
+		OBJECT_INVERSE_BLOCK,
+		BLOCKS_COUNT
+	};
+
 private:
+	struct location {
+		uint32_t hash;
+		GLuint id;
+#ifndef NDEBUG
+		std::string name;
+#endif
+	};
+
 	GLuint id;
+	/* sorted by hash */
+	std::vector<location> uniforms, attributes;
+	/* which of the blocks are active */
+	bool blocks[BLOCKS_COUNT]{};
 
 	static GLuint build_shader(GLenum type, std::string const &source, std::string &error);
+	static GLuint find(std::vector<location> const &table, name key);
+	bool reflect(std::string &error);
 
 public:
 	static GLuint constexpr no_id{static_cast<GLuint>(-1)};
 
+	/* Every program gets these locations for the vertex attributes, so that one VAO layout fits them all */
+	static GLuint constexpr
+		position_location{0},
+		normal_location{1},
+		color_location{2},
+		instance_position_location{3},
+		instance_color_location{4};
+
 	static std::unique_ptr<Program> build_program(std::initializer_list<std::tuple<GLenum, std::string>> sources, std::string &error);
 
 	Program(GLuint program);
 	~Program();
 
-	GLuint get_uniform(std::string const &name) const;
-	GLuint get_attribute(std::string const &name) const;
+	/* no_id if there is no such active uniform or attribute, like glGetUniformLocation.
+	 * An array is found as "name" and "name[0]", its other elements follow that location.
+	 */
+	GLuint get_uniform(name key) const;
+	GLuint get_attribute(name key) const;
+	/* false if the program has no such active block, so whatever it would hold needs not be computed */
+	bool uses_block(block_t block) const;
 
 	void use() const;
 };
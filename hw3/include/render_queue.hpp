@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gl_state.hpp"
+#include "program.hpp"
+#include "scene_object.hpp"
+#include "uniform_blocks.hpp"
+
+#include <epoxy/gl.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* Draws recorded with packed sort keys and replayed through GlState.
+ * A key holds, from the highest bits, the pass, the program, the textures and the mesh, each as the order of its first
+ * submission, then the index of the draw; the keys are radix-sorted, so the draws sharing a program and textures
+ * run together and the state between them is set once.
+ */
+class RenderQueue {
+public:
+	static size_t constexpr max_textures{3};
+	/* the 16 bits of the index */
+	static size_t constexpr max_draws{1 << 16};
+
+	/* Draws of a pass share the raster state and run after those of the passes with lower ids */
+	struct pass {
+		GlState::raster raster;
+		/* Sets the uniforms of a program, in use, for the pass; called whenever the pass or the program changes */
+		std::function<void(Program const &)> setup;
+	};
+
+	struct draw {
+		Program const *program;
+		/* GL_TEXTURE_2D on the units from 0, 0 for none */
+		std::array<GLuint, max_textures> textures;
+		SceneObject const *mesh;
+		/* all the instances of the mesh, see SceneObject::draw_instanced */
+		bool instanced;
+		/* level of detail of a draw that is not instanced */
+		size_t lod{0};
+	};
+
+private:
+	std::vector<pass> passes;
+	std::vector<draw> draws;
+	std::vector<uint64_t> keys, sorted;
+
+	/* the first submissions of the frame, which give the ids of the keys */
+	std::vector<Program const *> programs;
+	std::vector<std::array<GLuint, max_textures>> texture_sets;
+	std::vector<SceneObject const *> meshes;
+
+	void sort();
+
+public:
+	void set_pass(uint8_t id, pass p);
+	/* Draws after flush; throws std::length_error past max_draws, flush before */
+	void submit(uint8_t pass, draw const &d);
+	/* Replays the draws and forgets them, returns their count.
+	 * Unsorted, replays them in order and resets the state after every run of draws with the same pass, program
+	 * and textures, the way the renderer used to set and reset it around every group of draws.
+	 */
+	size_t flush(GlState &state, UniformBlocks &blocks, bool sort_draws);
+};
@@ -7,7 +7,9 @@ layout(location = 0) out vec3 output_aldego;
 layout(location = 1) out vec3 output_normal_world;
 /* implicit: depth */
 
+vec3 encode_normal(vec3 normal);
+
 void main() {
 	output_aldego = fragment_color;
-	output_normal_world = normalize(fragment_normal_world);
+	output_normal_world = encode_normal(normalize(fragment_normal_world));
 }
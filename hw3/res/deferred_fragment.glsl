@@ -1,31 +1,49 @@
 #version 330 core
+#extension GL_ARB_shader_image_load_store : enable
 
-uniform mat4 v;
-uniform mat4 vp;
-uniform mat4 p_inv;
-uniform mat4 vp_inv;
+#ifdef GL_ARB_shader_image_load_store
+/* the stencil test of gl_draw_lights_stencil rejects fragments before they are shaded */
+layout(early_fragment_tests) in;
+#endif
+
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform frame_inverse {
+	mat4 v_inv;
+	mat4 p_inv;
+	mat4 vp_inv;
+};
 
 uniform sampler2D albedo_texture;
 uniform sampler2D normal_texture;
 uniform sampler2D depth_texture;
 
-uniform vec3 light_world;
-uniform vec3 light_color;
-uniform float light_power;
-uniform float light_radius;
+flat in vec3 fragment_light_world;
+flat in vec3 fragment_light_color;
+flat in float fragment_light_power;
+flat in float fragment_light_radius;
 
 out vec3 output_color;
 
+vec3 decode_normal(vec3 texel);
+
 void main() {
 	vec2 size = textureSize(albedo_texture, 0);
 	vec2 position_in_texture = gl_FragCoord.xy / size;
 	vec3  albedo            = texture(  albedo_texture, position_in_texture).rgb;
-	vec3  normal_world      = texture(  normal_texture, position_in_texture).xyz;
+	vec3  normal_world      = decode_normal(texture(normal_texture, position_in_texture).xyz);
 	float depth_camera_norm = texture(   depth_texture, position_in_texture).r;
+	/* the fragments out of the light add nothing instead of being discarded:
+	 * so the samples passed are the fragments shaded, and the stencil mode clears their marks too
+	 */
+	output_color = vec3(0);
 	if (depth_camera_norm == 1.0)
-		discard;
+		return;
 
-	gl_FragDepth = depth_camera_norm;
 	vec3 position_proj = vec3(position_in_texture, depth_camera_norm) * 2 - vec3(1, 1, 1);
 	vec4 position_world_pre = vp_inv * vec4(position_proj, 1);
 	vec4 position_camera_pre = p_inv * vec4(position_proj, 1);
@@ -35,12 +53,12 @@ void main() {
 	vec3 position_world = position_world_pre.xyz;
 	vec3 position_camera = position_camera_pre.xyz;
 
-	float light_distance = length(position_world - light_world);
-	if (light_distance > light_radius)
-		discard;
+	float light_distance = length(position_world - fragment_light_world);
+	if (light_distance > fragment_light_radius)
+		return;
 
 	vec3 normal_camera = normalize((v * vec4(normal_world, 0)).xyz);
-	vec3 light_camera = (v * vec4(light_world, 1)).xyz;
+	vec3 light_camera = (v * vec4(fragment_light_world, 1)).xyz;
 	vec3 toeye_camera = -position_camera;
 	vec3 tolight_camera = light_camera - position_camera;
 
@@ -53,8 +71,8 @@ void main() {
 	vec3 e = normalize(toeye_camera);
 	float cos_alpha = clamp(dot(e, r), 0, 1);
 
-	float dist = 1 / (light_distance * light_distance) - 1 / (light_radius * light_radius);
-	output_color = dist * light_power * light_color * (
+	float dist = 1 / (light_distance * light_distance) - 1 / (fragment_light_radius * fragment_light_radius);
+	output_color = dist * fragment_light_power * fragment_light_color * (
 		diffuse_color * cos_theta +
 		specular_color * pow(cos_alpha, 5)
 	);
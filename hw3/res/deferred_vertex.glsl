@@ -1,15 +1,37 @@
 #version 330 core
 
-uniform mat4 m;
-uniform mat4 mvp;
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
 
 in vec3 vertex_position_model;
 in vec3 vertex_normal_model;
+/* xyz: the light, w: its radius */
+in vec4 instance_position;
+/* rgb: the color of the light, a: its power */
+in vec4 instance_color;
 
 out vec3 fragment_light_sphere_color;
+flat out vec3 fragment_light_world;
+flat out vec3 fragment_light_color;
+flat out float fragment_light_power;
+flat out float fragment_light_radius;
 
 void main() {
-	gl_Position = mvp * vec4(vertex_position_model, 1);
+	vec3 position_world = instance_position.xyz + instance_position.w * (m * vec4(vertex_position_model, 1)).xyz;
+	gl_Position = vp * vec4(position_world, 1);
+	fragment_light_world = instance_position.xyz;
+	fragment_light_color = instance_color.rgb;
+	fragment_light_power = instance_color.a;
+	fragment_light_radius = instance_position.w;
 
 	vec3 normal_world = normalize((m * vec4(vertex_normal_model, 0)).xyz);
 	fragment_light_sphere_color = vec3(1, 1, 1) *
@@ -0,0 +1,33 @@
+#version 330 core
+
+/* Normals of the G-buffer as the layout of GBuffer keeps them.
+ * Linked as one more fragment shader into the programs writing or reading the G-buffer, which declare:
+ *   vec3 encode_normal(vec3 normal);
+ *   vec3 decode_normal(vec3 texel);
+ */
+
+/* octahedral normals in [0, 1]^2 instead of plain ones */
+uniform bool gbuffer_compact;
+
+/* The sphere is projected onto the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper one */
+vec2 octahedral_fold(vec2 v) {
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 encode_normal(vec3 normal) {
+	if (!gbuffer_compact)
+		return normal;
+	vec3 n = normal / (abs(normal.x) + abs(normal.y) + abs(normal.z));
+	vec2 e = n.z >= 0.0 ? n.xy : octahedral_fold(n.xy);
+	return vec3(e * .5 + .5, 0);
+}
+
+vec3 decode_normal(vec3 texel) {
+	if (!gbuffer_compact)
+		return texel;
+	vec2 e = texel.xy * 2 - 1;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
@@ -1,20 +1,32 @@
 #version 330 core
 
-uniform mat4 m;
-uniform mat4 mvp;
-
-uniform vec3 light_color;
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
 
 in vec3 vertex_position_model;
 in vec3 vertex_normal_model;
+/* xyz: the light, w: its radius */
+in vec4 instance_position;
+/* rgb: the color of the light, a: its power */
+in vec4 instance_color;
 
 out vec3 fragment_light_sphere_color;
 
 void main() {
-	gl_Position = mvp * vec4(vertex_position_model, 1);
+	vec3 position_world = instance_position.xyz + instance_position.w * (m * vec4(vertex_position_model, 1)).xyz;
+	gl_Position = vp * vec4(position_world, 1);
 
 	vec3 normal_world = normalize((m * vec4(vertex_normal_model, 0)).xyz);
-	fragment_light_sphere_color = light_color *
+	fragment_light_sphere_color = instance_color.rgb *
 		(dot(vec3(0, 1, 0), normal_world) + 1.25) / 2.5;
 /*       \______________________[-1, 1]_/
  *                              \___[.25, 2.25]_/
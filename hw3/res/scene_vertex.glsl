@@ -1,9 +1,16 @@
 #version 330 core
 
-uniform mat4 m;
-uniform mat4 v;
-uniform mat4 mv;
-uniform mat4 mvp;
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
 uniform vec3 light_world;
 
 in vec3 vertex_position_model;
@@ -0,0 +1,22 @@
+#version 330 core
+
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
+
+in vec3 vertex_position_model;
+/* xyz: the light, w: its radius */
+in vec4 instance_position;
+
+void main() {
+	vec3 position_world = instance_position.xyz + instance_position.w * (m * vec4(vertex_position_model, 1)).xyz;
+	gl_Position = vp * vec4(position_world, 1);
+}
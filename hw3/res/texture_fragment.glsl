@@ -9,12 +9,14 @@ in vec2 fragment_position;
 
 out vec3 output_color;
 
+vec3 decode_normal(vec3 texel);
+
 void main() {
 	gl_FragDepth = 1;
 	if (id == 0)
 		output_color = texture(albedo, fragment_position).rgb;
 	if (id == 1)
-		output_color = texture(normal, fragment_position).xyz / 2 + vec3(.5, .5, .5);
+		output_color = decode_normal(texture(normal, fragment_position).xyz) / 2 + vec3(.5, .5, .5);
 	if (id == 2)
 		output_color = vec3(1, 1, 1) * texture(depth, fragment_position).r;
 	if (id == 3) {
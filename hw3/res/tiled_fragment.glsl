@@ -0,0 +1,89 @@
+#version 330 core
+
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform frame_inverse {
+	mat4 v_inv;
+	mat4 p_inv;
+	mat4 vp_inv;
+};
+
+uniform sampler2D albedo_texture;
+uniform sampler2D normal_texture;
+uniform sampler2D depth_texture;
+
+/* two texels per light: position and radius, color and power */
+uniform samplerBuffer lights;
+/* per tile: offset of its list in tile_lights and the list length */
+uniform usamplerBuffer tiles;
+uniform usamplerBuffer tile_lights;
+uniform int tile_size;
+uniform int tiles_columns;
+
+in vec2 fragment_position;
+
+out vec3 output_color;
+
+vec3 decode_normal(vec3 texel);
+
+void main() {
+	vec2 size = textureSize(albedo_texture, 0);
+	vec2 position_in_texture = gl_FragCoord.xy / size;
+	vec3  albedo            = texture(  albedo_texture, position_in_texture).rgb;
+	vec3  normal_world      = decode_normal(texture(normal_texture, position_in_texture).xyz);
+	float depth_camera_norm = texture(   depth_texture, position_in_texture).r;
+
+	/* the ambient part, as the texture pass does it */
+	gl_FragDepth = depth_camera_norm;
+	output_color = albedo * .15;
+	if (depth_camera_norm == 1.0)
+		return;
+
+	vec3 position_proj = vec3(position_in_texture, depth_camera_norm) * 2 - vec3(1, 1, 1);
+	vec4 position_world_pre = vp_inv * vec4(position_proj, 1);
+	vec4 position_camera_pre = p_inv * vec4(position_proj, 1);
+	position_world_pre /= position_world_pre.w;
+	position_camera_pre /= position_camera_pre.w;
+
+	vec3 position_world = position_world_pre.xyz;
+	vec3 position_camera = position_camera_pre.xyz;
+
+	vec3 normal_camera = normalize((v * vec4(normal_world, 0)).xyz);
+	vec3 toeye_camera = -position_camera;
+	vec3 e = normalize(toeye_camera);
+
+	vec3 diffuse_color = albedo;
+	vec3 specular_color = vec3(.1, .1, .1);
+
+	ivec2 tile = ivec2(gl_FragCoord.xy) / tile_size;
+	uvec2 range = texelFetch(tiles, tile.y * tiles_columns + tile.x).xy;
+	for (uint i = 0u; i != range.y; ++i) {
+		int light = int(texelFetch(tile_lights, int(range.x + i)).r);
+		vec4 light_position_radius = texelFetch(lights, 2 * light);
+		vec4 light_color_power = texelFetch(lights, 2 * light + 1);
+		vec3 light_world = light_position_radius.xyz;
+		float light_radius = light_position_radius.w;
+
+		float light_distance = length(position_world - light_world);
+		if (light_distance > light_radius)
+			continue;
+
+		vec3 light_camera = (v * vec4(light_world, 1)).xyz;
+		vec3 tolight_camera = light_camera - position_camera;
+
+		vec3 l = normalize(tolight_camera);
+		float cos_theta = clamp(dot(normal_camera, l), 0, 1);
+		vec3 r = reflect(-l, normal_camera);
+		float cos_alpha = clamp(dot(e, r), 0, 1);
+
+		float dist = 1 / (light_distance * light_distance) - 1 / (light_radius * light_radius);
+		output_color += dist * light_color_power.a * light_color_power.rgb * (
+			diffuse_color * cos_theta +
+			specular_color * pow(cos_alpha, 5)
+		);
+	}
+}
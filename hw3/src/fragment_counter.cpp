@@ -0,0 +1,86 @@
+#include "fragment_counter.hpp"
+
+#include <algorithm>
+
+FragmentCounter::count::count(FragmentCounter &counter, char const *name, uint64_t variant):
+	counter(counter)
+{
+	if (!counter.in_frame)
+		return;
+	auto &f{counter.frames[counter.current]};
+	if (f.used == f.queries.size()) {
+		GLuint id;
+		glGenQueries(1, &id);
+		f.queries.push_back({{}, 0, id});
+	}
+	auto &q{f.queries[f.used]};
+	q.name = name;
+	q.variant = variant;
+	glBeginQuery(GL_SAMPLES_PASSED, q.id);
+}
+
+FragmentCounter::count::~count() {
+	if (!counter.in_frame)
+		return;
+	glEndQuery(GL_SAMPLES_PASSED);
+	auto &f{counter.frames[counter.current]};
+	++f.used;
+	f.pending = true;
+}
+
+void FragmentCounter::collect(frame &f) {
+	if (!f.pending)
+		return;
+	f.pending = false;
+	/* queries finish in order, so the last one tells about all of them */
+	GLint available;
+	glGetQueryObjectiv(f.queries[f.used - 1].id, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+	std::map<std::pair<std::string, uint64_t>, uint64_t> frame_counts;
+	for (size_t i{0}; i != f.used; ++i) {
+		GLuint64 result;
+		glGetQueryObjectui64v(f.queries[i].id, GL_QUERY_RESULT, &result);
+		frame_counts[{f.queries[i].name, f.queries[i].variant}] += result;
+	}
+	for (auto const &c: frame_counts) {
+		auto &variants{counts[c.first.first]};
+		auto const it{std::find_if(variants.begin(), variants.end(), [&c](variant_count const &v) {
+			return v.variant == c.first.second;
+		})};
+		if (it != variants.end())
+			variants.erase(it);
+		else if (variants.size() == max_variants)
+			variants.pop_front();
+		variants.push_back({c.first.second, c.second});
+	}
+}
+
+void FragmentCounter::gl_finit() {
+	for (auto &f: frames) {
+		for (auto const &q: f.queries)
+			glDeleteQueries(1, &q.id);
+		f.queries.clear();
+		f.used = 0;
+		f.pending = false;
+	}
+	in_frame = false;
+}
+
+void FragmentCounter::begin_frame() {
+	current = (current + 1) % frames_in_flight;
+	auto &f{frames[current]};
+	collect(f);
+	f.used = 0;
+	in_frame = true;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> FragmentCounter::get_counts(std::string const &name) const {
+	std::vector<std::pair<uint64_t, uint64_t>> result;
+	auto const it{counts.find(name)};
+	if (it != counts.end())
+		for (auto const &v: it->second)
+			result.emplace_back(v.variant, v.count);
+	std::sort(result.begin(), result.end());
+	return result;
+}
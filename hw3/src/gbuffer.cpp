@@ -0,0 +1,116 @@
+#include "gbuffer.hpp"
+
+/* Formats of the textures in the wide and the compact layout,
+ * and the format and type glTexImage2D needs when there is no glTexStorage2D
+ */
+static struct {
+	GLenum internal_format, format, type, attachment;
+} const formats[2][GBuffer::TEXTURES_COUNT]{
+	{
+		{GL_RGB16F,            GL_RGB,             GL_FLOAT,          GL_COLOR_ATTACHMENT0},
+		{GL_RGB16F,            GL_RGB,             GL_FLOAT,          GL_COLOR_ATTACHMENT1},
+		{GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_FLOAT,          GL_DEPTH_ATTACHMENT},
+	},
+	{
+		{GL_SRGB8_ALPHA8,      GL_RGBA,            GL_UNSIGNED_BYTE,  GL_COLOR_ATTACHMENT0},
+		{GL_RG16,              GL_RG,              GL_UNSIGNED_SHORT, GL_COLOR_ATTACHMENT1},
+		{GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_FLOAT,          GL_DEPTH_ATTACHMENT},
+	},
+};
+
+void GBuffer::gl_init() {
+	immutable = epoxy_gl_version() >= 42 || epoxy_has_gl_extension("GL_ARB_texture_storage");
+	GLint old_buffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	/* buffers */ {
+		constexpr size_t cnt{2};
+		GLenum buffers[cnt]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+		glDrawBuffers(cnt, buffers);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+}
+
+void GBuffer::gl_finit() {
+	free_textures();
+	glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = 0;
+	width = height = 0;
+}
+
+void GBuffer::free_textures() {
+	glDeleteTextures(TEXTURES_COUNT, textures);
+	for (auto &texture: textures)
+		texture = 0;
+}
+
+bool GBuffer::allocate(std::string &error) {
+	/* immutable storage cannot change its size, so the textures are new every time */
+	free_textures();
+	glGenTextures(TEXTURES_COUNT, textures);
+	GLint old_buffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	auto const &layout{formats[compact]};
+	for (int i{0}; i != TEXTURES_COUNT; ++i) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		if (immutable)
+			glTexStorage2D(GL_TEXTURE_2D, /* levels = */ 1, layout[i].internal_format, width, height);
+		else
+			glTexImage2D(
+				GL_TEXTURE_2D, /* mipmap_level = */ 0,
+				layout[i].internal_format, width, height,
+				0, layout[i].format, layout[i].type, nullptr
+			);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture(GL_FRAMEBUFFER, layout[i].attachment, textures[i], /* mipmap_level = */ 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLenum const status{glCheckFramebufferStatus(GL_FRAMEBUFFER)};
+	glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		error = "Failed to create framebuffer.";
+		return false;
+	}
+	return true;
+}
+
+bool GBuffer::resize(int width, int height, std::string &error) {
+	if (width == this->width && height == this->height)
+		return true;
+	this->width = width;
+	this->height = height;
+	if (!allocate(error)) {
+		/* to try again on the next frame */
+		this->width = this->height = 0;
+		return false;
+	}
+	return true;
+}
+
+void GBuffer::set_compact(bool compact) {
+	if (compact == this->compact)
+		return;
+	this->compact = compact;
+	/* to reallocate on the next resize */
+	width = height = 0;
+}
+
+bool GBuffer::is_compact() const {
+	return compact;
+}
+
+void GBuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+GLuint GBuffer::get_texture(texture_t texture) const {
+	return textures[texture];
+}
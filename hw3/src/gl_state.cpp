@@ -0,0 +1,104 @@
+#include "gl_state.hpp"
+
+template<typename T>
+bool GlState::change(cached<T> &c, T const &value) {
+	if (caching && c.known && c.value == value)
+		return false;
+	c.value = value;
+	c.known = true;
+	++calls;
+	return true;
+}
+
+void GlState::set_capability(cached<bool> &c, GLenum capability, bool enabled) {
+	if (!change(c, enabled))
+		return;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GlState::set_caching(bool caching) {
+	this->caching = caching;
+}
+
+void GlState::invalidate() {
+	bool const caching{this->caching};
+	size_t const calls{this->calls};
+	*this = GlState{};
+	this->caching = caching;
+	this->calls = calls;
+}
+
+void GlState::reset() {
+	use_program(nullptr);
+	for (GLuint unit{texture_units}; unit-- != 0;)
+		if (!textures[unit].known || textures[unit].value[1] != 0)
+			bind_texture(unit, textures[unit].known ? textures[unit].value[0] : GL_TEXTURE_2D, 0);
+	set_raster(raster{});
+	set_stencil_func(GL_ALWAYS, 0, ~0u);
+	set_stencil_op(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_KEEP);
+}
+
+size_t GlState::take_calls() {
+	size_t const result{calls};
+	calls = 0;
+	return result;
+}
+
+void GlState::use_program(Program const *program) {
+	if (!change(this->program, program))
+		return;
+	if (program != nullptr)
+		program->use();
+	else
+		glUseProgram(0);
+}
+
+void GlState::bind_texture(GLuint unit, GLenum target, GLuint texture) {
+	if (!change(textures[unit], {target, texture}))
+		return;
+	if (change(active_texture, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texture);
+}
+
+void GlState::set_raster(raster const &r) {
+	set_capability(depth_test, GL_DEPTH_TEST, r.depth_test);
+	if (change(depth_func, r.depth_func))
+		glDepthFunc(r.depth_func);
+	if (change(depth_mask, r.depth_mask))
+		glDepthMask(r.depth_mask);
+	if (change(color_mask, r.color_mask))
+		glColorMask(r.color_mask, r.color_mask, r.color_mask, r.color_mask);
+	set_capability(blend, GL_BLEND, r.blend);
+	if (r.blend && change(blend_func, {GL_ONE, GL_ONE}))
+		glBlendFunc(GL_ONE, GL_ONE);
+	set_capability(cull, GL_CULL_FACE, r.cull);
+	if (r.cull && change(cull_face, r.cull_face))
+		glCullFace(r.cull_face);
+	set_capability(stencil, GL_STENCIL_TEST, r.stencil);
+	set_capability(srgb, GL_FRAMEBUFFER_SRGB, r.srgb);
+}
+
+void GlState::set_stencil_func(GLenum func, GLint ref, GLuint mask) {
+	if (change(stencil_func, {func, static_cast<GLuint>(ref), mask}))
+		glStencilFunc(func, ref, mask);
+}
+
+void GlState::set_stencil_op(GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass) {
+	std::array<GLenum, 3> const ops{sfail, dpfail, dppass};
+	if (face != GL_FRONT_AND_BACK) {
+		if (change(stencil_ops[face == GL_BACK], ops))
+			glStencilOpSeparate(face, sfail, dpfail, dppass);
+		return;
+	}
+	/* one call for both faces, if any of them changes */
+	bool const front{change(stencil_ops[0], ops)};
+	bool const back{change(stencil_ops[1], ops)};
+	if (front && back)
+		--calls;
+	if (front || back)
+		glStencilOp(sfail, dpfail, dppass);
+}
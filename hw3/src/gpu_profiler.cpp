@@ -0,0 +1,292 @@
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+GpuProfiler::pass::pass(GpuProfiler &profiler, char const *name, uint64_t variant):
+	profiler(profiler)
+{
+	profiler.begin_pass(name, variant);
+}
+
+GpuProfiler::pass::~pass() {
+	profiler.end_pass();
+}
+
+GpuProfiler::GpuProfiler():
+	origin(now())
+{}
+
+uint64_t GpuProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t GpuProfiler::get_samples(vector<pass_samples> &list, string const &name) {
+	for (size_t i{0}; i != list.size(); ++i)
+		if (list[i].name == name)
+			return i;
+	list.push_back({name, {}, {}});
+	return list.size() - 1;
+}
+
+size_t GpuProfiler::get_pass(string const &name) {
+	return get_samples(passes, name);
+}
+
+size_t GpuProfiler::get_track(string const &name) {
+	for (size_t i{0}; i != tracks.size(); ++i)
+		if (tracks[i] == name)
+			return i;
+	tracks.push_back(name);
+	return tracks.size() - 1;
+}
+
+void GpuProfiler::record(size_t track_id, size_t pass_id, uint64_t variant, uint64_t start, uint64_t end) {
+	auto push{[](std::deque<double> &samples, double ms) {
+		samples.push_back(ms);
+		if (samples.size() > window)
+			samples.pop_front();
+	}};
+	auto &p{passes[pass_id]};
+	push(p.durations, (end - start) / 1e6);
+	if (variant != no_variant) {
+		auto it{std::find_if(p.variants.begin(), p.variants.end(), [variant](variant_samples const &v) {
+			return v.variant == variant;
+		})};
+		variant_samples samples{variant, {}};
+		if (it != p.variants.end()) {
+			samples = std::move(*it);
+			p.variants.erase(it);
+		} else if (p.variants.size() == max_variants) {
+			p.variants.pop_front();
+		}
+		push(samples.durations, (end - start) / 1e6);
+		p.variants.push_back(std::move(samples));
+	}
+
+	/* the origin never moves, so a sample from before it is put at it */
+	trace.push_back({track_id, pass_id, (start > origin) ? start - origin : 0, end - start});
+	if (trace.size() > trace_size)
+		trace.pop_front();
+}
+
+void GpuProfiler::collect(frame &f, bool wait) {
+	if (!f.pending)
+		return;
+	f.pending = false;
+	if (!wait) {
+		/* queries finish in order, so the last one tells about all of them */
+		GLint available;
+		glGetQueryObjectiv(f.queries[f.used - 1].end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			++dropped;
+			return;
+		}
+	}
+	size_t const gl_track{get_track("GL")};
+	for (size_t i{0}; i != f.used; ++i) {
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(f.queries[i].begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(f.queries[i].end, GL_QUERY_RESULT, &end);
+		record(gl_track, f.queries[i].pass, f.queries[i].variant, begin + gl_offset, end + gl_offset);
+	}
+}
+
+void GpuProfiler::begin_pass(char const *name, uint64_t variant) {
+	if (!in_frame)
+		return;
+	auto &f{frames[current]};
+	if (f.used == f.queries.size()) {
+		GLuint ids[2];
+		glGenQueries(2, ids);
+		f.queries.push_back({0, no_variant, ids[0], ids[1]});
+	}
+	auto &q{f.queries[f.used]};
+	q.pass = get_pass(name);
+	q.variant = variant;
+	glQueryCounter(q.begin, GL_TIMESTAMP);
+	open.push_back(f.used++);
+}
+
+void GpuProfiler::end_pass() {
+	if (!in_frame)
+		return;
+	glQueryCounter(frames[current].queries[open.back()].end, GL_TIMESTAMP);
+	open.pop_back();
+}
+
+void GpuProfiler::gl_finit() {
+	for (auto &f: frames) {
+		for (auto const &q: f.queries) {
+			glDeleteQueries(1, &q.begin);
+			glDeleteQueries(1, &q.end);
+		}
+		f.queries.clear();
+		f.used = 0;
+		f.pending = false;
+	}
+	open.clear();
+	in_frame = false;
+	gl_calibrated = false;
+}
+
+void GpuProfiler::begin_frame() {
+	if (!gl_calibrated) {
+		GLint64 timestamp;
+		glGetInteger64v(GL_TIMESTAMP, &timestamp);
+		gl_offset = static_cast<int64_t>(now()) - timestamp;
+		gl_calibrated = true;
+	}
+	current = (current + 1) % frames_in_flight;
+	auto &f{frames[current]};
+	collect(f, false);
+	f.used = 0;
+	/* passes left open by a frame that bailed out early */
+	open.clear();
+	in_frame = true;
+}
+
+void GpuProfiler::end_frame() {
+	frames[current].pending = frames[current].used != 0;
+	open.clear();
+	in_frame = false;
+}
+
+void GpuProfiler::finish() {
+	/* oldest first, so that the trace stays ordered */
+	for (size_t i{1}; i <= frames_in_flight; ++i)
+		collect(frames[(current + i) % frames_in_flight], true);
+}
+
+void GpuProfiler::add_sample(string const &track, string const &name, uint64_t start, uint64_t end) {
+	record(get_track(track), get_pass(name), no_variant, start, end);
+}
+
+void GpuProfiler::add_counter(string const &name, double value) {
+	auto &samples{counters[get_samples(counters, name)].durations};
+	samples.push_back(value);
+	if (samples.size() > window)
+		samples.pop_front();
+}
+
+vector<GpuProfiler::stats> GpuProfiler::get_stats(vector<pass_samples> const &list) {
+	vector<stats> result;
+	for (auto const &p: list) {
+		if (p.durations.empty())
+			continue;
+		vector<double> sorted(p.durations.begin(), p.durations.end());
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile{[&sorted](double q) {
+			return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+		}};
+		double sum{0};
+		for (double d: sorted)
+			sum += d;
+		result.push_back({
+			p.name, sorted.size(),
+			sum / sorted.size(), percentile(.5), percentile(.95), percentile(.99), sorted.back()
+		});
+	}
+	return result;
+}
+
+vector<std::pair<uint64_t, double>> GpuProfiler::get_variants(string const &pass) const {
+	vector<std::pair<uint64_t, double>> result;
+	for (auto const &p: passes) {
+		if (p.name != pass)
+			continue;
+		for (auto const &v: p.variants) {
+			double sum{0};
+			for (double d: v.durations)
+				sum += d;
+			result.emplace_back(v.variant, sum / v.durations.size());
+		}
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+vector<GpuProfiler::stats> GpuProfiler::get_stats() const {
+	return get_stats(passes);
+}
+
+vector<GpuProfiler::stats> GpuProfiler::get_counter_stats() const {
+	return get_stats(counters);
+}
+
+string GpuProfiler::format_stats() const {
+	std::ostringstream out;
+	char line[128];
+	std::snprintf(line, sizeof(line), "%-16s %8s %8s %8s %8s\n", "pass, ms", "avg", "p50", "p95", "p99");
+	out << line;
+	for (auto const &s: get_stats()) {
+		std::snprintf(line, sizeof(line), "%-16.16s %8.3f %8.3f %8.3f %8.3f\n", s.name.c_str(), s.average, s.p50, s.p95, s.p99);
+		out << line;
+	}
+	if (dropped != 0)
+		out << dropped << " frames dropped\n";
+	auto const counter_stats{get_counter_stats()};
+	if (!counter_stats.empty()) {
+		std::snprintf(line, sizeof(line), "%-16s %8s %8s %8s %8s\n", "counter", "avg", "p50", "p95", "p99");
+		out << line;
+	}
+	for (auto const &s: counter_stats) {
+		std::snprintf(line, sizeof(line), "%-16.16s %8.1f %8.0f %8.0f %8.0f\n", s.name.c_str(), s.average, s.p50, s.p95, s.p99);
+		out << line;
+	}
+	return out.str();
+}
+
+void GpuProfiler::write_csv(std::ostream &out) const {
+	out << "pass,count,average_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	for (auto const &s: get_stats())
+		out << s.name << "," << s.count << "," << s.average << "," << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.max << "\n";
+}
+
+void GpuProfiler::write_trace(std::ostream &out) const {
+	out << "{\"traceEvents\":[\n";
+	bool first{true};
+	for (size_t i{0}; i != tracks.size(); ++i) {
+		out << (first ? "" : ",\n")
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+			<< ",\"args\":{\"name\":\"" << tracks[i] << "\"}}";
+		first = false;
+	}
+	char number[64];
+	for (auto const &e: trace) {
+		out << (first ? "" : ",\n") << "{\"name\":\"" << passes[e.pass].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.track;
+		/* microseconds */
+		std::snprintf(number, sizeof(number), "%.3f", e.start / 1e3);
+		out << ",\"ts\":" << number;
+		std::snprintf(number, sizeof(number), "%.3f", e.duration / 1e3);
+		out << ",\"dur\":" << number << "}";
+		first = false;
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool GpuProfiler::export_files(string const &prefix, string &error) const {
+	/* csv */ {
+		std::ofstream file(prefix + ".csv");
+		write_csv(file);
+		if (!file) {
+			error = "Cannot write " + prefix + ".csv";
+			return false;
+		}
+	}
+	/* trace */ {
+		std::ofstream file(prefix + ".json");
+		write_trace(file);
+		if (!file) {
+			error = "Cannot write " + prefix + ".json";
+			return false;
+		}
+	}
+	return true;
+}
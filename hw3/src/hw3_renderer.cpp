@@ -0,0 +1,649 @@
+#include "hw3_renderer.hpp"
+
+#include <epoxy/gl.h>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <giomm/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using Gio::Resource;
+
+/* Names of the uniforms, hashed at compile time */
+namespace uniforms {
+	static constexpr Program::name
+		light_world{"light_world"},
+		light_color{"light_color"},
+		light_power{"light_power"},
+		light_radius{"light_radius"},
+		id{"id"},
+		albedo{"albedo"},
+		normal{"normal"},
+		depth{"depth"},
+		albedo_texture{"albedo_texture"},
+		normal_texture{"normal_texture"},
+		depth_texture{"depth_texture"},
+		lights{"lights"},
+		tiles{"tiles"},
+		tile_lights{"tile_lights"},
+		tile_size{"tile_size"},
+		tiles_columns{"tiles_columns"},
+		gbuffer_compact{"gbuffer_compact"};
+}
+
+Hw3Renderer::Hw3Renderer(unsigned seed):
+	random(seed)
+{
+}
+
+void Hw3Renderer::set_lights_count(size_t count) {
+	size_t old_size{gl.lights.size()};
+	gl.lights.resize(count);
+	for (size_t i{old_size}; i < count; ++i) {
+		std::uniform_real_distribution<double> dist;
+		double const r{.20};
+		gl.lights[i].color = glm::vec3(dist(random), dist(random), dist(random)) / 2.0f + .5f;
+		gl.lights[i].power = dist(random) * .02;
+		gl.lights[i].speed = (dist(random) * 4 + 8) * M_PI / 5;
+		gl.lights[i].radius = r;
+	}
+}
+
+bool Hw3Renderer::gl_init(std::string &error) {
+	auto load_resource{[](std::string const &path) -> std::tuple<char const *, size_t> {
+		auto resource_bytes{Resource::lookup_data_global(path)};
+		gsize resource_size;
+		auto resource{static_cast<const char*>(resource_bytes->get_data(resource_size))};
+		return {resource, resource_size};
+	}};
+
+	auto load_mesh{[&load_resource](std::string const &path) -> ::Object::binary_view {
+		char const *data;
+		size_t size;
+		std::tie(data, size) = load_resource(path);
+		return ::Object::view_binary(data, size);
+	}};
+
+	/* shaders */ {
+		std::string error_string;
+		std::string const gbuffer_library(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/gbuffer.glsl")));
+		auto create_program{
+			[&error_string, &load_resource, &gbuffer_library](std::string const &vertex_name, std::string const &fragment_name, bool uses_gbuffer) -> std::unique_ptr<Program> {
+				std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/" + vertex_name + "_vertex.glsl")));
+				std::string fragment(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/" + fragment_name + "_fragment.glsl")));
+				if (!uses_gbuffer)
+					return Program::build_program(
+						{{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}},
+						error_string
+					);
+				/* the encoding of the normals, see GBuffer */
+				return Program::build_program(
+					{{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}, {GL_FRAGMENT_SHADER, gbuffer_library}},
+					error_string
+				);
+			}
+		};
+
+		if ((gl.scene_program = create_program("scene", "scene", false)) == nullptr) {
+			error = "Program Scene: " + error_string;
+			return false;
+		}
+		if ((gl.light_program = create_program("light", "light", false)) == nullptr) {
+			error = "Program Light Spheres: " + error_string;
+			return false;
+		}
+		if ((gl.buffer_program = create_program("buffer", "buffer", true)) == nullptr) {
+			error = "Program Buffer: " + error_string;
+			return false;
+		}
+		if ((gl.texture_program = create_program("texture", "texture", true)) == nullptr) {
+			error = "Program Texture: " + error_string;
+			return false;
+		}
+		if ((gl.deferred_program = create_program("deferred", "deferred", true)) == nullptr) {
+			error = "Program Deferred: " + error_string;
+			return false;
+		}
+		/* the full screen rect of texture_program, lit by the lights of its tiles */
+		if ((gl.tiled_program = create_program("texture", "tiled", true)) == nullptr) {
+			error = "Program Tiled: " + error_string;
+			return false;
+		}
+		/* only the depth and stencil tests, no fragment shader */
+		if ((gl.stencil_program = Program::build_program(
+				{{GL_VERTEX_SHADER, std::get<0>(load_resource("/net/ldvsoft/spbau/gl/stencil_vertex.glsl"))}},
+				error_string
+			)) == nullptr) {
+			error = "Program Stencil: " + error_string;
+			return false;
+		}
+	}
+
+	gl.blocks.gl_init();
+	gl.gbuffer.gl_init();
+
+	/* tiled lighting */ {
+		auto create{[](_gl::texture_buffer &b, GLenum format) {
+			glGenBuffers(1, &b.buffer);
+			/* the name becomes a buffer on its first binding, glTexBuffer needs one */
+			glBindBuffer(GL_TEXTURE_BUFFER, b.buffer);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			glGenTextures(1, &b.texture);
+			glBindTexture(GL_TEXTURE_BUFFER, b.texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, format, b.buffer);
+		}};
+		create(gl.tiled_lights, GL_RGBA32F);
+		create(gl.tiled_ranges, GL_RG32UI);
+		create(gl.tiled_indices, GL_R32UI);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &gl.max_texture_buffer_size);
+	}
+
+	/* scene */ {
+		auto const format{packed_verticies ? SceneObject::PACKED_VERTICIES : SceneObject::FLOAT_VERTICIES};
+		/* rabbit */ {
+			/* halving the faces down to a few hundred */
+			auto const lods{[this](::Object::binary_view const &mesh) {
+				return ::Object::build_lods(mesh, lod_error > 0 ? 6 : 1, 512);
+			}};
+			auto const acolyte{load_mesh("/net/ldvsoft/spbau/gl/stanford_bunny.mesh")};
+			auto const acolyte_lods{lods(acolyte)};
+			for (int i{0}; i != gl.acolytes_count; ++i) {
+				auto a{static_cast<float>(2 * M_PI / gl.acolytes_count * i)};
+				gl.acolytes[i] = std::make_unique<SceneObject>(acolyte, format, acolyte_lods);
+				gl.acolytes[i]->position = glm::rotate(a, glm::vec3(0, 1, 0))
+					* glm::translate(glm::vec3(.18, 0, 0))
+					* glm::scale(glm::vec3(.3, .3, .3))
+					* glm::translate(glm::vec3(0, -.03, 0));
+			}
+
+			/* the Makefile makes the statue out of the same model with other colors, so the levels of the acolytes fit it */
+			auto const statue{load_mesh("/net/ldvsoft/spbau/gl/stanford_bunny_statue.mesh")};
+			bool const same_faces{
+				statue.verticies_count == acolyte.verticies_count
+				&& statue.faces_count == acolyte.faces_count
+				&& std::equal(statue.faces, statue.faces + statue.faces_count, acolyte.faces)
+			};
+			gl.statue = std::make_unique<SceneObject>(statue, format, same_faces ? acolyte_lods : lods(statue));
+			gl.statue->position = glm::translate(glm::vec3(0, -.03, 0));
+		}
+
+		/* base plane */ {
+			gl.base_plane = std::make_unique<SceneObject>(load_mesh("/net/ldvsoft/spbau/gl/plane.mesh"), format);
+		}
+
+		gl.objects.assign({gl.statue.get(), gl.base_plane.get()});
+		for (auto const &acolyte: gl.acolytes)
+			gl.objects.push_back(acolyte.get());
+
+		/* light sphere */ {
+			gl.light_sphere = std::make_unique<SceneObject>(load_mesh("/net/ldvsoft/spbau/gl/light_sphere.mesh"), format);
+		}
+		/* texture rect, its positions are in clip space already and pass no model matrix */ {
+			gl.texture_rect = std::make_unique<SceneObject>(load_mesh("/net/ldvsoft/spbau/gl/texture_rect.mesh"));
+		}
+	}
+
+	size_t vertex_bytes{gl.light_sphere->get_vertex_bytes() + gl.texture_rect->get_vertex_bytes()};
+	for (auto const *object: gl.objects)
+		vertex_bytes += object->get_vertex_bytes();
+	std::cout << "Rendering on " << glGetString(GL_RENDERER) << ", " << vertex_bytes / 1024 << " KiB of verticies" << std::endl;
+	return true;
+}
+
+void Hw3Renderer::gl_finit() {
+	profiler.gl_finit();
+	fragments.gl_finit();
+	for (auto const *b: {&gl.tiled_lights, &gl.tiled_ranges, &gl.tiled_indices}) {
+		glDeleteTextures(1, &b->texture);
+		glDeleteBuffers(1, &b->buffer);
+	}
+	gl.gbuffer.gl_finit();
+	gl.texture_rect = nullptr;
+	gl.light_sphere = nullptr;
+	gl.objects.clear();
+	gl.visible_objects.clear();
+	gl.visible_lods.clear();
+	gl.statue = nullptr;
+	gl.texture_program = nullptr;
+	gl.tiled_program = nullptr;
+	gl.stencil_program = nullptr;
+	gl.buffer_program = nullptr;
+	gl.scene_program = nullptr;
+	gl.blocks.gl_finit();
+}
+
+bool Hw3Renderer::gl_render(int width, int height, std::string &error) {
+	uint64_t const start{GpuProfiler::now()};
+	profiler.begin_frame();
+	fragments.begin_frame();
+	gl.blocks.begin_frame();
+	/* whatever drew in between may have changed it */
+	gl.state.invalidate();
+	gl.state.set_caching(render_queue);
+	gl.draws = 0;
+	set_queue_passes();
+	GLint old_buffer, old_vp[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
+	glGetIntegerv(GL_VIEWPORT, old_vp);
+
+	/* animate */ {
+		for (auto &light: gl.lights) {
+			double angle(fmod(progress * light.speed, 2 * M_PI));
+			double a{cos(angle) * M_PI / 6};
+			double b{angle * 3 * light.speed};
+			light.position = glm::vec3(
+				light.radius * cos(a) * sin(b),
+				light.radius * sin(a) + .15,
+				light.radius * cos(a) * cos(b)
+			);
+		}
+
+		gl.statue->animation_position = glm::translate(glm::vec3(
+			0,
+			std::max<float>(0, sin(progress * 4 * M_PI)) * .01,
+			0
+		));
+
+	}
+
+	glm::mat4 cam_proj{glm::perspective(
+		/* vertical fov = */ glm::radians(gl.fov),
+		/* ratio        = */ static_cast<float>(width) / height,
+		/* planes       : */ .005f, 100.0f
+	)};
+	gl.blocks.set_camera(camera_view, cam_proj);
+	cull(Frustum(cam_proj * camera_view));
+	select_lods(cam_proj, height);
+	gl.light_sphere->set_instances(gl.light_instances);
+
+	glClearColor(0, 0, 0, 1);
+
+	/* buffer */ {
+		gl.gbuffer.set_compact(compact_gbuffer);
+		if (!gl.gbuffer.resize(width, height, error))
+			return false;
+		gl.gbuffer.bind();
+
+		/* pass */ {
+			GpuProfiler::pass pass(profiler, "gbuffer");
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			queue_objects(GBUFFER_PASS, *gl.buffer_program);
+			gl_flush();
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+		glViewport(old_vp[0], old_vp[1], old_vp[2], old_vp[3]);
+	}
+
+	static constexpr bool useDebug{false};
+	GLuint tmp, out;
+	if (useDebug) {
+		glGenTextures(1, &out);
+		glBindTexture(GL_TEXTURE_2D, out);
+		glTexImage2D(
+			GL_TEXTURE_2D, 0,
+			GL_RGB16F, width, height,
+			0, GL_RGB, GL_FLOAT, nullptr
+		);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &tmp);
+		glBindFramebuffer(GL_FRAMEBUFFER, tmp);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, out, 0);
+		{
+			constexpr size_t cnt{1};
+			constexpr GLenum buffers[cnt]{GL_COLOR_ATTACHMENT0};
+			glDrawBuffers(cnt, buffers);
+		}
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			error = "TMP";
+			return false;
+		}
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	size_t const lights_count{gl.lights.size()};
+	switch (display_mode) {
+	case DEFERRED:
+	case DEFERRED_LIGHTS:
+	case DEFERRED_LIGHTS_CULLED:
+		/* deferred */ {
+			GpuProfiler::pass pass(profiler, "volumes", lights_count);
+			/* ambient, which also puts the depth of the G-buffer into the depth buffer */
+			queue_texture(3);
+			gl_flush();
+			FragmentCounter::count count(fragments, "volumes", lights_count);
+			queue_lights(VOLUMES_PASS, *gl.deferred_program);
+			gl_flush();
+		}
+		if (display_mode == DEFERRED)
+			break;
+		/* lights */ {
+			GpuProfiler::pass pass(profiler, "lights");
+			queue_lights(display_mode == DEFERRED_LIGHTS_CULLED ? SPHERES_CULLED_PASS : SPHERES_PASS, *gl.light_program);
+			gl_flush();
+		}
+		break;
+	case BUFFER_ALBEDO:
+	case BUFFER_NORMAL:
+	case BUFFER_DEPTH: {
+		GpuProfiler::pass pass(profiler, "texture");
+		queue_texture(display_mode - BUFFER_ALBEDO);
+		gl_flush();
+		break;
+	}
+	case SCENE_SINGLE_LIGHT: {
+		GpuProfiler::pass pass(profiler, "scene");
+		queue_objects(SCENE_PASS, *gl.scene_program);
+		gl_flush();
+		break;
+	}
+	case DEFERRED_TILED: {
+		/* binning */ {
+			uint64_t const start{GpuProfiler::now()};
+			light_tiles.bin(gl.light_instances, camera_view, cam_proj, width, height);
+			profiler.add_sample("CPU", "binning", start, GpuProfiler::now());
+		}
+		GpuProfiler::pass pass(profiler, "tiles", lights_count);
+		FragmentCounter::count count(fragments, "tiles", lights_count);
+		if (!gl_render_tiled(error))
+			return false;
+		break;
+	}
+	case DEFERRED_STENCIL: {
+		GpuProfiler::pass pass(profiler, "stencil", lights_count);
+		gl_render_stencil();
+		break;
+	}
+	}
+
+	if (useDebug) {
+		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+		glDeleteTextures(1, &out);
+		glDeleteFramebuffers(1, &tmp);
+	}
+
+	gl.state.reset();
+	profiler.add_counter("state calls", gl.state.take_calls());
+	profiler.add_counter("draw calls", gl.draws);
+	/* the time to record and issue the frame, the driver may draw it later */
+	profiler.add_sample("CPU", "submit", start, GpuProfiler::now());
+
+	profiler.end_frame();
+	glFlush();
+
+	return true;
+}
+
+void Hw3Renderer::set_queue_passes() {
+	GlState::raster const full_screen{true, GL_ALWAYS};
+	GlState::raster lights{full_screen};
+	lights.depth_mask = false;
+	lights.blend = true;
+	/* the back faces cover the volume even with the camera inside it */
+	lights.cull = true;
+	lights.cull_face = GL_FRONT;
+	GlState::raster spheres_culled;
+	spheres_culled.cull = true;
+	spheres_culled.cull_face = GL_FRONT;
+	GlState::raster gbuffer;
+	/* the compact albedo is sRGB, so that 8 bits keep the dark colors */
+	gbuffer.srgb = compact_gbuffer;
+
+	auto const light_uniforms{[this](Program const &program) {
+		set_light_uniforms(program);
+	}};
+	gl.queue.set_pass(GBUFFER_PASS, {gbuffer, light_uniforms});
+	gl.queue.set_pass(SCENE_PASS, {GlState::raster{}, light_uniforms});
+	gl.queue.set_pass(TEXTURE_PASS, {full_screen, [this](Program const &program) {
+		glUniform1i(program.get_uniform(uniforms::id), gl.texture_view);
+		glUniform1i(program.get_uniform(uniforms::gbuffer_compact), gl.gbuffer.is_compact());
+		glUniform1i(program.get_uniform(uniforms::albedo), 0);
+		glUniform1i(program.get_uniform(uniforms::normal), 1);
+		glUniform1i(program.get_uniform(uniforms::depth), 2);
+	}});
+	gl.queue.set_pass(VOLUMES_PASS, {lights, [this](Program const &program) {
+		set_gbuffer_uniforms(program);
+	}});
+	gl.queue.set_pass(SPHERES_PASS, {GlState::raster{}, nullptr});
+	gl.queue.set_pass(SPHERES_CULLED_PASS, {spheres_culled, nullptr});
+}
+
+void Hw3Renderer::set_light_uniforms(Program const &program) const {
+	glUniform3fv(program.get_uniform(uniforms::light_world), 1, &gl.lights[0].position[0]);
+	glUniform3fv(program.get_uniform(uniforms::light_color), 1, &gl.lights[0].color[0]);
+	glUniform1f (program.get_uniform(uniforms::light_power), gl.lights[0].power);
+	glUniform1f (program.get_uniform(uniforms::light_radius), gl.lights[0].radius);
+	glUniform1i (program.get_uniform(uniforms::gbuffer_compact), gl.gbuffer.is_compact());
+}
+
+void Hw3Renderer::set_gbuffer_uniforms(Program const &program) const {
+	glUniform1i(program.get_uniform(uniforms::albedo_texture), 0);
+	glUniform1i(program.get_uniform(uniforms::normal_texture), 1);
+	glUniform1i(program.get_uniform(uniforms::depth_texture), 2);
+	glUniform1i(program.get_uniform(uniforms::gbuffer_compact), gl.gbuffer.is_compact());
+}
+
+void Hw3Renderer::queue_objects(queue_pass_t pass, Program const &program) {
+	for (size_t i{0}; i != gl.visible_objects.size(); ++i)
+		gl.queue.submit(pass, {&program, {}, gl.visible_objects[i], false, gl.visible_lods[i]});
+}
+
+void Hw3Renderer::queue_texture(int id) {
+	gl.texture_view = id;
+	gl.queue.submit(TEXTURE_PASS, {
+		gl.texture_program.get(),
+		{gl.gbuffer.get_texture(GBuffer::ALBEDO), gl.gbuffer.get_texture(GBuffer::NORMAL), gl.gbuffer.get_texture(GBuffer::DEPTH)},
+		gl.texture_rect.get(), false
+	});
+}
+
+void Hw3Renderer::queue_lights(queue_pass_t pass, Program const &program) {
+	RenderQueue::draw d{&program, {}, gl.light_sphere.get(), true};
+	/* the volumes read the G-buffer */
+	if (pass == VOLUMES_PASS)
+		d.textures = {gl.gbuffer.get_texture(GBuffer::ALBEDO), gl.gbuffer.get_texture(GBuffer::NORMAL), gl.gbuffer.get_texture(GBuffer::DEPTH)};
+	gl.queue.submit(pass, d);
+}
+
+void Hw3Renderer::gl_flush() {
+	gl.draws += gl.queue.flush(gl.state, gl.blocks, render_queue);
+}
+
+bool Hw3Renderer::gl_render_tiled(std::string &error) {
+	auto const &ranges{light_tiles.get_ranges()};
+	auto const &indices{light_tiles.get_indices()};
+	if (indices.size() > static_cast<size_t>(gl.max_texture_buffer_size)) {
+		error = "Tile light lists do not fit a texture buffer: " + std::to_string(indices.size());
+		return false;
+	}
+
+	/* upload */ {
+		auto upload{[](_gl::texture_buffer const &b, void const *data, size_t size) {
+			glBindBuffer(GL_TEXTURE_BUFFER, b.buffer);
+			glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+		}};
+		upload(gl.tiled_lights, gl.light_instances.data(), sizeof(SceneObject::instance) * gl.light_instances.size());
+		upload(gl.tiled_ranges, ranges.data(), sizeof(GLuint) * ranges.size());
+		upload(gl.tiled_indices, indices.data(), sizeof(GLuint) * indices.size());
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	gl.state.set_raster({true, GL_ALWAYS});
+	gl.state.use_program(gl.tiled_program.get());
+
+	gl.state.bind_texture(0, GL_TEXTURE_2D, gl.gbuffer.get_texture(GBuffer::ALBEDO));
+	gl.state.bind_texture(1, GL_TEXTURE_2D, gl.gbuffer.get_texture(GBuffer::NORMAL));
+	gl.state.bind_texture(2, GL_TEXTURE_2D, gl.gbuffer.get_texture(GBuffer::DEPTH));
+	gl.state.bind_texture(3, GL_TEXTURE_BUFFER, gl.tiled_lights.texture);
+	gl.state.bind_texture(4, GL_TEXTURE_BUFFER, gl.tiled_ranges.texture);
+	gl.state.bind_texture(5, GL_TEXTURE_BUFFER, gl.tiled_indices.texture);
+
+	set_gbuffer_uniforms(*gl.tiled_program);
+	glUniform1i(gl.tiled_program->get_uniform(uniforms::lights), 3);
+	glUniform1i(gl.tiled_program->get_uniform(uniforms::tiles), 4);
+	glUniform1i(gl.tiled_program->get_uniform(uniforms::tile_lights), 5);
+	glUniform1i(gl.tiled_program->get_uniform(uniforms::tile_size), LightTiles::tile_size);
+	glUniform1i(gl.tiled_program->get_uniform(uniforms::tiles_columns), light_tiles.get_columns());
+
+	gl.texture_rect->draw(gl.blocks, *gl.tiled_program);
+	++gl.draws;
+	if (!render_queue)
+		gl.state.reset();
+	return true;
+}
+
+void Hw3Renderer::gl_render_stencil() {
+	/* ambient, which also puts the depth of the G-buffer into the depth buffer */
+	queue_texture(3);
+	gl_flush();
+
+	gl.state.use_program(gl.deferred_program.get());
+	gl.state.bind_texture(0, GL_TEXTURE_2D, gl.gbuffer.get_texture(GBuffer::ALBEDO));
+	gl.state.bind_texture(1, GL_TEXTURE_2D, gl.gbuffer.get_texture(GBuffer::NORMAL));
+	gl.state.bind_texture(2, GL_TEXTURE_2D, gl.gbuffer.get_texture(GBuffer::DEPTH));
+	set_gbuffer_uniforms(*gl.deferred_program);
+	gl_draw_lights_stencil();
+	if (!render_queue)
+		gl.state.reset();
+}
+
+void Hw3Renderer::cull(Frustum const &frustum) {
+	/* objects: spheres first, all at once, then the boxes of those left */ {
+		gl.spheres.clear();
+		for (auto const *object: gl.objects) {
+			auto const bounds{object->get_bounds()};
+			gl.spheres.emplace_back(bounds.center, bounds.radius);
+		}
+		frustum.test_spheres(gl.spheres.data(), gl.spheres.size(), gl.visible);
+		gl.visible_objects.clear();
+		for (size_t i: gl.visible) {
+			auto const bounds{gl.objects[i]->get_bounds()};
+			if (frustum.test_box(bounds.min, bounds.max))
+				gl.visible_objects.push_back(gl.objects[i]);
+		}
+		profiler.add_counter("objects drawn", gl.visible_objects.size());
+		profiler.add_counter("objects culled", gl.objects.size() - gl.visible_objects.size());
+	}
+	/* lights: the volumes are instances of light_sphere, a light out of view lights nothing in view */ {
+		auto const bounds{gl.light_sphere->get_bounds()};
+		gl.spheres.clear();
+		for (auto const &light: gl.lights)
+			gl.spheres.emplace_back(light.position + light.radius * bounds.center, light.radius * bounds.radius);
+		frustum.test_spheres(gl.spheres.data(), gl.spheres.size(), gl.visible);
+		gl.light_instances.clear();
+		for (size_t i: gl.visible) {
+			auto const &light{gl.lights[i]};
+			gl.light_instances.push_back({glm::vec4(light.position, light.radius), glm::vec4(light.color, light.power)});
+		}
+		profiler.add_counter("lights drawn", gl.light_instances.size());
+		profiler.add_counter("lights culled", gl.lights.size() - gl.light_instances.size());
+	}
+}
+
+void Hw3Renderer::select_lods(glm::mat4 const &proj, int height) {
+	gl.visible_lods.clear();
+	size_t faces{0};
+	for (auto const *object: gl.visible_objects) {
+		size_t const lod{object->select_lod(camera_view, proj, height, lod_error)};
+		gl.visible_lods.push_back(lod);
+		faces += object->get_faces_count(lod);
+	}
+	profiler.add_counter("object faces", faces);
+}
+
+/* Two draws of every light, with the G-buffer bound for the deferred program.
+ * The first one marks the pixels the volume holds: a surface in it is behind the front faces and in front of the back ones,
+ * so the back faces failing the depth test and the front ones passing it leave a non-zero stencil there.
+ * It has no fragment shader, only the depth and stencil tests run. The second one shades the marked pixels, clearing the marks.
+ * Only the second ones are counted in fragments, as the light volumes of the other modes are: the samples passing their stencil test.
+ */
+void Hw3Renderer::gl_draw_lights_stencil() {
+	GlState::raster mark;
+	mark.depth_mask = false;
+	mark.color_mask = false;
+	mark.stencil = true;
+	GlState::raster shade{mark};
+	shade.depth_func = GL_ALWAYS;
+	shade.color_mask = true;
+	shade.blend = true;
+	/* the back faces cover the volume even with the camera inside it */
+	shade.cull = true;
+	shade.cull_face = GL_FRONT;
+
+	glClear(GL_STENCIL_BUFFER_BIT);
+	for (size_t i{0}; i != gl.light_instances.size(); ++i) {
+		/* mark */ {
+			gl.state.set_raster(mark);
+			gl.state.use_program(gl.stencil_program.get());
+			gl.state.set_stencil_func(GL_ALWAYS, 0, 0);
+			gl.state.set_stencil_op(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+			gl.state.set_stencil_op(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+			gl.light_sphere->draw_instance(gl.blocks, *gl.stencil_program, i);
+		}
+		/* shade */ {
+			gl.state.set_raster(shade);
+			gl.state.use_program(gl.deferred_program.get());
+			gl.state.set_stencil_func(GL_NOTEQUAL, 0, 0xff);
+			gl.state.set_stencil_op(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_ZERO);
+			FragmentCounter::count count(fragments, "stencil", gl.lights.size());
+			gl.light_sphere->draw_instance(gl.blocks, *gl.deferred_program, i);
+		}
+	}
+	gl.draws += 2 * gl.light_instances.size();
+}
+
+std::string Hw3Renderer::format_lighting() const {
+	static char const *const methods[]{"volumes", "stencil", "tiles"};
+	static size_t constexpr methods_count{sizeof(methods) / sizeof(*methods)};
+	/* light count -> a value of every method, NAN where the method has not run with that count */
+	using table = std::map<size_t, std::array<double, methods_count>>;
+	auto add{[](table &t, size_t method, uint64_t lights, double value) {
+		std::array<double, methods_count> none;
+		none.fill(NAN);
+		t.emplace(lights, none).first->second[method] = value;
+	}};
+	table times, counts;
+	for (size_t m{0}; m != methods_count; ++m) {
+		for (auto const &v: profiler.get_variants(methods[m]))
+			add(times, m, v.first, v.second);
+		for (auto const &c: fragments.get_counts(methods[m]))
+			add(counts, m, c.first, c.second);
+	}
+
+	std::ostringstream out;
+	auto print{[&out](table const &t, std::string const &title, char const *format) {
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-16s", title.c_str());
+		out << line;
+		for (auto const *m: methods) {
+			std::snprintf(line, sizeof(line), " %12s", m);
+			out << line;
+		}
+		out << '\n';
+		for (auto const &r: t) {
+			std::snprintf(line, sizeof(line), "%-16zu", r.first);
+			out << line;
+			for (double v: r.second) {
+				if (std::isnan(v))
+					std::snprintf(line, sizeof(line), " %12s", "-");
+				else
+					std::snprintf(line, sizeof(line), format, v);
+				out << line;
+			}
+			out << '\n';
+		}
+	}};
+	print(times, "lights, ms", " %12.3f");
+	print(counts, "lights, samples", " %12.0f");
+	return out.str();
+}
@@ -49,14 +49,19 @@ Hw3Window::Hw3Window(
 	RefPtr<Builder> const &builder
 ):
 	Window(type),
-	builder(builder)
+	builder(builder),
+	renderer(std::random_device{}())
 {
 	builder->get_widget("draw_area", area);
 	builder->get_widget("draw_area_eventbox", area_eventbox);
 	builder->get_widget("animate_toggle", animate);
 	builder->get_widget("display_mode_combobox", display_mode_combobox);
+	builder->get_widget("compact_gbuffer_check", compact_gbuffer);
 	builder->get_widget("reset_position_button", reset_position);
 	builder->get_widget("reset_animation_button", reset_animation);
+	builder->get_widget("profile_export_button", profile_export);
+	builder->get_widget("profile_stats_label", profile_stats);
+	builder->get_widget("lighting_stats_label", lighting_stats);
 
 	ticker_id = gtk_widget_add_tick_callback(GTK_WIDGET(area->gobj()), tick_wrapper, this, nullptr);
 
@@ -64,44 +69,56 @@ Hw3Window::Hw3Window(
 	lights_adjustment = RefPtr<Gtk::Adjustment>::cast_dynamic(builder->get_object("lights_adjustment"));
 
 	area->set_has_depth_buffer();
+	/* for the light volumes of Hw3Renderer::DEFERRED_STENCIL */
+	area->set_has_stencil_buffer();
 	/* options */ {
 		/* deferred */ {
-			static_assert(DEFERRED == 0);
+			static_assert(Hw3Renderer::DEFERRED == 0);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Deferred");
 		}
 		/* scene: lights */ {
-			static_assert(DEFERRED_LIGHTS == 1);
+			static_assert(Hw3Renderer::DEFERRED_LIGHTS == 1);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Deferred + light shperes");
 		}
 		/* scene: lights (culled) */ {
-			static_assert(DEFERRED_LIGHTS_CULLED == 2);
+			static_assert(Hw3Renderer::DEFERRED_LIGHTS_CULLED == 2);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Deferred + light shperes (culled)");
 		}
 		/* buffer: albedo */ {
-			static_assert(BUFFER_ALBEDO == 3);
+			static_assert(Hw3Renderer::BUFFER_ALBEDO == 3);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Buffer: albedo");
 		}
 		/* buffer: normal */ {
-			static_assert(BUFFER_NORMAL == 4);
+			static_assert(Hw3Renderer::BUFFER_NORMAL == 4);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Buffer: normal");
 		}
 		/* buffer: depth */ {
-			static_assert(BUFFER_DEPTH == 5);
+			static_assert(Hw3Renderer::BUFFER_DEPTH == 5);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Buffer: depth");
 		}
 		/* scene */ {
-			static_assert(SCENE_SINGLE_LIGHT == 6);
+			static_assert(Hw3Renderer::SCENE_SINGLE_LIGHT == 6);
 			auto &row{*display_mode_list_store->append()};
 			row.set_value<Glib::ustring>(0, "Scene (single light)");
 		}
+		/* deferred: tiles */ {
+			static_assert(Hw3Renderer::DEFERRED_TILED == 7);
+			auto &row{*display_mode_list_store->append()};
+			row.set_value<Glib::ustring>(0, "Deferred (tiled)");
+		}
+		/* deferred: stencil */ {
+			static_assert(Hw3Renderer::DEFERRED_STENCIL == 8);
+			auto &row{*display_mode_list_store->append()};
+			row.set_value<Glib::ustring>(0, "Deferred (stencil)");
+		}
 
-		display_mode_combobox->set_active(DEFERRED);
+		display_mode_combobox->set_active(Hw3Renderer::DEFERRED);
 	}
 
 	lights_adjustment->set_value(1);
@@ -120,16 +137,10 @@ Hw3Window::Hw3Window(
 	animate->signal_toggled().connect(sigc::mem_fun(*this, &Hw3Window::animate_toggled));
 	reset_position->signal_clicked ().connect(sigc::mem_fun(*this, &Hw3Window::reset_position_clicked));
 	reset_animation->signal_clicked().connect(sigc::mem_fun(*this, &Hw3Window::reset_animation_clicked));
+	profile_export->signal_clicked ().connect(sigc::mem_fun(*this, &Hw3Window::profile_export_clicked));
 	lights_adjustment->signal_value_changed().connect(sigc::mem_fun(*this, &Hw3Window::lights_changed));
 	display_mode_combobox->signal_changed().connect(sigc::mem_fun(*this, &Hw3Window::display_mode_changed));
-
-/*	gl.lights.resize(1);
-	gl.lights[0].position = glm::vec3(0, .1, .5);
-	gl.lights[0].color = glm::vec3(1, 1, 1);
-	gl.lights[0].power = .01;
-	gl.lights[0].radius = .1;*/
-
-	view_range = .2;
+	compact_gbuffer->signal_toggled().connect(sigc::mem_fun(*this, &Hw3Window::display_mode_changed));
 
 	lights_changed();
 	reset_position_clicked();
@@ -145,110 +156,18 @@ void Hw3Window::gl_init() {
 	if (area->has_error())
 		return;
 
-	auto load_resource{[this](std::string const &path) -> std::tuple<char const *, size_t> {
-		auto resource_bytes{Resource::lookup_data_global(path)};
-		gsize resource_size;
-		auto resource{static_cast<const char*>(resource_bytes->get_data(resource_size))};
-		return {resource, resource_size};
-	}};
-
-	auto report_error{[this](std::string const &msg) -> void {
-		Error error(hw3_error_quark, 0, msg);
-		area->set_error(error);
-		std::cout << "ERROR: " << msg << std::endl;
-	}};
-
-	/* shaders */ {
-		std::string error_string;
-		auto create_program{
-			[this, &error_string, &load_resource](std::string const &name) -> std::unique_ptr<Program> {
-				std::string vertex(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/" + name + "_vertex.glsl")));
-				std::string fragment(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/" + name + "_fragment.glsl")));
-				return Program::build_program(
-					{{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}},
-					error_string
-				);
-			}
-		};
-
-		if ((gl.scene_program = create_program("scene")) == nullptr) {
-			report_error("Program Scene: " + error_string);
-			return;
-		}
-		if ((gl.light_program = create_program("light")) == nullptr) {
-			report_error("Program Light Spheres: " + error_string);
-			return;
-		}
-		if ((gl.buffer_program = create_program("buffer")) == nullptr) {
-			report_error("Program Buffer: " + error_string);
-			return;
-		}
-		if ((gl.texture_program = create_program("texture")) == nullptr) {
-			report_error("Program Texture: " + error_string);
-			return;
-		}
-		if ((gl.deferred_program = create_program("deferred")) == nullptr) {
-			report_error("Program Deferred: " + error_string);
-			return;
-		}
-	}
-
-	/* framebuffer */ {
-		glGenFramebuffers(1, &gl.framebuffer);
-		glGenTextures(1, &gl.albedo_texture);
-		glGenTextures(1, &gl.normal_texture);
-		glGenTextures(1, &gl.depth_texture);
+	std::string error;
+	if (!renderer.gl_init(error)) {
+		area->set_error(Error(hw3_error_quark, 0, error));
+		std::cout << "ERROR: " << error << std::endl;
 	}
-
-	/* scene */ {
-		/* rabbit */ {
-			::Object obj{::Object::load(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/stanford_bunny.obj")))};
-			obj.recalculate_normals();
-			for (int i{0}; i != gl.acolytes_count; ++i) {
-				auto a{static_cast<float>(2 * M_PI / gl.acolytes_count * i)};
-				gl.acolytes[i] = std::make_unique<SceneObject>(obj);
-				gl.acolytes[i]->position = glm::rotate(a, glm::vec3(0, 1, 0))
-					* glm::translate(glm::vec3(.18, 0, 0))
-					* glm::scale(glm::vec3(.3, .3, .3))
-					* glm::translate(glm::vec3(0, -.03, 0));
-			}
-			obj.normals_as_colors();
-			gl.statue = std::make_unique<SceneObject>(obj);
-			gl.statue->position = glm::translate(glm::vec3(0, -.03, 0));
-		}
-
-		/* base plane */ {
-			::Object obj{::Object::load(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/plane.obj")))};
-			gl.base_plane = std::make_unique<SceneObject>(obj);
-		}
-
-		/* light sphere */ {
-			::Object obj{::Object::load(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/light_sphere.obj")))};
-			gl.light_sphere = std::make_unique<SceneObject>(obj);
-		}
-		/* texture rect */ {
-			::Object obj{::Object::load(std::get<0>(load_resource("/net/ldvsoft/spbau/gl/texture_rect.obj")))};
-			gl.texture_rect = std::make_unique<SceneObject>(obj);
-		}
-	}
-
-	std::cout << "Rendering on " << glGetString(GL_RENDERER) << std::endl;
 }
 
 void Hw3Window::gl_finit() {
 	area->make_current();
 	if (area->has_error())
 		return;
-	glDeleteTextures(1, &gl.depth_texture);
-	glDeleteTextures(1, &gl.normal_texture);
-	glDeleteTextures(1, &gl.albedo_texture);
-	glDeleteFramebuffers(1, &gl.framebuffer);
-	gl.texture_rect = nullptr;
-	gl.light_sphere = nullptr;
-	gl.statue = nullptr;
-	gl.texture_program = nullptr;
-	gl.buffer_program = nullptr;
-	gl.scene_program = nullptr;
+	renderer.gl_finit();
 }
 
 bool Hw3Window::gl_render(RefPtr<GLContext> const &context) {
@@ -257,318 +176,17 @@ bool Hw3Window::gl_render(RefPtr<GLContext> const &context) {
 	if (area->has_error())
 		return false;
 
-	GLsizei height{area->get_height()}, width{area->get_width()};
-	GLint old_buffer, old_vp[4];
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
-	glGetIntegerv(GL_VIEWPORT, old_vp);
-
-	/* animate */ {
-		for (auto &light: gl.lights) {
-			double angle(fmod(animation.progress * light.speed, 2 * M_PI));
-			double a{cos(angle) * M_PI / 6};
-			double b{angle * 3 * light.speed};
-			light.position = glm::vec3(
-				light.radius * cos(a) * sin(b),
-				light.radius * sin(a) + .15,
-				light.radius * cos(a) * cos(b)
-			);
-		}
-
-		gl.statue->animation_position = glm::translate(glm::vec3(
-			0,
-			std::max<float>(0, sin(animation.progress * 4 * M_PI)) * .01,
-			0
-		));
-	}
-
-	glm::mat4 cam_proj{glm::perspective(
-		/* vertical fov = */ glm::radians(gl.fov),
-		/* ratio        = */ static_cast<float>(area->get_width()) / area->get_height(),
-		/* planes       : */ .005f, 100.0f
-	)};
-
-	glClearColor(0, 0, 0, 1);
-
-	/* buffer */ {
-		/* albedo */ {
-			glBindTexture(GL_TEXTURE_2D, gl.albedo_texture);
-			glTexImage2D(
-				GL_TEXTURE_2D, /* mipmap_level = */ 0,
-				GL_RGB16F, width, height,
-				0, GL_RGB, GL_FLOAT, nullptr
-			);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		/* normal */ {
-			glBindTexture(GL_TEXTURE_2D, gl.normal_texture);
-			glTexImage2D(
-				GL_TEXTURE_2D, /* mipmap_level = */ 0,
-				GL_RGB16F, width, height,
-				0, GL_RGB, GL_FLOAT, nullptr
-			);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		/* depth */ {
-			glBindTexture(GL_TEXTURE_2D, gl.depth_texture);
-			glTexImage2D(
-				GL_TEXTURE_2D, /* mipmap_level = */ 0,
-				GL_DEPTH_COMPONENT16, width, height,
-				0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr
-			);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-
-		glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
-		glViewport(0, 0, width, height);
-
-		glFramebufferTexture(GL_FRAMEBUFFER,
-				GL_COLOR_ATTACHMENT0, gl.albedo_texture, /* mipmap_level = */ 0
-		);
-		glFramebufferTexture(GL_FRAMEBUFFER,
-				GL_COLOR_ATTACHMENT1, gl.normal_texture, /* mipmap_level = */ 0
-		);
-		glFramebufferTexture(GL_FRAMEBUFFER,
-				GL_DEPTH_ATTACHMENT, gl.depth_texture, /* mipmap_level = */ 0
-		);
-		/* buffers */ {
-			constexpr size_t cnt{2};
-			GLenum buffers[cnt]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-			glDrawBuffers(cnt, buffers);
-		}
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			area->set_error(Error(hw3_error_quark, 0, "Failed to create framebuffer."));
-			return false;
-		}
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		gl_render_buffer(*gl.buffer_program, get_camera_view(), cam_proj);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
-		glViewport(old_vp[0], old_vp[1], old_vp[2], old_vp[3]);
-	}
-
-	static constexpr bool useDebug{false};
-	GLuint tmp, out;
-	if (useDebug) {
-		glGenTextures(1, &out);
-		glBindTexture(GL_TEXTURE_2D, out);
-		glTexImage2D(
-			GL_TEXTURE_2D, 0,
-			GL_RGB16F, area->get_width(), area->get_height(),
-			0, GL_RGB, GL_FLOAT, nullptr
-		);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		glGenFramebuffers(1, &tmp);
-		glBindFramebuffer(GL_FRAMEBUFFER, tmp);
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, out, 0);
-		{
-			constexpr size_t cnt{1};
-			constexpr GLenum buffers[cnt]{GL_COLOR_ATTACHMENT0};
-			glDrawBuffers(cnt, buffers);
-		}
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			area->set_error(Error(hw3_error_quark, 0, "TMP"));
-			return false;
-		}
-	}
-
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	switch (display_mode_combobox->get_active_row_number()) {
-	case DEFERRED:
-		gl_render_deferred(get_camera_view(), cam_proj);
-		break;
-	case DEFERRED_LIGHTS:
-		gl_render_deferred(get_camera_view(), cam_proj);
-		gl_render_lights(get_camera_view(), cam_proj);
-		break;
-	case DEFERRED_LIGHTS_CULLED:
-		gl_render_deferred(get_camera_view(), cam_proj);
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_FRONT);
-		gl_render_lights(get_camera_view(), cam_proj);
-		glDisable(GL_CULL_FACE);
-		break;
-	case BUFFER_ALBEDO:
-		gl_render_texture(0);
-		break;
-	case BUFFER_NORMAL:
-		gl_render_texture(1);
-		break;
-	case BUFFER_DEPTH:
-		gl_render_texture(2);
-		break;
-	case SCENE_SINGLE_LIGHT:
-		gl_render_buffer(*gl.scene_program, get_camera_view(), cam_proj);
-		break;
-	}
-
-	if (useDebug) {
-		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
-		glDeleteTextures(1, &out);
-		glDeleteFramebuffers(1, &tmp);
-	}
-
-	glFlush();
+	renderer.progress = animation.progress;
+	renderer.display_mode = static_cast<Hw3Renderer::display_mode_t>(display_mode_combobox->get_active_row_number());
+	renderer.compact_gbuffer = compact_gbuffer->get_active();
+	renderer.camera_view = get_camera_view();
+	std::string error;
+	if (!renderer.gl_render(area->get_width(), area->get_height(), error))
+		area->set_error(Error(hw3_error_quark, 0, error));
 
 	return false;
 }
 
-void Hw3Window::gl_render_buffer(Program const &program, glm::mat4 const &view, glm::mat4 const &proj) {
-	program.use();
-
-	glUniform3fv(program.get_uniform("light_world"), 1, &gl.lights[0].position[0]);
-	glUniform3fv(program.get_uniform("light_color"), 1, &gl.lights[0].color[0]);
-	glUniform1f (program.get_uniform("light_power"), gl.lights[0].power);
-	glUniform1f (program.get_uniform("light_radius"), gl.lights[0].radius);
-
-	gl_draw_objects(program, view, proj);
-
-	glUseProgram(0);
-}
-
-void Hw3Window::gl_render_lights(glm::mat4 const &view, glm::mat4 const &proj) {
-	gl.light_program->use();
-
-	gl_draw_lights(*gl.light_program, view, proj);
-
-	glUseProgram(0);
-}
-
-void Hw3Window::gl_render_texture(int id) {
-	glDepthFunc(GL_ALWAYS);
-
-	gl.texture_program->use();
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gl.albedo_texture);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gl.normal_texture);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gl.depth_texture);
-
-	glUniform1i(gl.texture_program->get_uniform("id"), id);
-	glUniform1i(gl.texture_program->get_uniform("albedo"), 0);
-	glUniform1i(gl.texture_program->get_uniform("normal"), 1);
-	glUniform1i(gl.texture_program->get_uniform("depth"), 2);
-
-	gl_draw_object(*gl.texture_rect, *gl.texture_program, glm::mat4(), glm::mat4());
-
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	glUseProgram(0);
-
-	glDepthFunc(GL_LESS);
-}
-
-void Hw3Window::gl_render_deferred(glm::mat4 const &view, glm::mat4 const &proj) {
-	/* dissuse */
-	gl_render_texture(3);
-
-	/* lights */ {
-		glDepthFunc(GL_ALWAYS);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_ONE, GL_ONE);
-		glBlendEquation(GL_FUNC_ADD);
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_FRONT);
-		gl.deferred_program->use();
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, gl.albedo_texture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, gl.normal_texture);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, gl.depth_texture);
-
-		glUniform1i(gl.deferred_program->get_uniform("albedo_texture"), 0);
-		glUniform1i(gl.deferred_program->get_uniform("normal_texture"), 1);
-		glUniform1i(gl.deferred_program->get_uniform("depth_texture"), 2);
-
-		gl_draw_lights(*gl.deferred_program, view, proj);
-
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		glUseProgram(0);
-
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_BLEND);
-		glDepthFunc(GL_LESS);
-	}
-}
-
-void Hw3Window::gl_draw_objects(Program const &program, glm::mat4 const &v, glm::mat4 const &p) {
-	gl_draw_object(*gl.statue, program, v, p);
-	gl_draw_object(*gl.base_plane, program, v, p);
-	for (int i{0}; i != gl.acolytes_count; ++i)
-		gl_draw_object(*gl.acolytes[i], program, v, p);
-}
-
-void Hw3Window::gl_draw_lights(Program const &program, glm::mat4 const &v, glm::mat4 const &p) {
-	for (auto const &light: gl.lights) {
-		gl.light_sphere->position =
-			glm::translate(light.position)
-			* glm::scale(glm::vec3(light.radius, light.radius, light.radius));
-
-		glUniform3fv(program.get_uniform("light_world"), 1, &light.position[0]);
-		glUniform3fv(program.get_uniform("light_color"), 1, &light.color[0]);
-		glUniform1f (program.get_uniform("light_power"), light.power);
-		glUniform1f (program.get_uniform("light_radius"), light.radius);
-
-		gl_draw_object(*gl.light_sphere, program, v, p);
-	}
-}
-
-void Hw3Window::gl_draw_object(
-	SceneObject const &object,
-	Program const &program,
-	glm::mat4 const &v,
-	glm::mat4 const &p
-) {
-	object.set_attribute_to_position(program.get_attribute("vertex_position_model"));
-	object.set_attribute_to_normal  (program.get_attribute("vertex_normal_model"));
-	object.set_attribute_to_color   (program.get_attribute("vertex_color"));
-	glm::mat4 vp(p * v);
-	glm::mat4 v_inv(glm::inverse(v)), p_inv(glm::inverse(p)), vp_inv(glm::inverse(vp));
-	glUniformMatrix4fv(program.get_uniform("v"     ), 1, GL_FALSE, &v[0][0]);
-	glUniformMatrix4fv(program.get_uniform("p"     ), 1, GL_FALSE, &p[0][0]);
-	glUniformMatrix4fv(program.get_uniform("vp"    ), 1, GL_FALSE, &vp[0][0]);
-	glUniformMatrix4fv(program.get_uniform("v_inv" ), 1, GL_FALSE, &v_inv[0][0]);
-	glUniformMatrix4fv(program.get_uniform("p_inv" ), 1, GL_FALSE, &p_inv[0][0]);
-	glUniformMatrix4fv(program.get_uniform("vp_inv"), 1, GL_FALSE, &vp_inv[0][0]);
-	object.draw(
-		v, p,
-		program.get_uniform("m"),
-		program.get_uniform("mv"),
-		program.get_uniform("mvp"),
-		program.get_uniform("m_inv"),
-		program.get_uniform("mv_inv"),
-		program.get_uniform("mvp_inv")
-	);
-}
-
 glm::mat4 Hw3Window::get_camera_view() const {
 	return glm::rotate(navigation.yangle, glm::vec3(1, 0, 0)) *
 		glm::rotate(navigation.xangle, glm::vec3(0, -1, 0)) *
@@ -598,6 +216,14 @@ void Hw3Window::reset_animation_clicked() {
 	area->queue_render();
 }
 
+void Hw3Window::profile_export_clicked() {
+	std::string error;
+	if (renderer.profiler.export_files("profile", error))
+		std::cout << "Profile written to profile.csv and profile.json" << std::endl;
+	else
+		std::cout << "ERROR: " << error << std::endl;
+}
+
 void Hw3Window::tick(gint64 new_time) {
 	gint64 delta{new_time - animation.start_time};
 	double seconds_delta{delta / static_cast<double>(G_USEC_PER_SEC)};
@@ -644,26 +270,20 @@ void Hw3Window::tick(gint64 new_time) {
 			flag = true;
 		}
 		if (flag) {
-			direction *= view_range / 20;
+			direction *= renderer.view_range / 20;
 			navigation.camera_position += glm::vec3(inverse(get_camera_view()) * glm::vec4(direction, 0));
 			area->queue_render();
 		}
 	}
+	/* profile */ if (new_time - profile_shown_time >= G_USEC_PER_SEC / 2) {
+		profile_shown_time = new_time;
+		profile_stats->set_text(renderer.profiler.format_stats());
+		lighting_stats->set_text(renderer.format_lighting());
+	}
 }
 
 void Hw3Window::lights_changed() {
-	size_t new_size(lights_adjustment->get_value()), old_size{gl.lights.size()};
-	gl.lights.resize(new_size);
-	for (size_t i{old_size}; i < new_size; ++i) {
-		std::random_device rd;
-		std::default_random_engine rand(rd());
-		std::uniform_real_distribution<double> dist;
-		double const r{.20};
-		gl.lights[i].color = glm::vec3(dist(rand), dist(rand), dist(rand)) / 2.0f + .5f;
-		gl.lights[i].power = dist(rand) * .02;
-		gl.lights[i].speed = (dist(rand) * 4 + 8) * M_PI / 5;
-		gl.lights[i].radius = r;
-	}
+	renderer.set_lights_count(lights_adjustment->get_value());
 }
 
 void Hw3Window::display_mode_changed() {
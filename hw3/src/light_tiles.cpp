@@ -0,0 +1,96 @@
+#include "light_tiles.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+LightTiles::rect LightTiles::project(glm::vec4 const &position_radius, glm::mat4 const &v, glm::mat4 const &p, int width, int height) const {
+	rect const none{0, 0, 0, 0};
+	rect const all{0, 0, columns, rows};
+	glm::vec4 const center(v * glm::vec4(position_radius.x, position_radius.y, position_radius.z, 1));
+	float const radius{position_radius.w};
+	/* the camera looks along -z */
+	float const near{p[3][2] / (p[2][2] - 1)};
+	/* past the near plane as a whole, or crossing it */
+	if (center.z + radius > -near)
+		return (center.z - radius > -near) ? none : all;
+
+	/* the box around the sphere projects onto a rectangle around its image, the extremes are at its corners */
+	float x_min{+1}, x_max{-1}, y_min{+1}, y_max{-1};
+	for (float d: {-radius, radius})
+		for (float dz: {-radius, radius}) {
+			float const depth{-(center.z + dz)};
+			float const x{p[0][0] * (center.x + d) / depth};
+			float const y{p[1][1] * (center.y + d) / depth};
+			x_min = std::min(x_min, x);
+			x_max = std::max(x_max, x);
+			y_min = std::min(y_min, y);
+			y_max = std::max(y_max, y);
+		}
+	if (x_max < -1 || x_min > 1 || y_max < -1 || y_min > 1)
+		return none;
+
+	auto tile{[](float ndc, int size, int count) {
+		int const pixel{static_cast<int>(std::floor((std::max(-1.0f, std::min(1.0f, ndc)) + 1) / 2 * size))};
+		return std::max(0, std::min(count - 1, pixel / tile_size));
+	}};
+	return {
+		tile(x_min, width, columns), tile(y_min, height, rows),
+		tile(x_max, width, columns) + 1, tile(y_max, height, rows) + 1
+	};
+}
+
+void LightTiles::bin(std::vector<SceneObject::instance> const &lights, glm::mat4 const &v, glm::mat4 const &p, int width, int height) {
+	columns = (width + tile_size - 1) / tile_size;
+	rows = (height + tile_size - 1) / tile_size;
+	size_t const tiles_count{static_cast<size_t>(columns) * rows};
+	tile_lists.resize(tiles_count);
+	for (auto &list: tile_lists)
+		list.clear();
+	/* an empty viewport has no tiles to bin into */
+	if (tiles_count == 0) {
+		ranges.clear();
+		indices.clear();
+		return;
+	}
+
+	rects.resize(lights.size());
+	pool.run(lights.size(), 256, [&](size_t begin, size_t end) {
+		for (size_t i{begin}; i != end; ++i)
+			rects[i] = project(lights[i].position_scale, v, p, width, height);
+	});
+
+	/* every thread fills the lists of its own band of rows */
+	pool.run(rows, (lights.size() >= 1024) ? 1 : rows, [&](size_t begin, size_t end) {
+		int const row_begin(begin), row_end(end);
+		for (size_t i{0}; i != rects.size(); ++i) {
+			rect const &r{rects[i]};
+			for (int y{std::max(r.y0, row_begin)}; y < std::min(r.y1, row_end); ++y)
+				for (int x{r.x0}; x < r.x1; ++x)
+					tile_lists[y * columns + x].push_back(i);
+		}
+	});
+
+	ranges.resize(2 * tiles_count);
+	indices.clear();
+	for (size_t i{0}; i != tiles_count; ++i) {
+		ranges[2 * i] = indices.size();
+		ranges[2 * i + 1] = tile_lists[i].size();
+		indices.insert(indices.end(), tile_lists[i].begin(), tile_lists[i].end());
+	}
+}
+
+int LightTiles::get_columns() const {
+	return columns;
+}
+
+int LightTiles::get_rows() const {
+	return rows;
+}
+
+std::vector<GLuint> const &LightTiles::get_ranges() const {
+	return ranges;
+}
+
+std::vector<GLuint> const &LightTiles::get_indices() const {
+	return indices;
+}
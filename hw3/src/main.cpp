@@ -1,10 +1,53 @@
+#include "headless.hpp"
 #include "hw3_app.hpp"
+#include "hw3_renderer.hpp"
 #include "object.hpp"
 
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <giomm/init.h>
+
 #include <iostream>
+#include <stdexcept>
 #include <iterator>
 #include <fstream>
 
+/* Renders the animation from the default camera into files, see headless.hpp.
+ * Settings: lights (count, 1 by default), mode (Hw3Renderer::display_mode_t, deferred by default),
+ * compact (1 for the compact G-buffer, 0 by default), queue (0 to draw without Hw3Renderer::render_queue, 1 by default),
+ * packed (0 to upload the meshes without Hw3Renderer::packed_verticies, 1 by default),
+ * lod (Hw3Renderer::lod_error in pixels, 0 for no levels of detail, 1 by default).
+ * Prints the lighting time and fragments of the deferred, the stencil or the tiled mode at the end.
+ */
+static int run_headless(headless_options const &options) {
+	Gio::init();
+	HeadlessContext context(options.width, options.height);
+	Hw3Renderer renderer(options.seed);
+	renderer.set_lights_count(options.setting<size_t>("lights", 1));
+	renderer.display_mode = static_cast<Hw3Renderer::display_mode_t>(options.setting<int>("mode", Hw3Renderer::DEFERRED));
+	renderer.compact_gbuffer = options.setting<int>("compact", 0) != 0;
+	renderer.render_queue = options.setting<int>("queue", 1) != 0;
+	renderer.packed_verticies = options.setting<int>("packed", 1) != 0;
+	renderer.lod_error = options.setting<float>("lod", 1);
+	/* the initial camera of the window */
+	renderer.camera_view = glm::translate(-glm::vec3(0, .2, .2));
+
+	std::string error;
+	bool const ok{renderer.gl_init(error) && context.run(options, [&](float progress, std::string &error) {
+		renderer.progress = progress;
+		return renderer.gl_render(options.width, options.height, error);
+	}, error) && write_profile(renderer.profiler, options, error)};
+	if (ok)
+		std::cout << renderer.format_lighting();
+	renderer.gl_finit();
+	if (!ok) {
+		std::cerr << "ERROR: " << error << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
 int main(int argc, char **argv) {
 //	(void) argc;
 //	(void) argv;
@@ -16,6 +59,15 @@ int main(int argc, char **argv) {
 //		std::cout << obj << std::endl;
 //	}
 
+	try {
+		headless_options options;
+		if (parse_headless_options(argc, argv, options))
+			return run_headless(options);
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
 	try {
 		auto app{Hw3App::create(argc, argv)};
 		app->run();
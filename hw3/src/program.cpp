@@ -1,5 +1,6 @@
 #include "program.hpp"
 
+#include <algorithm>
 #include <vector>
 
 GLuint Program::build_shader(GLenum type, std::string const &source, std::string &error) {
@@ -37,6 +38,11 @@ std::unique_ptr<Program> Program::build_program(std::initializer_list<std::tuple
 	GLuint program{glCreateProgram()};
 	for (auto i: shaders)
 		glAttachShader(program, i);
+	glBindAttribLocation(program, position_location, "vertex_position_model");
+	glBindAttribLocation(program, normal_location, "vertex_normal_model");
+	glBindAttribLocation(program, color_location, "vertex_color");
+	glBindAttribLocation(program, instance_position_location, "instance_position");
+	glBindAttribLocation(program, instance_color_location, "instance_color");
 	glLinkProgram(program);
 	for (auto i: shaders) {
 		glDetachShader(program, i);
@@ -54,7 +60,100 @@ std::unique_ptr<Program> Program::build_program(std::initializer_list<std::tuple
 		glDeleteProgram(program);
 		return nullptr;
 	}
-	return std::make_unique<Program>(program);
+	auto result{std::make_unique<Program>(program)};
+	if (!result->reflect(error))
+		return nullptr;
+	return result;
+}
+
+bool Program::reflect(std::string &error) {
+	GLint length;
+	std::vector<char> buffer;
+	auto add{[&error](std::vector<location> &table, std::string const &key, GLint id) {
+		uint32_t const hash{name(key).get()};
+		for (auto const &l: table)
+			if (l.hash == hash) {
+				error = "Name hash collision: " + key;
+				return false;
+			}
+#ifndef NDEBUG
+		table.push_back({hash, static_cast<GLuint>(id), key});
+#else
+		table.push_back({hash, static_cast<GLuint>(id)});
+#endif
+		return true;
+	}};
+
+	/* uniforms */ {
+		GLint count;
+		glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+		buffer.resize(std::max(length, 1));
+		for (GLint i{0}; i != count; ++i) {
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(id, i, buffer.size(), nullptr, &size, &type, buffer.data());
+			std::string key{buffer.data()};
+			GLint const loc{glGetUniformLocation(id, key.c_str())};
+			/* members of uniform blocks have no location */
+			if (loc == -1)
+				continue;
+			/* arrays are reported as "name[0]" and looked up as "name" too */
+			if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0 && !add(uniforms, key.substr(0, key.size() - 3), loc))
+				return false;
+			if (!add(uniforms, key, loc))
+				return false;
+		}
+	}
+	/* attributes */ {
+		GLint count;
+		glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &length);
+		buffer.resize(std::max(length, 1));
+		for (GLint i{0}; i != count; ++i) {
+			GLint size;
+			GLenum type;
+			glGetActiveAttrib(id, i, buffer.size(), nullptr, &size, &type, buffer.data());
+			GLint const loc{glGetAttribLocation(id, buffer.data())};
+			/* built-ins like gl_VertexID */
+			if (loc == -1)
+				continue;
+			if (!add(attributes, buffer.data(), loc))
+				return false;
+		}
+	}
+
+	/* blocks */ {
+		static char const *const block_names[BLOCKS_COUNT]{"frame", "frame_inverse", "object", "object_inverse"};
+		for (int i{0}; i != BLOCKS_COUNT; ++i) {
+			GLuint const index{glGetUniformBlockIndex(id, block_names[i])};
+			if (index == GL_INVALID_INDEX)
+				continue;
+			glUniformBlockBinding(id, index, i);
+			blocks[i] = true;
+		}
+	}
+
+	auto by_hash{[](location const &a, location const &b) {
+		return a.hash < b.hash;
+	}};
+	std::sort(uniforms.begin(), uniforms.end(), by_hash);
+	std::sort(attributes.begin(), attributes.end(), by_hash);
+	return true;
+}
+
+GLuint Program::find(std::vector<location> const &table, name key) {
+	auto const it{std::lower_bound(table.begin(), table.end(), key.get(), [](location const &l, uint32_t hash) {
+		return l.hash < hash;
+	})};
+	if (it == table.end() || it->hash != key.get())
+		return no_id;
+#ifndef NDEBUG
+	/* a name that is not there but has the hash of one that is */
+	if (it->name != key.get_text())
+		return no_id;
+#endif
+	return it->id;
 }
 
 Program::Program(GLuint program):
@@ -64,12 +163,16 @@ Program::~Program() {
 	glDeleteProgram(id);
 }
 
-GLuint Program::get_uniform(std::string const &name) const {
-	return glGetUniformLocation(id, name.c_str());
+GLuint Program::get_uniform(name key) const {
+	return find(uniforms, key);
+}
+
+GLuint Program::get_attribute(name key) const {
+	return find(attributes, key);
 }
 
-GLuint Program::get_attribute(std::string const &name) const {
-	return glGetAttribLocation(id, name.c_str());
+bool Program::uses_block(block_t block) const {
+	return blocks[block];
 }
 
 void Program::use() const {
@@ -0,0 +1,96 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+template<typename T>
+static uint64_t id_of(std::vector<T> &list, T const &value) {
+	auto const it{std::find(list.begin(), list.end(), value)};
+	if (it != list.end())
+		return it - list.begin();
+	list.push_back(value);
+	return list.size() - 1;
+}
+
+void RenderQueue::set_pass(uint8_t id, pass p) {
+	if (passes.size() <= id)
+		passes.resize(id + 1);
+	passes[id] = std::move(p);
+}
+
+void RenderQueue::submit(uint8_t pass, draw const &d) {
+	if (draws.size() == max_draws)
+		throw std::length_error("RenderQueue::submit: more than max_draws draws before flush");
+	keys.push_back(
+		static_cast<uint64_t>(pass) << 56 |
+		(id_of(programs, d.program) & 0xff) << 48 |
+		(id_of(texture_sets, d.textures) & 0xffff) << 32 |
+		(id_of(meshes, d.mesh) & 0xffff) << 16 |
+		draws.size()
+	);
+	draws.push_back(d);
+}
+
+/* LSD radix sort by bytes, skipping the bytes all the keys share */
+void RenderQueue::sort() {
+	sorted.resize(keys.size());
+	for (int shift{0}; shift != 64; shift += 8) {
+		size_t counts[256]{};
+		for (uint64_t key: keys)
+			++counts[(key >> shift) & 0xff];
+		if (counts[(keys[0] >> shift) & 0xff] == keys.size())
+			continue;
+		size_t offset{0};
+		for (auto &c: counts)
+			offset += std::exchange(c, offset);
+		for (uint64_t key: keys)
+			sorted[counts[(key >> shift) & 0xff]++] = key;
+		keys.swap(sorted);
+	}
+}
+
+size_t RenderQueue::flush(GlState &state, UniformBlocks &blocks, bool sort_draws) {
+	if (sort_draws && !keys.empty())
+		sort();
+
+	/* the pass and the program, and with them the textures */
+	uint64_t constexpr program_mask{~uint64_t{0xffffffffffff}};
+	uint64_t constexpr group_mask{~uint64_t{0xffffffff}};
+	bool first{true};
+	uint64_t previous{0};
+	for (uint64_t key: keys) {
+		draw const &d{draws[key & 0xffff]};
+		pass const &p{passes[key >> 56]};
+		bool const new_program{first || (key & program_mask) != (previous & program_mask)};
+		bool const new_group{first || (key & group_mask) != (previous & group_mask)};
+		if (!sort_draws && new_group && !first)
+			state.reset();
+		if (new_program || (!sort_draws && new_group)) {
+			state.set_raster(p.raster);
+			state.use_program(d.program);
+			if (p.setup)
+				p.setup(*d.program);
+		}
+		if (new_group)
+			for (GLuint unit{0}; unit != max_textures; ++unit)
+				if (d.textures[unit] != 0)
+					state.bind_texture(unit, GL_TEXTURE_2D, d.textures[unit]);
+		if (d.instanced)
+			d.mesh->draw_instanced(blocks, *d.program);
+		else
+			d.mesh->draw(blocks, *d.program, d.lod);
+		first = false;
+		previous = key;
+	}
+	if (!sort_draws && !first)
+		state.reset();
+
+	size_t const count{draws.size()};
+	draws.clear();
+	keys.clear();
+	programs.clear();
+	texture_sets.clear();
+	meshes.clear();
+	return count;
+}
@@ -1,7 +1,11 @@
 #include "scene_object.hpp"
 #include "program.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 
 [[maybe_unused]]
 static void check(std::string const &name) {
@@ -12,104 +16,250 @@ static void check(std::string const &name) {
 		std::cout << "Check " << name << " FAILED " << std::hex << error << std::endl;
 }
 
-SceneObject::SceneObject(Object const &obj) {
+/* A vertex of PACKED_VERTICIES */
+struct packed_vertex {
+	uint16_t pos[4];
+	uint32_t norm;
+	uint8_t color[4];
+};
+static_assert(sizeof(packed_vertex) == 16, "packed verticies are 16 bytes");
+
+/* Packs the verticies, positions relative to the cube of the side scale at min */
+static std::vector<packed_vertex> pack(Object::vertex_data const *verticies, size_t count, glm::vec3 const &min, float scale) {
+	auto const unorm{[](float v, float range) {
+		return static_cast<uint32_t>(std::lround(glm::clamp(v, 0.0f, 1.0f) * range));
+	}};
+	auto const snorm10{[](float v) {
+		return static_cast<uint32_t>(std::lround(glm::clamp(v, -1.0f, 1.0f) * 511)) & 0x3FF;
+	}};
+	std::vector<packed_vertex> result(count);
+	for (size_t i{0}; i != count; ++i) {
+		auto const &v{verticies[i]};
+		auto &p{result[i]};
+		glm::vec3 const pos{(v.pos - min) / scale};
+		for (int c{0}; c != 3; ++c) {
+			p.pos[c] = unorm(pos[c], 65535);
+			p.color[c] = unorm(v.color[c], 255);
+		}
+		p.pos[3] = 0;
+		p.color[3] = 255;
+		p.norm = snorm10(v.norm.x) | snorm10(v.norm.y) << 10 | snorm10(v.norm.z) << 20;
+	}
+	return result;
+}
+
+SceneObject::SceneObject(Object const &obj, vertex_format_t format):
+	SceneObject(Object::binary_view{obj.verticies.data(), obj.verticies.size(), obj.faces.data(), obj.faces.size()}, format) {}
+
+SceneObject::SceneObject(Object::binary_view const &mesh, vertex_format_t format):
+	SceneObject(mesh, format, mesh.faces, mesh.faces_count, {{0, mesh.faces_count, 0}}) {}
+
+SceneObject::SceneObject(Object::binary_view const &mesh, vertex_format_t format, Object::lod_chain const &chain):
+	SceneObject(mesh, format, chain.faces.data(), chain.faces.size(), chain.levels) {}
+
+SceneObject::SceneObject(Object::binary_view const &mesh, vertex_format_t format,
+	Object::face const *faces, size_t faces_count, std::vector<Object::lod_chain::level> levels
+):
+	lods(std::move(levels)),
+	bounds(Object::compute_bounds(mesh.verticies, mesh.verticies_count)),
+	vertex_format(format)
+{
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
 
 	glGenBuffers(1, &data);
 	glBindBuffer(GL_ARRAY_BUFFER, data);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Object::vertex_data) * obj.verticies.size(), obj.verticies.data(), GL_STATIC_DRAW);
+	if (format == PACKED_VERTICIES) {
+		/* one scale for all the axes, so that the model matrix scales the normals uniformly */
+		glm::vec3 const size{bounds.max - bounds.min};
+		float scale{std::max(size.x, std::max(size.y, size.z))};
+		if (scale == 0)
+			scale = 1;
+		dequantize = glm::mat4(scale);
+		dequantize[3] = glm::vec4(bounds.min, 1);
+		auto const packed{pack(mesh.verticies, mesh.verticies_count, bounds.min, scale)};
+		vertex_bytes = sizeof(packed_vertex) * packed.size();
+		glBufferData(GL_ARRAY_BUFFER, vertex_bytes, packed.data(), GL_STATIC_DRAW);
+	} else {
+		vertex_bytes = sizeof(Object::vertex_data) * mesh.verticies_count;
+		glBufferData(GL_ARRAY_BUFFER, vertex_bytes, mesh.verticies, GL_STATIC_DRAW);
+	}
 
 	glGenBuffers(1, &elems);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
-	elems_count = obj.faces.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(decltype(obj.faces)::value_type) * elems_count, obj.faces.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Object::face) * faces_count, faces, GL_STATIC_DRAW);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	set_attributes(format);
+
+	/* the element buffer binding is a part of the VAO, it stays */
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 };
 
+void SceneObject::set_attributes(vertex_format_t format) {
+	struct {
+		GLuint location;
+		GLint size;
+		GLenum type;
+		GLboolean normalized;
+		size_t offset;
+	} const float_attributes[]{
+		{Program::position_location, 3, GL_FLOAT, GL_FALSE, offsetof(Object::vertex_data, pos)},
+		{Program::normal_location, 3, GL_FLOAT, GL_FALSE, offsetof(Object::vertex_data, norm)},
+		{Program::color_location, 3, GL_FLOAT, GL_FALSE, offsetof(Object::vertex_data, color)}
+	}, packed_attributes[]{
+		{Program::position_location, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(packed_vertex, pos)},
+		{Program::normal_location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(packed_vertex, norm)},
+		{Program::color_location, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(packed_vertex, color)}
+	};
+	bool const packed{format == PACKED_VERTICIES};
+	GLsizei const stride{static_cast<GLsizei>(packed ? sizeof(packed_vertex) : sizeof(Object::vertex_data))};
+	for (auto const &attribute: packed ? packed_attributes : float_attributes) {
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location,
+			attribute.size, attribute.type,
+			attribute.normalized,
+			stride, reinterpret_cast<GLvoid const *>(attribute.offset)
+		);
+	}
+	glVertexAttrib4f(Program::instance_position_location, 0, 0, 0, 1);
+	glVertexAttrib4f(Program::instance_color_location, 1, 1, 1, 1);
+}
+
 SceneObject::~SceneObject() {
+	glDeleteBuffers(1, &instances);
 	glDeleteBuffers(1, &data);
 	glDeleteBuffers(1, &elems);
+	glDeleteVertexArrays(1, &instanced_vao);
 	glDeleteVertexArrays(1, &vao);
 }
 
-void SceneObject::draw(
-	glm::mat4 const &v, glm::mat4 const &p,
-	GLuint m_attribute, GLuint mv_attribute, GLuint mvp_attribute,
-	GLuint m_inv_attribute, GLuint mv_inv_attribute, GLuint mvp_inv_attribute
-) const {
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
-
-	glm::mat4 m(position * animation_position), m_inv(glm::inverse(m));
-	glm::mat4 mv(v * m), mv_inv(glm::inverse(mv));
-	glm::mat4 mvp(p * mv), mvp_inv(glm::inverse(mvp));
-	glUniformMatrix4fv(m_attribute      , 1, GL_FALSE, &m      [0][0]);
-	glUniformMatrix4fv(mv_attribute     , 1, GL_FALSE, &mv     [0][0]);
-	glUniformMatrix4fv(mvp_attribute    , 1, GL_FALSE, &mvp    [0][0]);
-	glUniformMatrix4fv(m_inv_attribute  , 1, GL_FALSE, &m_inv  [0][0]);
-	glUniformMatrix4fv(mv_inv_attribute , 1, GL_FALSE, &mv_inv [0][0]);
-	glUniformMatrix4fv(mvp_inv_attribute, 1, GL_FALSE, &mvp_inv[0][0]);
+Object::bounds_t SceneObject::get_bounds() const {
+	glm::mat4 const m{position * animation_position};
+	glm::vec3 const center{m * glm::vec4((bounds.min + bounds.max) / 2.0f, 1)};
+	glm::vec3 const half{(bounds.max - bounds.min) / 2.0f};
+	/* every axis of the box adds the absolute values of its image, the sphere grows with the longest one */
+	glm::vec3 extent{0};
+	float scale{0};
+	for (int i{0}; i != 3; ++i) {
+		glm::vec3 const axis{m[i]};
+		extent += glm::abs(axis) * half[i];
+		scale = std::max(scale, glm::length(axis));
+	}
+	return {
+		center - extent, center + extent,
+		glm::vec3(m * glm::vec4(bounds.center, 1)), bounds.radius * scale
+	};
+}
 
-	glDrawElements(GL_TRIANGLES, (elems_count) * 3, GL_UNSIGNED_INT, nullptr);
+size_t SceneObject::get_vertex_bytes() const {
+	return vertex_bytes;
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+size_t SceneObject::get_faces_count(size_t lod) const {
+	return lods[lod].count;
 }
 
-void SceneObject::set_attribute_to_position(GLuint attribute) const {
-	if (attribute == Program::no_id)
-		return;
+size_t SceneObject::select_lod(glm::mat4 const &view, glm::mat4 const &proj, float height, float max_error) const {
+	if (max_error <= 0 || lods.size() == 1 || bounds.radius == 0)
+		return 0;
+	auto const sphere{get_bounds()};
+	/* pixels of a world unit at the sphere: a perspective divides by the depth of its nearest point, an orthographic does not */
+	float pixels{proj[1][1] * height / 2};
+	if (proj[2][3] != 0) {
+		float const depth{-glm::vec3(view * glm::vec4(sphere.center, 1)).z - sphere.radius};
+		/* the camera is in the sphere or right at it */
+		if (depth <= 0)
+			return 0;
+		pixels /= depth;
+	}
+	/* the errors are in model units, relative to the radius of the sphere in the model they scale with it */
+	float const pixels_per_error{pixels * sphere.radius / bounds.radius};
+	size_t lod{0};
+	while (lod + 1 != lods.size() && lods[lod + 1].error * pixels_per_error <= max_error)
+		++lod;
+	return lod;
+}
 
+void SceneObject::draw(UniformBlocks &blocks, Program const &program, size_t lod) const {
 	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, data);
-	
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute,
-		3, GL_FLOAT,
-		GL_FALSE,
-		sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offsetof(Object::vertex_data, pos))
-	);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	blocks.set_object(program, position * animation_position * dequantize);
+	auto const &level{lods[lod]};
+	glDrawElements(GL_TRIANGLES, level.count * 3, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const *>(sizeof(Object::face) * level.first));
+
 	glBindVertexArray(0);
 }
 
-void SceneObject::set_attribute_to_normal(GLuint attribute) const {
-	if (attribute == Program::no_id)
-		return;
+void SceneObject::set_instance_attributes(size_t first) const {
+	pointed_instance = first;
+	struct {
+		GLuint location;
+		size_t offset;
+	} const attributes[]{
+		{Program::instance_position_location, offsetof(instance, position_scale)},
+		{Program::instance_color_location, offsetof(instance, color_power)}
+	};
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	for (auto const &attribute: attributes)
+		glVertexAttribPointer(attribute.location,
+			4, GL_FLOAT,
+			GL_FALSE,
+			sizeof(instance), reinterpret_cast<GLvoid const *>(first * sizeof(instance) + attribute.offset)
+		);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, data);
-	
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute,
-		3, GL_FLOAT,
-		GL_FALSE,
-		sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offsetof(Object::vertex_data, norm))
-	);
-	
+void SceneObject::set_instances(std::vector<instance> const &list) {
+	if (instances == 0) {
+		glGenVertexArrays(1, &instanced_vao);
+		glBindVertexArray(instanced_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, data);
+		set_attributes(vertex_format);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+		glGenBuffers(1, &instances);
+		set_instance_attributes(0);
+		glEnableVertexAttribArray(Program::instance_position_location);
+		glEnableVertexAttribArray(Program::instance_color_location);
+		glVertexAttribDivisor(Program::instance_position_location, 1);
+		glVertexAttribDivisor(Program::instance_color_location, 1);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, instances);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, instances);
+	}
+	instances_count = list.size();
+	glBufferData(GL_ARRAY_BUFFER, sizeof(instance) * list.size(), list.data(), GL_STREAM_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
 
-void SceneObject::set_attribute_to_color(GLuint attribute) const {
-	if (attribute == Program::no_id)
+void SceneObject::draw_instanced(UniformBlocks &blocks, Program const &program) const {
+	if (instances_count == 0)
 		return;
+	glBindVertexArray(instanced_vao);
+	if (pointed_instance != 0)
+		set_instance_attributes(0);
+	blocks.set_object(program, position * animation_position * dequantize);
+	glDrawElementsInstanced(GL_TRIANGLES, lods[0].count * 3, GL_UNSIGNED_INT, nullptr, instances_count);
+	glBindVertexArray(0);
+}
 
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, data);
-
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute,
-		3, GL_FLOAT,
-		GL_FALSE,
-		sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offsetof(Object::vertex_data, color))
-	);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void SceneObject::draw_instance(UniformBlocks &blocks, Program const &program, size_t index) const {
+	if (index >= instances_count)
+		return;
+	static bool const base_instance{epoxy_gl_version() >= 42 || epoxy_has_gl_extension("GL_ARB_base_instance")};
+	glBindVertexArray(instanced_vao);
+	blocks.set_object(program, position * animation_position * dequantize);
+	if (base_instance) {
+		if (pointed_instance != 0)
+			set_instance_attributes(0);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, lods[0].count * 3, GL_UNSIGNED_INT, nullptr, 1, index);
+	} else {
+		/* GL 3.3 has no base instance, so the attributes start at the instance instead,
+		 * repointed only when it changes: the draws of one instance in a row share the pointers
+		 */
+		if (pointed_instance != index)
+			set_instance_attributes(index);
+		glDrawElementsInstanced(GL_TRIANGLES, lods[0].count * 3, GL_UNSIGNED_INT, nullptr, 1);
+	}
 	glBindVertexArray(0);
 }
@@ -0,0 +1,586 @@
+#include "headless.hpp"
+#include "object.hpp"
+#include "program.hpp"
+#include "scene_object.hpp"
+#include "uniform_blocks.hpp"
+
+#include <epoxy/gl.h>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/* The shortest of repeats runs of f in seconds, from an idle GPU; the GPU work f leaves behind is not timed */
+template<typename F>
+static double best_of(int repeats, F const &f) {
+	double best{0};
+	for (int repeat{0}; repeat != repeats; ++repeat) {
+		glFinish();
+		auto const start{std::chrono::steady_clock::now()};
+		f();
+		auto const finish{std::chrono::steady_clock::now()};
+		glFinish();
+
+		double const seconds{std::chrono::duration<double>(finish - start).count()};
+		best = (repeat == 0) ? seconds : std::min(best, seconds);
+	}
+	return best;
+}
+
+/* The inputs gl_draw_object and gl_draw_lights set for every light of the deferred pass */
+static char const *const vertex_shader{R"(
+	#version 330 core
+	uniform mat4 m, v, p, mv, mvp, vp, m_inv, v_inv, p_inv, mv_inv, vp_inv, mvp_inv;
+	in vec3 vertex_position_model;
+	in vec3 vertex_normal_model;
+	in vec3 vertex_color;
+	out vec3 color;
+	void main() {
+		vec4 position = mvp * vec4(vertex_position_model, 1) + vp * vec4(vertex_normal_model, 0);
+		position += m_inv * v_inv * p_inv * mv_inv * vp_inv * mvp_inv * m * v * p * mv * vec4(0, 0, 0, 1) * 1e-9;
+		gl_Position = position;
+		color = vertex_color;
+	}
+)"};
+
+static char const *const fragment_shader{R"(
+	#version 330 core
+	uniform vec3 light_world, light_color;
+	uniform float light_power, light_radius;
+	in vec3 color;
+	out vec4 result;
+	void main() {
+		result = vec4(color * light_color * light_power + light_world * light_radius * 1e-9, 1);
+	}
+)"};
+
+namespace uniforms {
+	static constexpr Program::name
+		v{"v"},
+		p{"p"},
+		vp{"vp"},
+		v_inv{"v_inv"},
+		p_inv{"p_inv"},
+		vp_inv{"vp_inv"},
+		m{"m"},
+		mv{"mv"},
+		mvp{"mvp"},
+		m_inv{"m_inv"},
+		mv_inv{"mv_inv"},
+		mvp_inv{"mvp_inv"},
+		light_world{"light_world"},
+		light_color{"light_color"},
+		light_power{"light_power"},
+		light_radius{"light_radius"};
+}
+
+namespace attributes {
+	static constexpr Program::name
+		vertex_position_model{"vertex_position_model"},
+		vertex_normal_model{"vertex_normal_model"},
+		vertex_color{"vertex_color"};
+}
+
+/* CPU cost of a light draw with its 19 lookups, the driver way the Program used to do it and through its table */
+static void bench_uniforms(int draws) {
+	HeadlessContext context(64, 64);
+
+	std::string error;
+	auto program{Program::build_program({
+		{GL_VERTEX_SHADER, vertex_shader},
+		{GL_FRAGMENT_SHADER, fragment_shader}
+	}, error)};
+	if (program == nullptr)
+		throw std::runtime_error(error);
+	program->use();
+	GLint id;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &id);
+
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	float const matrix[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+	float const vector[3]{0, 0, 0};
+	auto draw{[&](auto &&uniform, auto &&attribute) {
+		glVertexAttrib3fv(attribute("vertex_position_model", attributes::vertex_position_model), vector);
+		glVertexAttrib3fv(attribute("vertex_normal_model",   attributes::vertex_normal_model  ), vector);
+		glVertexAttrib3fv(attribute("vertex_color",          attributes::vertex_color         ), vector);
+		glUniformMatrix4fv(uniform("v",       uniforms::v      ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("p",       uniforms::p      ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("vp",      uniforms::vp     ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("v_inv",   uniforms::v_inv  ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("p_inv",   uniforms::p_inv  ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("vp_inv",  uniforms::vp_inv ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("m",       uniforms::m      ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("mv",      uniforms::mv     ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("mvp",     uniforms::mvp    ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("m_inv",   uniforms::m_inv  ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("mv_inv",  uniforms::mv_inv ), 1, GL_FALSE, matrix);
+		glUniformMatrix4fv(uniform("mvp_inv", uniforms::mvp_inv), 1, GL_FALSE, matrix);
+		glUniform3fv(uniform("light_world",  uniforms::light_world ), 1, vector);
+		glUniform3fv(uniform("light_color",  uniforms::light_color ), 1, vector);
+		glUniform1f (uniform("light_power",  uniforms::light_power ), 1);
+		glUniform1f (uniform("light_radius", uniforms::light_radius), 1);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}};
+
+	auto measure{[&](char const *name, auto &&uniform, auto &&attribute) {
+		double const best{best_of(5, [&] {
+			for (int i{0}; i != draws; ++i)
+				draw(uniform, attribute);
+		})};
+		std::printf("  %-7s best %.1f ns per draw\n", name, best / draws * 1e9);
+	}};
+
+	std::printf("%d draws, 16 uniforms and 3 attributes each:\n", draws);
+	/* the strings are made per call, as the old std::string const & accessors did */
+	measure("driver", [id](char const *name, Program::name) -> GLuint {
+		return glGetUniformLocation(id, std::string(name).c_str());
+	}, [id](char const *name, Program::name) -> GLuint {
+		return glGetAttribLocation(id, std::string(name).c_str());
+	});
+	measure("cached", [&program](char const *, Program::name key) {
+		return program->get_uniform(key);
+	}, [&program](char const *, Program::name key) {
+		return program->get_attribute(key);
+	});
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vao);
+	glUseProgram(0);
+}
+
+/* SceneObject as it was before the VAOs were set up once: the attributes are pointed at the program's locations before every draw */
+class respecified_object {
+private:
+	GLuint vao, elems, data;
+	size_t elems_count;
+
+	void set_attribute(GLuint attribute, size_t offset) const {
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, data);
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offset));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+public:
+	explicit respecified_object(Object::binary_view const &mesh) {
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glGenBuffers(1, &data);
+		glBindBuffer(GL_ARRAY_BUFFER, data);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Object::vertex_data) * mesh.verticies_count, mesh.verticies, GL_STATIC_DRAW);
+		glGenBuffers(1, &elems);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+		elems_count = mesh.faces_count;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Object::face) * elems_count, mesh.faces, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+	respecified_object(respecified_object const &other) = delete;
+	~respecified_object() {
+		glDeleteBuffers(1, &data);
+		glDeleteBuffers(1, &elems);
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	void draw(UniformBlocks &blocks, Program const &program) const {
+		/* the renderers looked the attributes up and set them before every draw */
+		set_attribute(Program::position_location, offsetof(Object::vertex_data, pos));
+		set_attribute(Program::normal_location, offsetof(Object::vertex_data, norm));
+		set_attribute(Program::color_location, offsetof(Object::vertex_data, color));
+
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+		blocks.set_object(program, glm::mat4{1});
+		glDrawElements(GL_TRIANGLES, elems_count * 3, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+};
+
+/* The scene shaders reduced to their matrices */
+static char const *const scene_vertex_shader{R"(
+	#version 330 core
+	layout(std140) uniform object {
+		mat4 m, mv, mvp;
+	};
+	in vec3 vertex_position_model;
+	in vec3 vertex_color;
+	out vec3 color;
+	void main() {
+		gl_Position = mvp * vec4(vertex_position_model, 1);
+		color = vertex_color;
+	}
+)"};
+
+/* CPU cost of drawing the objects of the hw3 scene (the statue, the acolytes and the base plane) with SceneObject::draw,
+ * and with the attributes pointed at the program's locations before every draw, as SceneObject used to do
+ */
+static void bench_draws(int frames) {
+	HeadlessContext context(64, 64);
+
+	std::string error;
+	auto program{Program::build_program({
+		{GL_VERTEX_SHADER, scene_vertex_shader},
+		{GL_FRAGMENT_SHADER, fragment_shader}
+	}, error)};
+	if (program == nullptr)
+		throw std::runtime_error(error);
+	program->use();
+	UniformBlocks blocks;
+	blocks.gl_init();
+
+	/* built by make from res/, in the drawing order of Hw3Renderer: the statue, 6 acolytes, the plane */
+	MappedMesh const statue("res/stanford_bunny_statue.mesh"), acolyte("res/stanford_bunny.mesh"), plane("res/plane.mesh");
+	std::vector<Object::binary_view> const scene{
+		statue.view(),
+		acolyte.view(), acolyte.view(), acolyte.view(), acolyte.view(), acolyte.view(), acolyte.view(),
+		plane.view()
+	};
+	std::vector<std::unique_ptr<SceneObject>> objects;
+	std::vector<std::unique_ptr<respecified_object>> respecified;
+	size_t faces{0};
+	for (auto const &mesh: scene) {
+		objects.push_back(std::make_unique<SceneObject>(mesh));
+		respecified.push_back(std::make_unique<respecified_object>(mesh));
+		faces += mesh.faces_count;
+	}
+
+	/* looking away from the scene, so that the GPU has little to draw */
+	blocks.begin_frame();
+	blocks.set_camera(
+		glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, 1, 0)),
+		glm::perspective(1.0f, 1.0f, 10.0f, 20.0f)
+	);
+
+	auto measure{[&](char const *name, auto const &list) {
+		double const best{best_of(5, [&] {
+			for (int frame{0}; frame != frames; ++frame)
+				for (auto const &object: list)
+					object->draw(blocks, *program);
+		})};
+		std::printf("  %-10s best %.1f ns per draw\n", name, best / frames / list.size() * 1e9);
+	}};
+
+	std::printf("%d frames of %zu draws, %zu triangles:\n", frames, scene.size(), faces);
+	measure("respecify", respecified);
+	measure("vao", objects);
+
+	objects.clear();
+	respecified.clear();
+	blocks.gl_finit();
+	glUseProgram(0);
+}
+
+/* The light volume shaders of the deferred pass before and after instancing */
+static char const *const light_vertex_shader{R"(
+	#version 330 core
+	uniform mat4 vp, m;
+	uniform vec3 light_world, light_color;
+	uniform float light_power, light_radius;
+	in vec3 vertex_position_model;
+	out vec3 color;
+	void main() {
+		gl_Position = vp * vec4(light_world + light_radius * (m * vec4(vertex_position_model, 1)).xyz, 1);
+		color = light_color * light_power;
+	}
+)"};
+
+static char const *const instanced_vertex_shader{R"(
+	#version 330 core
+	uniform mat4 vp, m;
+	in vec3 vertex_position_model;
+	in vec4 instance_position;
+	in vec4 instance_color;
+	out vec3 color;
+	void main() {
+		gl_Position = vp * vec4(instance_position.xyz + instance_position.w * (m * vec4(vertex_position_model, 1)).xyz, 1);
+		color = instance_color.rgb * instance_color.a;
+	}
+)"};
+
+static char const *const color_fragment_shader{R"(
+	#version 330 core
+	in vec3 color;
+	out vec4 result;
+	void main() {
+		result = vec4(color, 1);
+	}
+)"};
+
+/* CPU cost of the light volumes: a draw with its uniforms per light, as Hw3Renderer::gl_draw_lights used to do,
+ * and one instanced draw after the instances are uploaded
+ */
+static void bench_lights(int lights) {
+	HeadlessContext context(64, 64);
+
+	std::string error;
+	auto looped{Program::build_program({
+		{GL_VERTEX_SHADER, light_vertex_shader},
+		{GL_FRAGMENT_SHADER, color_fragment_shader}
+	}, error)};
+	auto instanced{Program::build_program({
+		{GL_VERTEX_SHADER, instanced_vertex_shader},
+		{GL_FRAGMENT_SHADER, color_fragment_shader}
+	}, error)};
+	if (looped == nullptr || instanced == nullptr)
+		throw std::runtime_error(error);
+
+	/* a tetrahedron far behind the camera, so that the draws themselves cost little */
+	float const verticies[]{0, 0, 100, 1, 0, 100, 0, 1, 100, 0, 0, 101};
+	GLuint const faces[]{0, 1, 2, 0, 1, 3, 0, 2, 3, 1, 2, 3};
+	struct instance {
+		float position_scale[4];
+		float color_power[4];
+	};
+	std::vector<instance> instances(lights, instance{{0, 0, 0, 1}, {1, 1, 1, 1}});
+
+	GLuint vao, data, elems, instances_buffer;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &data);
+	glBindBuffer(GL_ARRAY_BUFFER, data);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(verticies), verticies, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(Program::position_location);
+	glVertexAttribPointer(Program::position_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+	glGenBuffers(1, &elems);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+	glGenBuffers(1, &instances_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instances_buffer);
+	GLuint const instance_locations[]{Program::instance_position_location, Program::instance_color_location};
+	for (size_t i{0}; i != 2; ++i) {
+		glEnableVertexAttribArray(instance_locations[i]);
+		glVertexAttribPointer(instance_locations[i], 4, GL_FLOAT, GL_FALSE, sizeof(instance), reinterpret_cast<GLvoid const *>(sizeof(float) * 4 * i));
+		glVertexAttribDivisor(instance_locations[i], 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	float const matrix[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+	float const vector[3]{0, 0, 0};
+
+	auto measure{[&](char const *name, auto &&frame) {
+		double best{0};
+		for (int repeat{0}; repeat != 5; ++repeat) {
+			glFinish();
+			auto const start{std::chrono::steady_clock::now()};
+			frame();
+			auto const finish{std::chrono::steady_clock::now()};
+			glFinish();
+
+			double const seconds{std::chrono::duration<double>(finish - start).count()};
+			best = (repeat == 0) ? seconds : std::min(best, seconds);
+		}
+		std::printf("  %-9s best %.3f ms per frame\n", name, best * 1e3);
+	}};
+
+	std::printf("%d lights:\n", lights);
+	looped->use();
+	glUniformMatrix4fv(looped->get_uniform(Program::name("vp")), 1, GL_FALSE, matrix);
+	glUniformMatrix4fv(looped->get_uniform(Program::name("m")), 1, GL_FALSE, matrix);
+	measure("looped", [&] {
+		for (int i{0}; i != lights; ++i) {
+			glUniform3fv(looped->get_uniform(uniforms::light_world), 1, vector);
+			glUniform3fv(looped->get_uniform(uniforms::light_color), 1, vector);
+			glUniform1f (looped->get_uniform(uniforms::light_power), 1);
+			glUniform1f (looped->get_uniform(uniforms::light_radius), 1);
+			glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, nullptr);
+		}
+	});
+	instanced->use();
+	glUniformMatrix4fv(instanced->get_uniform(Program::name("vp")), 1, GL_FALSE, matrix);
+	glUniformMatrix4fv(instanced->get_uniform(Program::name("m")), 1, GL_FALSE, matrix);
+	measure("instanced", [&] {
+		glBindBuffer(GL_ARRAY_BUFFER, instances_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(instance) * instances.size(), instances.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glDrawElementsInstanced(GL_TRIANGLES, 12, GL_UNSIGNED_INT, nullptr, lights);
+	});
+
+	glBindVertexArray(0);
+	glDeleteBuffers(1, &instances_buffer);
+	glDeleteBuffers(1, &data);
+	glDeleteBuffers(1, &elems);
+	glDeleteVertexArrays(1, &vao);
+	glUseProgram(0);
+}
+
+/* A G-buffer-like pass with a fragment shader heavy enough for the overdraw to show */
+static char const *const mesh_vertex_shader{R"(
+	#version 330 core
+	uniform mat4 mvp;
+	in vec3 vertex_position_model;
+	in vec3 vertex_normal_model;
+	in vec3 vertex_color;
+	out vec3 normal;
+	out vec3 color;
+	void main() {
+		gl_Position = mvp * vec4(vertex_position_model, 1);
+		normal = vertex_normal_model;
+		color = vertex_color;
+	}
+)"};
+
+static char const *const mesh_fragment_shader{R"(
+	#version 330 core
+	in vec3 normal;
+	in vec3 color;
+	out vec4 result;
+	void main() {
+		vec3 n = normalize(normal);
+		vec3 sum = vec3(0);
+		for (int i = 0; i != 32; ++i) {
+			vec3 l = normalize(vec3(sin(float(i)), cos(float(i)), 1));
+			sum += color * max(dot(n, l), 0) / 32;
+		}
+		result = vec4(sum, 1);
+	}
+)"};
+
+/* Frame time of drawing a mesh from several sides in the order it is loaded and after Object::optimize_faces
+ * and Object::optimize_vertex_fetch, with the fragments that pass the depth test
+ */
+static void bench_mesh(std::string const &path, int frames) {
+	int constexpr width{800}, height{600}, views{8};
+	HeadlessContext context(width, height);
+
+	std::string error;
+	auto program{Program::build_program({
+		{GL_VERTEX_SHADER, mesh_vertex_shader},
+		{GL_FRAGMENT_SHADER, mesh_fragment_shader}
+	}, error)};
+	if (program == nullptr)
+		throw std::runtime_error(error);
+	program->use();
+	GLuint const mvp{program->get_uniform(Program::name("mvp"))};
+
+	std::ifstream f(path, std::ios::binary);
+	if (!f)
+		throw std::runtime_error("Cannot open " + path);
+	std::string const obj(std::istreambuf_iterator<char>{f}, {});
+	Object loaded{Object::load(obj.data(), obj.size())};
+	Object optimized{loaded};
+	optimized.optimize_faces();
+	optimized.optimize_vertex_fetch();
+	auto const bounds{Object::compute_bounds(loaded.verticies.data(), loaded.verticies.size())};
+
+	GLuint query;
+	glGenQueries(1, &query);
+	auto measure{[&](char const *name, Object const &o) {
+		GLuint vao, data, elems;
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glGenBuffers(1, &data);
+		glBindBuffer(GL_ARRAY_BUFFER, data);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Object::vertex_data) * o.verticies.size(), o.verticies.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &elems);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Object::face) * o.faces.size(), o.faces.data(), GL_STATIC_DRAW);
+		GLuint const locations[]{Program::position_location, Program::normal_location, Program::color_location};
+		for (size_t i{0}; i != 3; ++i) {
+			glEnableVertexAttribArray(locations[i]);
+			glVertexAttribPointer(locations[i], 3, GL_FLOAT, GL_FALSE, sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(sizeof(float) * 3 * i));
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		double best{0};
+		GLuint samples{0};
+		for (int frame{0}; frame != frames; ++frame) {
+			glFinish();
+			auto const start{std::chrono::steady_clock::now()};
+			glBeginQuery(GL_SAMPLES_PASSED, query);
+			for (int view{0}; view != views; ++view) {
+				/* turned around y and fit into the clip space */
+				float const angle{6.2831853f * view / views};
+				float const c{std::cos(angle) / bounds.radius}, s{std::sin(angle) / bounds.radius};
+				glm::vec3 const &center{bounds.center};
+				float const matrix[16]{
+					c, 0, -s, 0,
+					0, 1 / bounds.radius, 0, 0,
+					s, 0, c, 0,
+					-(c * center.x + s * center.z), -center.y / bounds.radius, s * center.x - c * center.z, 1
+				};
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glUniformMatrix4fv(mvp, 1, GL_FALSE, matrix);
+				glDrawElements(GL_TRIANGLES, 3 * o.faces.size(), GL_UNSIGNED_INT, nullptr);
+			}
+			glEndQuery(GL_SAMPLES_PASSED);
+			glFinish();
+			auto const finish{std::chrono::steady_clock::now()};
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+
+			double const seconds{std::chrono::duration<double>(finish - start).count()};
+			best = (frame == 0) ? seconds : std::min(best, seconds);
+		}
+		auto const stats{o.analyze_vertex_cache(16)};
+		std::printf(
+			"  %-9s best %.3f ms per frame, ACMR %.3f, %.1f fragments passed the depth test per view\n",
+			name, best * 1e3, stats.acmr, static_cast<double>(samples) / views
+		);
+
+		glBindVertexArray(0);
+		glDeleteBuffers(1, &data);
+		glDeleteBuffers(1, &elems);
+		glDeleteVertexArrays(1, &vao);
+	}};
+
+	std::printf("%s, %zu faces, %d views of %dx%d per frame, %d frames:\n", path.c_str(), loaded.faces.size(), views, width, height, frames);
+	measure("loaded", loaded);
+	measure("optimized", optimized);
+	glDeleteQueries(1, &query);
+	glUseProgram(0);
+}
+
+static int usage(char const *self) {
+	std::fprintf(stderr,
+		"Usage:\n"
+		"  %s uniforms [draws]\n"
+		"  %s draws [frames]\n"
+		"  %s lights [lights]\n"
+		"  %s mesh <file.obj> [frames]\n",
+		self, self, self, self
+	);
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2)
+		return usage(argv[0]);
+	std::string const command{argv[1]};
+
+	try {
+		if (command == "uniforms") {
+			bench_uniforms((argc >= 3) ? std::stoi(argv[2]) : 100000);
+			return 0;
+		}
+		if (command == "draws") {
+			bench_draws((argc >= 3) ? std::stoi(argv[2]) : 1000);
+			return 0;
+		}
+		if (command == "mesh" && argc >= 3) {
+			bench_mesh(argv[2], (argc >= 4) ? std::stoi(argv[3]) : 20);
+			return 0;
+		}
+		if (command == "lights") {
+			bench_lights((argc >= 3) ? std::stoi(argv[2]) : 5000);
+			return 0;
+		}
+	} catch (std::exception const &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return usage(argv[0]);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+
+#include <gdk/gdk.h>
+
+#include <CL/cl.h>
+#include <CL/cl_gl.h>
+
+#include <vector>
+
+/* Context properties sharing the current GL context of the display with OpenCL (cl_khr_gl_sharing),
+ * empty if the windowing system is not supported.
+ */
+std::vector<cl_context_properties> gl_sharing_properties(cl_platform_id platform, GdkDisplay *display);
+
+/* Device driving the GL context from the properties, nullptr if there is none. */
+cl_device_id gl_sharing_device(cl_platform_id platform, std::vector<cl_context_properties> const &properties);
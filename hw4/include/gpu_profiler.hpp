@@ -0,0 +1,138 @@
+#pragma once
+
+#include <epoxy/gl.h>
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Times render passes on the GPU with GL_TIMESTAMP queries and never stalls for them:
+ * queries of a frame are read frames_in_flight frames later, and a frame whose results are still not there is dropped.
+ * Keeps rolling statistics per pass and a trace of the last events, samples timed elsewhere (OpenCL events) can be added.
+ * The trace is on the steady clock from the creation of the profiler: GL timestamps are moved to it by an offset taken once per context.
+ * Counters (objects drawn, objects culled) are kept over the same window, one value per frame.
+ */
+class GpuProfiler {
+public:
+	static size_t constexpr frames_in_flight{4};
+	/* Samples per pass the statistics are over */
+	static size_t constexpr window{256};
+	/* Events kept for the trace */
+	static size_t constexpr trace_size{8192};
+	/* Variants kept per pass, see pass */
+	static size_t constexpr max_variants{16};
+	static uint64_t constexpr no_variant{UINT64_MAX};
+
+	struct stats {
+		std::string name;
+		size_t count;
+		/* milliseconds, or the values of a counter */
+		double average, p50, p95, p99, max;
+	};
+
+	/* Times the rest of the enclosing block as a pass.
+	 * A variant, such as the light count, keeps the pass name fixed and is averaged apart, see get_variants.
+	 */
+	class pass {
+	private:
+		GpuProfiler &profiler;
+
+	public:
+		pass(GpuProfiler &profiler, char const *name, uint64_t variant = no_variant);
+		pass(pass const &other) = delete;
+		~pass();
+	};
+
+private:
+	struct query_pair {
+		size_t pass;
+		uint64_t variant;
+		GLuint begin, end;
+	};
+
+	struct frame {
+		std::vector<query_pair> queries;
+		size_t used{0};
+		bool pending{false};
+	};
+
+	struct variant_samples {
+		uint64_t variant;
+		std::deque<double> durations;
+	};
+
+	struct pass_samples {
+		std::string name;
+		std::deque<double> durations;
+		/* the last used at the back */
+		std::deque<variant_samples> variants;
+	};
+
+	struct event {
+		size_t track;
+		size_t pass;
+		/* nanoseconds since origin */
+		uint64_t start, duration;
+	};
+
+	frame frames[frames_in_flight];
+	size_t current{0};
+	std::vector<size_t> open;
+	bool in_frame{false};
+	size_t dropped{0};
+
+	std::vector<pass_samples> passes;
+	/* the durations are the values */
+	std::vector<pass_samples> counters;
+	std::vector<std::string> tracks;
+	std::deque<event> trace;
+	/* now() at the creation, the start of the trace */
+	uint64_t const origin;
+	/* now() minus GL_TIMESTAMP, set by the first begin_frame of a context */
+	int64_t gl_offset{0};
+	bool gl_calibrated{false};
+
+	static size_t get_samples(std::vector<pass_samples> &list, std::string const &name);
+	static std::vector<stats> get_stats(std::vector<pass_samples> const &list);
+	size_t get_pass(std::string const &name);
+	size_t get_track(std::string const &name);
+	void record(size_t track, size_t pass, uint64_t variant, uint64_t start, uint64_t end);
+	void collect(frame &f, bool wait);
+	void begin_pass(char const *name, uint64_t variant);
+	void end_pass();
+
+public:
+	GpuProfiler();
+	GpuProfiler(GpuProfiler const &other) = delete;
+
+	/* steady_clock nanoseconds, the clock of add_sample */
+	static uint64_t now();
+
+	void gl_finit();
+
+	void begin_frame();
+	void end_frame();
+	/* Reads every pending frame, waiting for the GPU; for the end of a run */
+	void finish();
+
+	/* A pass timed elsewhere, in now() nanoseconds */
+	void add_sample(std::string const &track, std::string const &name, uint64_t start, uint64_t end);
+	/* A value of the counter in this frame */
+	void add_counter(std::string const &name, double value);
+
+	std::vector<stats> get_stats() const;
+	std::vector<stats> get_counter_stats() const;
+	/* Average milliseconds of the pass by its variant, in the variant order */
+	std::vector<std::pair<uint64_t, double>> get_variants(std::string const &pass) const;
+	/* Aligned text tables of get_stats() and get_counter_stats() */
+	std::string format_stats() const;
+	/* Statistics as CSV */
+	void write_csv(std::ostream &out) const;
+	/* Trace in the Chrome trace event format (chrome://tracing, Perfetto), one thread per track */
+	void write_trace(std::ostream &out) const;
+	/* Writes <prefix>.csv and <prefix>.json, returns false with the error set on failure */
+	bool export_files(std::string const &prefix, std::string &error) const;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#define GLM_FORCE_SWIZZLE
+
+#include "gpu_profiler.hpp"
+#include "marching_cl.hpp"
+#include "marching_cpu.hpp"
+#include "marching_worker.hpp"
+#include "scene_object.hpp"
+#include "program.hpp"
+#include "uniform_blocks.hpp"
+
+#include <glm/glm.hpp>
+
+#include <gdk/gdk.h>
+
+#include <epoxy/gl.h>
+#include <CL/cl2.hpp>
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/* The scene and everything drawing it, with no widgets attached:
+ * Hw4Window drives it from a Gtk::GLArea, the headless mode from an offscreen framebuffer.
+ */
+class Hw4Renderer {
+public:
+	enum display_mode_t {
+		MARCHING_CUBES,
+		SPHERES,
+		SPHERES_WITH_CUBE
+	};
+
+	enum marching_backend_t {
+		MARCHING_OPENCL,
+		MARCHING_CPU
+	};
+
+	static float constexpr fov{60};
+	float const view_range{1};
+
+	/* Frame state, set before gl_render */
+	float progress{0};
+	display_mode_t display_mode{MARCHING_CUBES};
+	glm::mat4 camera_view{1};
+	glm::vec3 camera_position{0, 0, 0};
+	float
+		color_power{.15},
+		reflect_power{.35},
+		refract_power{.5},
+		refract_index{1.52};
+
+	/* Geometry, geometry_changed() has to be called after changing it */
+	marching_backend_t marching_backend{MARCHING_OPENCL};
+	int xresolution{20}, yresolution{20}, zresolution{20};
+	float threshold{1};
+	/* 0: every sphere everywhere */
+	float influence{0};
+
+	/* Draw the mesh of the current frame, waiting for it. Otherwise the previous mesh is drawn until the new one is built. */
+	bool wait_for_marching{false};
+
+	/* Times every pass of gl_render, and the mesh builds with their OpenCL commands */
+	GpuProfiler profiler;
+
+private:
+	struct _gl {
+		std::unique_ptr<Program>
+			marching_program,
+			spheres_program,
+			skybox_program;
+		UniformBlocks blocks;
+
+		GLuint framebuffer;
+		GLuint
+			skybox_texture;
+
+		struct sphere {
+			glm::vec3 position;
+			float power;
+			float speed;
+			float radius;
+		};
+
+		std::vector<sphere> spheres;
+		/* the spheres as instances of sphere, refilled every frame */
+		std::vector<SceneObject::instance> sphere_instances;
+		std::unique_ptr<SceneObject> sphere, cube, mesh, skybox, plane;
+		/* gl.mesh or the one owned by cl.marching */
+		SceneObject const *marching_mesh{nullptr};
+		bool marching_outdated{true};
+	} gl;
+
+	struct _cl {
+		cl::Device device;
+		cl::Context context;
+		std::unique_ptr<MarchingCl> marching;
+		bool gl_sharing{false};
+	} cl;
+
+	MarchingCpu marching_cpu;
+	/* Builds meshes off the GL thread */
+	std::unique_ptr<MarchingWorker> marching_worker;
+
+	/* Source of the new spheres */
+	std::default_random_engine random;
+
+	/* Draw with the camera of the frame, set to gl.blocks */
+	bool gl_render_marching(std::string &error);
+	void gl_render_spheres(bool box);
+	void gl_render_skybox();
+	void gl_draw_object(SceneObject const &object, Program const &program);
+
+public:
+	/* Spheres are random, the same seed gives the same spheres */
+	explicit Hw4Renderer(unsigned seed);
+
+	/* Keeps the first spheres and makes up the new ones */
+	void set_spheres_count(size_t count);
+	void geometry_changed();
+
+	MarchingCpu const &get_marching_cpu() const;
+	/* false until gl_init found an OpenCL device, the CPU builds the meshes then */
+	bool has_opencl() const;
+
+	/* Need a current GL context, return false with the error set on failure.
+	 * display is used to share buffers between OpenCL and the context, may be nullptr;
+	 * marching_ready is called on the worker thread whenever a mesh is built.
+	 */
+	bool gl_init(GdkDisplay *display, std::function<void()> marching_ready, std::string &error);
+	void gl_finit();
+	/* Draws into the bound framebuffer of the given size */
+	bool gl_render(int width, int height, std::string &error);
+};
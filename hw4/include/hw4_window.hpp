@@ -2,27 +2,21 @@
 
 #define GLM_FORCE_SWIZZLE
 
-#define CL_HPP_TARGET_OPENCL_VERSION  120
-#define CL_HPP_MINIMUM_OPENCL_VERSION 120
-#define CL_HPP_ENABLE_EXCEPTIONS
-
-#include "scene_object.hpp"
-#include "program.hpp"
+#include "hw4_renderer.hpp"
 
 #include <glm/glm.hpp>
 
+#include <glibmm/dispatcher.h>
 #include <gtkmm/builder.h>
 #include <gtkmm/button.h>
 #include <gtkmm/combobox.h>
 #include <gtkmm/eventbox.h>
 #include <gtkmm/glarea.h>
+#include <gtkmm/label.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/togglebutton.h>
 #include <gtkmm/window.h>
 
-#include <epoxy/gl.h>
-#include <CL/cl2.hpp>
-
 #include <memory>
 
 class Hw4Window: public Gtk::Window {
@@ -32,13 +26,17 @@ private:
 	Gtk::GLArea *area;
 	Gtk::EventBox *area_eventbox;
 	Gtk::ToggleButton *animate;
-	Gtk::ComboBox *display_mode_combobox;
-	Gtk::Button *reset_position, *reset_animation, *normalize_power;
+	Gtk::CheckButton *sparse;
+	Gtk::Scale *influence_scale;
+	Gtk::ComboBox *display_mode_combobox, *marching_backend_combobox;
+	Gtk::Button *reset_position, *reset_animation, *normalize_power, *profile_export;
+	Gtk::Label *profile_stats;
 
-	Glib::RefPtr<Gtk::ListStore> display_mode_list_store;
+	Glib::RefPtr<Gtk::ListStore> display_mode_list_store, marching_backend_list_store;
 	Glib::RefPtr<Gtk::Adjustment>
 		spheres_adjustment,
 		threshold_adjustment,
+		influence_adjustment,
 		xresolution_adjustment,
 		yresolution_adjustment,
 		zresolution_adjustment,
@@ -47,47 +45,12 @@ private:
 		refract_power_adjustment,
 		refract_index_adjustment;
 
-	enum display_mode_t {
-		MARCHING_CUBES,
-		SPHERES,
-		SPHERES_WITH_CUBE
-	};
-
-	struct _gl {
-		std::unique_ptr<Program>
-			marching_program,
-			spheres_program,
-			skybox_program;
-
-		static float constexpr fov{60};
-		GLuint framebuffer;
-		GLuint
-			skybox_texture;
-
-		struct sphere {
-			glm::vec3 position;
-			float power;
-			float speed;
-			float radius;
-		};
-
-		std::vector<sphere> spheres;
-		std::unique_ptr<SceneObject> sphere, cube, mesh, skybox, plane;
-	} gl;
-
-	struct _cl {
-		cl::Device device;
-		cl::Context context;
-		cl::CommandQueue queue;
-		cl::Kernel
-			fill_values,
-			find_edges,
-			put_vertices,
-			build_mesh;
-	} cl;
+	/* Wakes the main loop up when the renderer has built a mesh, outlives the renderer's worker */
+	Glib::Dispatcher marching_ready;
+	Hw4Renderer renderer;
 
 	guint ticker_id;
-	float view_range;
+	gint64 profile_shown_time{0};
 
 	struct {
 		enum {
@@ -118,10 +81,6 @@ private:
 	void gl_init();
 	void gl_finit();
 	bool gl_render(Glib::RefPtr<Gdk::GLContext> const &context);
-	void gl_render_marching(glm::mat4 const &view, glm::mat4 const &proj);
-	void gl_render_spheres(glm::mat4 const &view, glm::mat4 const &proj, bool box);
-	void gl_render_skybox(glm::mat4 const &view, glm::mat4 const &proj);
-	void gl_draw_object(SceneObject const &object, Program const &program, glm::mat4 const &v, glm::mat4 const &p);
 
 	glm::mat4 get_camera_view() const;
 
@@ -129,7 +88,9 @@ private:
 	void reset_position_clicked();
 	void reset_animation_clicked();
 	void normalize_power_clicked();
+	void profile_export_clicked();
 	void spheres_changed();
+	void sparse_toggled();
 	void geometry_changed();
 	void options_changed();
 	bool mouse_pressed(GdkEventButton *event);
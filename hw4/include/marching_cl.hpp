@@ -0,0 +1,135 @@
+#pragma once
+
+#define CL_HPP_TARGET_OPENCL_VERSION  120
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_ENABLE_EXCEPTIONS
+
+#include "marching_cpu.hpp"
+#include "scene_object.hpp"
+
+#include <glm/glm.hpp>
+
+#include <CL/cl2.hpp>
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* OpenCL marching cubes (marching_geometry.cl).
+ * Device buffers only grow and kernel arguments are set only when they change,
+ * so rebuilding the mesh at the same resolution allocates nothing on the device.
+ *
+ * compute() runs the kernels and needs no GL context, so it may run on a worker thread;
+ * publish() then turns its result into the mesh on the GL thread.
+ * No compute() may run while publish() does: both use the verticies and triangles buffers.
+ * The queue is created with profiling enabled: every command of compute() and publish() is timed,
+ * and moved from the device clock to the steady clock by an offset taken after the first wait for the queue.
+ */
+class MarchingCl {
+public:
+	/* Time of one command, in steady_clock nanoseconds */
+	struct command_time {
+		char const *name;
+		uint64_t start, end;
+	};
+
+private:
+	/* Kernel remembering its arguments */
+	class cached_kernel {
+	private:
+		std::vector<std::vector<unsigned char>> args;
+
+		void set_raw(cl_uint index, void const *value, size_t size);
+
+	public:
+		cl::Kernel kernel;
+
+		explicit cached_kernel(cl::Kernel const &kernel);
+
+		template<typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+		void set_arg(cl_uint index, T const &value) {
+			set_raw(index, &value, sizeof(T));
+		}
+		void set_arg(cl_uint index, cl::Buffer const &buffer);
+	};
+
+	struct device_buffer {
+		cl::Buffer buffer;
+		size_t size{0};
+	};
+
+	/* One level of the recursive scan, kernels are per level so their arguments stay bound */
+	struct scan_level {
+		cached_kernel blocks, add;
+		device_buffer sums, offsets;
+
+		explicit scan_level(cl::Program const &program);
+	};
+
+	cl::Context context;
+	cl::Device device;
+	cl::Program program;
+	cl::CommandQueue queue;
+	bool gl_sharing;
+	size_t scan_group_size;
+
+	cached_kernel
+		fill_values,
+		find_edges,
+		number_edges,
+		put_vertices,
+		count_triangles,
+		build_mesh;
+	std::vector<scan_level> edges_scan, triangles_scan;
+
+	marching_bricks bricks;
+	device_buffer
+		brick_offsets, a, c,
+		values,
+		edge_used, vertex_ids,
+		triangle_counts, triangle_offsets,
+		counts,
+		verticies, triangles;
+
+	/* Result of compute(), read back when there is no GL sharing */
+	size_t vertex_count{0}, triangle_count{0};
+	std::vector<Object::vertex_data> host_data;
+	std::vector<Object::face> host_elems;
+
+	/* Published mesh: its buffers are shared with GL, or it is made of the host copy */
+	std::unique_ptr<SceneObject> mesh;
+	size_t mesh_verticies_capacity{0}, mesh_faces_capacity{0};
+	cl::BufferGL shared_verticies, shared_triangles;
+	std::vector<cl::Memory> shared_objects;
+
+	/* Events of the commands enqueued since the last collect_timings() */
+	std::vector<std::pair<char const *, cl::Event>> events;
+	std::vector<command_time> timings;
+	/* steady_clock minus device clock */
+	int64_t device_offset{0};
+	bool device_calibrated{false};
+
+	/* Event for the command about to be enqueued */
+	cl::Event *timed(char const *name);
+	/* Needs every command finished */
+	void collect_timings();
+	void reserve(device_buffer &target, cl_mem_flags flags, size_t size);
+	void exclusive_scan(
+		std::vector<scan_level> &levels, size_t level,
+		cl::Buffer const &data, cl::Buffer const &result, cl_int count,
+		size_t total_offset
+	);
+
+public:
+	MarchingCl(cl::Context const &context, cl::Device const &device, cl::Program const &program, bool gl_sharing);
+	MarchingCl(MarchingCl const &other) = delete;
+	~MarchingCl();
+
+	void compute(marching_input const &input);
+	/* Returns the mesh of the last compute(), owned by this object and valid until the next publish; nullptr if it is empty. */
+	SceneObject const *publish();
+
+	/* Commands of the last compute() and the publish() after it */
+	std::vector<command_time> const &get_timings() const;
+};
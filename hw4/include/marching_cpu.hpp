@@ -0,0 +1,70 @@
+#pragma once
+
+#include "object.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+/* Metaballs field F(p) = sum a[i] / |p - c[i]|^2 - threshold on a n*m*k grid over [-zone, zone]^3.
+ * With influence > 0 a sphere is cut off farther than influence * sqrt(a[i] / threshold) from its center,
+ * influence = 0 keeps every sphere everywhere.
+ */
+struct marching_input {
+	int n, m, k;
+	float zone;
+	float threshold;
+	float influence;
+	std::vector<float> a;
+	std::vector<glm::vec3> c;
+};
+
+/* Spheres sorted into bricks of size^3 cubes, a brick lists every sphere whose cut-off ball touches it
+ * (including its boundary points), so a grid point only sums the spheres of its brick.
+ * Without a cut-off the whole grid is a single brick.
+ */
+struct marching_bricks {
+	int size;
+	int n, m, k;
+	int nx, ny, nz;
+	/* brick -> [offsets[brick], offsets[brick + 1]) in a and c */
+	std::vector<int> offsets;
+	std::vector<float> a;
+	/* center, cut-off radius squared (infinity without a cut-off) */
+	std::vector<glm::vec4> c;
+
+	void build(marching_input const &input);
+
+	/* Brick of the cube starting at the point, points on the far faces go to the last bricks */
+	int brick_of(int x, int y, int z) const {
+		return ((std::min(z, k - 1) / size) * ny + std::min(y, m - 1) / size) * nx + std::min(x, n - 1) / size;
+	}
+	int get_bricks() const {
+		return nx * ny * nz;
+	}
+};
+
+/* Native marching cubes: same tables and the same mesh as marching_geometry.cl. */
+class MarchingCpu {
+public:
+	struct kernels;
+
+private:
+	unsigned threads;
+	kernels const *simd;
+
+	marching_bricks bricks;
+	std::vector<float> cx, cy, cz, cr2;
+	std::vector<float> values;
+	std::vector<int> vertex_ids, vertex_bricks;
+	std::vector<int> chunk_counts;
+
+public:
+	explicit MarchingCpu(unsigned threads = 0);
+
+	Object build(marching_input const &input);
+
+	unsigned get_threads() const;
+	char const *get_simd_name() const;
+};
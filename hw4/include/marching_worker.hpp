@@ -0,0 +1,62 @@
+#pragma once
+
+#include "marching_cl.hpp"
+#include "marching_cpu.hpp"
+#include "object.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* Builds marching cubes meshes on its own thread, so that the GTK main loop never waits for them.
+ * Only the latest request is kept: requests coming faster than meshes are built replace each other.
+ * A built mesh waits until it is consumed and the next one is not started before that,
+ * so MarchingCl::publish() in the consumer never races with MarchingCl::compute().
+ */
+class MarchingWorker {
+public:
+	struct result {
+		/* true: the mesh is in the MarchingCl, to be published on the GL thread */
+		bool cl;
+		/* the CPU mesh */
+		std::unique_ptr<Object> object;
+		/* non-empty if the build failed */
+		std::string error;
+		/* when the build ran, in steady_clock nanoseconds */
+		uint64_t started, finished;
+	};
+
+private:
+	MarchingCpu &cpu;
+	MarchingCl *cl;
+	/* called on the worker thread when a result is ready */
+	std::function<void()> notify;
+
+	std::mutex mutex;
+	std::condition_variable wake, built;
+	bool stopping{false}, building{false};
+	std::unique_ptr<marching_input> pending;
+	bool pending_cl;
+	std::unique_ptr<result> ready;
+	std::thread thread;
+
+	void run();
+
+public:
+	/* cl may be nullptr, then every request goes to the CPU */
+	MarchingWorker(MarchingCpu &cpu, MarchingCl *cl, std::function<void()> notify);
+	MarchingWorker(MarchingWorker const &other) = delete;
+	~MarchingWorker();
+
+	void request(marching_input input, bool use_cl);
+	/* Calls f with the built result if there is one, the next build starts once f returns */
+	bool consume(std::function<void(result &)> const &f);
+	/* Blocks until the last request is built, for callers that cannot draw a stale mesh.
+	 * A request is not started before the previous result is consumed, so that has to happen first.
+	 */
+	void wait();
+};
@@ -3,30 +3,60 @@
 #define GLM_FORCE_SWIZZLE
 
 #include "object.hpp"
+#include "program.hpp"
+#include "uniform_blocks.hpp"
 
 #include <epoxy/gl.h>
 #include <glm/glm.hpp>
 
+#include <vector>
+
 class SceneObject {
+public:
+	/* Attributes of an instance of draw_instanced, instance_position and instance_color of the shaders */
+	struct instance {
+		/* translation and uniform scale applied after the model matrix */
+		glm::vec4 position_scale;
+		glm::vec4 color_power;
+	};
+
 private:
 	GLuint vao{0};
 	GLuint elems{0}, data{0};
 	size_t elems_count;
+	/* the VAO of draw_instanced: the one of draw and the instances, made by the first set_instances */
+	GLuint instanced_vao{0};
+	GLuint instances{0};
+	size_t instances_count{0};
+
+	/* Points the attributes at Program's fixed locations, with the VAO and the data buffer bound.
+	 * The instance attributes get the current values of draw, as they have no arrays in vao;
+	 * those are context state, and nothing else sets them.
+	 */
+	static void set_attributes();
 
 public:
 	glm::mat4 position{1.0}, animation_position{1.0};
 
 	explicit SceneObject(Object const &obj);
+	explicit SceneObject(Object::binary_view const &mesh);
+	/* Uninitialized storage for the given mesh size, to be filled by someone else (OpenCL). */
+	SceneObject(size_t verticies_count, size_t faces_count);
 	SceneObject(SceneObject const &other) = delete;
 	~SceneObject();
 
-	void draw(
-		glm::mat4 const &v, glm::mat4 const &p,
-		GLuint m_attribute, GLuint mv_attribute, GLuint mvp_attribute,
-		GLuint m_inv_attribute, GLuint mv_inv_attribute, GLuint mvp_inv_attribute
-	) const;
+	/* Binds the blocks of the model matrix the program uses and draws.
+	 * Programs reading the instance attributes see an instance with no translation, unit scale and white color.
+	 */
+	void draw(UniformBlocks &blocks, Program const &program) const;
+
+	/* Replaces the instances, orphaning their buffer, so that the draws in flight keep the old ones */
+	void set_instances(std::vector<instance> const &list);
+	/* Draws all the instances with one glDrawElementsInstanced */
+	void draw_instanced(UniformBlocks &blocks, Program const &program) const;
+
+	GLuint get_data_buffer() const;
+	GLuint get_elems_buffer() const;
+	void set_elems_count(size_t count);
 
-	void set_attribute_to_position(GLuint attribute) const;
-	void set_attribute_to_normal(GLuint attribute) const;
-	void set_attribute_to_color(GLuint attribute) const;
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Threads started once and kept waiting for parallel loops, so that a loop starts no thread.
+ * One loop runs at a time, the calling thread takes a part of it too.
+ */
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	bool stopping{false};
+	/* the loop running: f over [0, count) in parts, next is the first part not taken, remaining those not done */
+	std::function<void(size_t, size_t)> const *f{nullptr};
+	size_t count{0}, parts{0}, next{0}, remaining{0};
+
+	void work();
+
+public:
+	/* threads counts the calling one, 0 is one per hardware thread */
+	explicit ThreadPool(unsigned threads = 0);
+	ThreadPool(ThreadPool const &other) = delete;
+	~ThreadPool();
+
+	unsigned get_threads() const;
+	/* Calls f(begin, end) for parts of [0, count) and returns when all are done.
+	 * There are as many parts as there are threads, fewer if a part would get less than grain items:
+	 * below that, f runs on the calling thread alone.
+	 */
+	void run(size_t count, size_t grain, std::function<void(size_t, size_t)> const &f);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLM_FORCE_SWIZZLE
+
+#include "program.hpp"
+
+#include <epoxy/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/* The matrices of the draws as std140 uniform blocks, which Program binds by name to the points of Program::block_t:
+ *   layout(std140) uniform frame          { mat4 v; mat4 p; mat4 vp; vec3 eye_world; };
+ *   layout(std140) uniform frame_inverse  { mat4 v_inv; mat4 p_inv; mat4 vp_inv; };
+ *   layout(std140) uniform object         { mat4 m; mat4 mv; mat4 mvp; };
+ *   layout(std140) uniform object_inverse { mat4 m_inv; mat4 mv_inv; mat4 mvp_inv; };
+ * The blocks are written to consecutive ranges of one buffer, which is orphaned when a frame starts or it is full,
+ * so a draw never waits for the previous ones to read their ranges. A block is written only for the programs using it:
+ * the camera once per camera, the inverses only if some program reads them.
+ */
+class UniformBlocks {
+private:
+	struct frame_block {
+		glm::mat4 v, p, vp;
+		/* vec3 padded to 16 bytes */
+		glm::vec4 eye_world;
+	};
+	struct frame_inverse_block {
+		glm::mat4 v_inv, p_inv, vp_inv;
+	};
+	struct object_block {
+		glm::mat4 m, mv, mvp;
+	};
+
+	static size_t constexpr capacity{1 << 18};
+
+	GLuint buffer{0};
+	GLint alignment{256};
+	size_t used{0};
+
+	frame_block frame;
+	frame_inverse_block frame_inverse;
+	bool frame_inverse_computed{false};
+	/* the blocks are in the current storage of the buffer and bound */
+	bool frame_written{false}, frame_inverse_written{false};
+
+	/* Lets the buffer storage go, the draws done keep reading the old one */
+	void orphan();
+	void write(Program::block_t block, void const *data, size_t size);
+
+public:
+	UniformBlocks() = default;
+	UniformBlocks(UniformBlocks const &other) = delete;
+
+	void gl_init();
+	void gl_finit();
+
+	void begin_frame();
+	/* Camera of the following draws. The view is to be rigid, as lookAt and the renderers' cameras are:
+	 * the eye is taken from it without inverting.
+	 */
+	void set_camera(glm::mat4 const &v, glm::mat4 const &p);
+	/* Binds the blocks the program uses for a draw of a model with the given matrix */
+	void set_object(Program const &program, glm::mat4 const &m);
+};
@@ -65,15 +65,20 @@ def main():
     print('\tint v_line = n + 1;')
     print('\tint v_plane = v_line * (m + 1);')
     print('\tswitch (id) {')
+    edge_offsets = []
     for i, e in enumerate(edges):
         add = ''
         final_add = ''
         if positions[e[0]][0] != positions[e[1]][0]:  # x edge
             final_add += ' + 0'
+            axis = 0
         elif positions[e[0]][1] != positions[e[1]][1]:  # y edge
             final_add += ' + 1'
+            axis = 1
         else:  # z edge
             final_add += ' + 2'
+            axis = 2
+        edge_offsets.append([(positions[e[0]][j] + 1) // 2 for j in range(3)] + [axis])
         if positions[e[0]][2] == 1:
             add += ' + v_plane'
         if positions[e[0]][1] == 1:
@@ -192,6 +197,7 @@ def main():
         # return [e1, e2, e3, e2, e3, e4, e3, e4, e5, e4, e5, e6]
 
     lens = []
+    table = []
     print_debug = True
     unhandled = 0
     print('constant char edges[', max_triangles * 3 << vertices, '] = {', sep='')
@@ -268,6 +274,7 @@ def main():
         assert len(edges_in_case) // 3 <= max_triangles
         lens.append(len(edges_in_case) // 3)
         edges_in_case += [-1 for _ in range(3 * max_triangles - len(edges_in_case))]
+        table.append(edges_in_case)
         print('\t', ', '.join(map(lambda t: '%2d' % t, edges_in_case)), ',', sep='')
     print('};')
     if print_debug:
@@ -287,6 +294,23 @@ def main():
     print(file=stderr)
     print('#define MAX_TRIANGLES ', max_triangles, file=stderr)
     print(file=stderr)
+    print('/* Same tables as in marching_geometry.cl, for the CPU backend. */', file=stderr)
+    print(file=stderr)
+    print('/* Edge -> grid vertex offset (dx, dy, dz) and edge axis, see vertex_by_edge. */', file=stderr)
+    print('static signed char constexpr marching_edge_offsets[', len(edges), '][4] = {', sep='', file=stderr)
+    for i, o in enumerate(edge_offsets):
+        print('\t{', ', '.join(map(str, o)), '}, // ', i, sep='', file=stderr)
+    print('};', file=stderr)
+    print(file=stderr)
+    print('static signed char constexpr marching_edges[', 1 << vertices, '][', 3 * max_triangles, '] = {', sep='', file=stderr)
+    for t in table:
+        print('\t{', ', '.join(map(lambda t: '%2d' % t, t)), '},', sep='', file=stderr)
+    print('};', file=stderr)
+    print(file=stderr)
+    print('static unsigned char constexpr marching_case_sizes[', 1 << vertices, '] = {\n\t', sep='', end='', file=stderr)
+    print(*lens, sep=', ', file=stderr)
+    print('};', file=stderr)
+    print(file=stderr)
     print('// CODE ABOVE IS GENERATED', file=stderr)
 
 
@@ -1,18 +1,30 @@
 #version 330 core
 
-uniform mat4 m;
-uniform mat4 mvp;
+layout(std140) uniform frame {
+	mat4 v;
+	mat4 p;
+	mat4 vp;
+	vec3 eye_world;
+};
+layout(std140) uniform object {
+	mat4 m;
+	mat4 mv;
+	mat4 mvp;
+};
 
 uniform int mode;
 
 in vec3 vertex_position_model;
 in vec3 vertex_normal_model;
 in vec3 vertex_color;
+/* xyz: the center of the sphere, w: its scale */
+in vec4 instance_position;
 
 out vec3 fragment_color;
 
 void main() {
-	gl_Position = mvp * vec4(vertex_position_model, 1);
+	vec3 position_world = instance_position.xyz + instance_position.w * (m * vec4(vertex_position_model, 1)).xyz;
+	gl_Position = vp * vec4(position_world, 1);
 
 	if (mode == 0) {
 		vec3 normal_world = normalize((m * vec4(vertex_normal_model, 0)).xyz);
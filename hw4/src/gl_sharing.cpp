@@ -0,0 +1,55 @@
+#include "gl_sharing.hpp"
+
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#include <epoxy/glx.h>
+#endif
+#ifdef GDK_WINDOWING_WAYLAND
+#include <gdk/gdkwayland.h>
+#include <epoxy/egl.h>
+#endif
+
+using std::vector;
+
+vector<cl_context_properties> gl_sharing_properties(cl_platform_id platform, GdkDisplay *display) {
+	static_cast<void>(platform);
+	static_cast<void>(display);
+#ifdef GDK_WINDOWING_X11
+	if (GDK_IS_X11_DISPLAY(display) && glXGetCurrentContext() != nullptr)
+		return {
+			CL_GL_CONTEXT_KHR, reinterpret_cast<cl_context_properties>(glXGetCurrentContext()),
+			CL_GLX_DISPLAY_KHR, reinterpret_cast<cl_context_properties>(glXGetCurrentDisplay()),
+			CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platform),
+			0
+		};
+#endif
+#ifdef GDK_WINDOWING_WAYLAND
+	if (GDK_IS_WAYLAND_DISPLAY(display) && eglGetCurrentContext() != EGL_NO_CONTEXT)
+		return {
+			CL_GL_CONTEXT_KHR, reinterpret_cast<cl_context_properties>(eglGetCurrentContext()),
+			CL_EGL_DISPLAY_KHR, reinterpret_cast<cl_context_properties>(eglGetCurrentDisplay()),
+			CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platform),
+			0
+		};
+#endif
+	return {};
+}
+
+cl_device_id gl_sharing_device(cl_platform_id platform, vector<cl_context_properties> const &properties) {
+	if (properties.empty())
+		return nullptr;
+
+	/* extension function, has to be looked up */
+	auto get_gl_context_info{reinterpret_cast<clGetGLContextInfoKHR_fn>(
+		clGetExtensionFunctionAddressForPlatform(platform, "clGetGLContextInfoKHR")
+	)};
+	if (get_gl_context_info == nullptr)
+		return nullptr;
+
+	cl_device_id device{nullptr};
+	cl_int error{get_gl_context_info(
+		properties.data(), CL_CURRENT_DEVICE_FOR_GL_CONTEXT_KHR,
+		sizeof(device), &device, nullptr
+	)};
+	return error == CL_SUCCESS ? device : nullptr;
+}
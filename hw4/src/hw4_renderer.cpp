@@ -0,0 +1,465 @@
+#include "hw4_renderer.hpp"
+#include "gl_sharing.hpp"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#define STBI_ONLY_PNG
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <giomm/resource.h>
+
+#include <iostream>
+
+using CLContext = cl::Context;
+
+using Gio::Resource;
+using cl::Device;
+using cl::Platform;
+using glm::mat4;
+using glm::vec3;
+using std::make_unique;
+using std::string;
+using std::to_string;
+using std::uniform_real_distribution;
+
+/* Names of the uniforms, hashed at compile time */
+namespace uniforms {
+	static constexpr Program::name
+		skybox{"skybox"},
+		color_power{"color_power"},
+		reflect_power{"reflect_power"},
+		refract_power{"refract_power"},
+		refract_index{"refract_index"},
+		mode{"mode"},
+		size{"size"};
+}
+
+Hw4Renderer::Hw4Renderer(unsigned seed):
+	random(seed)
+{
+}
+
+void Hw4Renderer::set_spheres_count(size_t count) {
+	size_t old_size{gl.spheres.size()};
+	gl.spheres.resize(count);
+	for (size_t i{old_size}; i < count; ++i) {
+		uniform_real_distribution<double> dist(-1, 1);
+		gl.spheres[i].power  = dist(random) * .02 + .09;
+		gl.spheres[i].speed  = dist(random) * 8 + 15;
+		gl.spheres[i].radius = dist(random) * .1 + .5;
+	}
+	geometry_changed();
+}
+
+void Hw4Renderer::geometry_changed() {
+	gl.marching_outdated = true;
+}
+
+MarchingCpu const &Hw4Renderer::get_marching_cpu() const {
+	return marching_cpu;
+}
+
+bool Hw4Renderer::has_opencl() const {
+	return cl.marching != nullptr;
+}
+
+bool Hw4Renderer::gl_init(GdkDisplay *display, std::function<void()> marching_ready, string &error) {
+	std::cout << "OpenGL:\n";
+	std::cout
+		<< "  Renderer: " << glGetString(GL_VENDOR) << " " << glGetString(GL_RENDERER)
+		<< " (version " << glGetString(GL_VERSION) << ")\n";
+	std::cout << std::flush;
+
+	auto load_resource{[](string const &path) {
+		struct res {
+			union {
+				const char *data;
+				const unsigned char *udata;
+			};
+			gsize size;
+		} result;
+
+		auto resource_bytes{Resource::lookup_data_global(path)};
+		result.data = static_cast<char const *>(resource_bytes->get_data(result.size));
+		return result;
+	}};
+
+	auto load_mesh{[&load_resource](string const &path) -> ::Object::binary_view {
+		auto resource{load_resource(path)};
+		return ::Object::view_binary(resource.data, resource.size);
+	}};
+
+	/* shaders */ {
+		string error_string;
+		auto create_program{
+			[&error_string, &load_resource](string const &name) -> std::unique_ptr<Program> {
+				string vertex(load_resource("/net/ldvsoft/spbau/gl/" + name + "_vertex.glsl").data);
+				string fragment(load_resource("/net/ldvsoft/spbau/gl/" + name + "_fragment.glsl").data);
+				return Program::build_program(
+					{{GL_VERTEX_SHADER, vertex}, {GL_FRAGMENT_SHADER, fragment}},
+					error_string
+				);
+			}
+		};
+
+		if ((gl.marching_program = create_program("marching")) == nullptr) {
+			error = "Program Marching cubes: " + error_string;
+			return false;
+		}
+		if ((gl.spheres_program = create_program("spheres")) == nullptr) {
+			error = "Program Marching cubes: " + error_string;
+			return false;
+		}
+		if ((gl.skybox_program = create_program("skybox")) == nullptr) {
+			error = "Program Marching cubes: " + error_string;
+			return false;
+		}
+	}
+
+	gl.blocks.gl_init();
+
+	/* framebuffer */ {
+		glGenFramebuffers(1, &gl.framebuffer);
+	}
+
+	/* sphere */ {
+		gl.sphere = make_unique<SceneObject>(load_mesh("/net/ldvsoft/spbau/gl/sphere.mesh"));
+	}
+
+	/* cube */ {
+		auto const cube{load_mesh("/net/ldvsoft/spbau/gl/cube.mesh")};
+		gl.cube = make_unique<SceneObject>(cube);
+		gl.cube->position = glm::scale(glm::vec3(view_range, view_range, view_range));
+		gl.skybox = make_unique<SceneObject>(cube);
+		gl.plane = make_unique<SceneObject>(load_mesh("/net/ldvsoft/spbau/gl/plane.mesh"));
+	}
+
+	/* skybox */ {
+		glGenTextures(1, &gl.skybox_texture);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, gl.skybox_texture);
+		for (int i{0}; i < 6; ++i) {
+			int w{}, h{}, n{};
+			auto img{load_resource("/net/ldvsoft/spbau/gl/skybox-" + to_string(i) + ".png")};
+			stbi_uc *data = stbi_load_from_memory(img.udata, img.size, &w, &h, &n, 3);
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
+				GL_RGB, w, h,
+				0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			stbi_image_free(data);
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	}
+
+	/* marching: geometry */ try {
+		bool has_context{false};
+		/* context */ try {
+			Platform platform = Platform::getDefault();
+
+			std::vector<Device> devices;
+			platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+			cl.device = devices[0];
+
+			/* share buffers with the GL context if we can, copy through the host otherwise */ {
+				auto properties{gl_sharing_properties(platform(), display)};
+				cl_device_id gl_device{gl_sharing_device(platform(), properties)};
+				cl.gl_sharing = false;
+				if (gl_device != nullptr) try {
+					cl.context = CLContext(Device(gl_device, true), properties.data(), nullptr, nullptr);
+					cl.device = Device(gl_device, true);
+					cl.gl_sharing = true;
+				} catch (cl::Error const &e) {
+					std::cout << "OpenCL: GL sharing failed (" << e.what() << ": " << e.err() << ")\n";
+				}
+				if (!cl.gl_sharing)
+					cl.context = CLContext(cl.device, nullptr, nullptr, nullptr);
+			}
+
+			std::cout << "OpenCL:\n";
+			std::cout
+				<< "  Platform: " << platform.getInfo<CL_PLATFORM_NAME>()
+				<< " (version " << platform.getInfo<CL_PLATFORM_VERSION>() << ")\n";
+			std::cout
+				<< "  Device  : " << cl.device.getInfo<CL_DEVICE_VENDOR>() << " " << cl.device.getInfo<CL_DEVICE_NAME>()
+				<< " (version " << cl.device.getInfo<CL_DEVICE_VERSION>() << ")\n";
+			std::cout
+				<< "  GL sharing: " << (cl.gl_sharing ? "yes" : "no, copying through the host") << "\n";
+			std::cout << std::flush;
+			has_context = true;
+		} catch (cl::Error const &e) {
+			std::cout << "OpenCL: not available (" << e.what() << ": " << e.err() << "), using CPU backend" << std::endl;
+		}
+
+		/* marching geometry */ if (has_context) {
+			string kernel(load_resource("/net/ldvsoft/spbau/gl/marching_geometry.cl").data);
+			cl::Program program(cl.context, kernel);
+			try {
+				program.build();
+			} catch (cl::Error const &e) {
+				error = "OpenCL build: " + program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(cl.device);
+				return false;
+			}
+
+			cl.marching = make_unique<MarchingCl>(cl.context, cl.device, program, cl.gl_sharing);
+		}
+	} catch (cl::Error const &e) {
+		error = string("OpenCL: ") + e.what() + ": " + to_string(e.err());
+		return false;
+	}
+
+	marching_worker = make_unique<MarchingWorker>(marching_cpu, cl.marching.get(), std::move(marching_ready));
+	return true;
+}
+
+void Hw4Renderer::gl_finit() {
+	profiler.gl_finit();
+	glDeleteFramebuffers(1, &gl.framebuffer);
+	gl.skybox = nullptr;
+	gl.marching_mesh = nullptr;
+	gl.marching_outdated = true;
+	marching_worker = nullptr;
+	gl.mesh = nullptr;
+	cl.marching = nullptr;
+	gl.cube = nullptr;
+	gl.sphere = nullptr;
+	gl.spheres_program = nullptr;
+	gl.marching_program = nullptr;
+	gl.blocks.gl_finit();
+}
+
+bool Hw4Renderer::gl_render(int width, int height, string &error) {
+	profiler.begin_frame();
+	gl.blocks.begin_frame();
+	GLint old_buffer, old_vp[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_buffer);
+	glGetIntegerv(GL_VIEWPORT, old_vp);
+
+	/* animate */ {
+		for (auto &sphere: gl.spheres) {
+			double angle(fmod(progress * sphere.speed, 2 * M_PI));
+			double a{cos(angle) * M_PI / 6};
+			double b{angle * 3};
+			sphere.position = vec3(
+				sphere.radius * cos(a) * sin(b),
+				sphere.radius * sin(a),
+				sphere.radius * cos(a) * cos(b)
+			);
+		}
+	}
+
+	mat4 cam_proj{glm::perspective(
+		/* vertical fov = */ glm::radians(fov),
+		/* ratio        = */ static_cast<float>(width) / height,
+		/* planes       : */ .005f, 100.0f
+	)};
+	gl.blocks.set_camera(camera_view, cam_proj);
+
+	glClearColor(0, 0, 0, 1);
+
+	/* buffer */ if(false) {
+		glBindFramebuffer(GL_FRAMEBUFFER, gl.framebuffer);
+		glViewport(0, 0, width, height);
+
+		/* buffers */ {
+			constexpr size_t cnt{0};
+			GLenum buffers[cnt]{};
+			glDrawBuffers(cnt, buffers);
+		}
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			error = "Failed to create framebuffer.";
+			return false;
+		}
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+		glViewport(old_vp[0], old_vp[1], old_vp[2], old_vp[3]);
+	}
+
+	static constexpr bool useDebug{false};
+	GLuint tmp, out;
+	if (useDebug) {
+		glGenTextures(1, &out);
+		glBindTexture(GL_TEXTURE_2D, out);
+		glTexImage2D(
+			GL_TEXTURE_2D, 0,
+			GL_RGB16F, width, height,
+			0, GL_RGB, GL_FLOAT, nullptr
+		);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &tmp);
+		glBindFramebuffer(GL_FRAMEBUFFER, tmp);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, out, 0);
+		{
+			constexpr size_t cnt{1};
+			constexpr GLenum buffers[cnt]{GL_COLOR_ATTACHMENT0};
+			glDrawBuffers(cnt, buffers);
+		}
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			error = "TMP";
+			return false;
+		}
+	}
+
+	bool ok{true};
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	switch (display_mode) {
+	case MARCHING_CUBES: {
+		GpuProfiler::pass pass(profiler, "marching");
+		ok = gl_render_marching(error);
+		break;
+	}
+	case SPHERES: {
+		GpuProfiler::pass pass(profiler, "spheres");
+		gl_render_spheres(false);
+		break;
+	}
+	case SPHERES_WITH_CUBE: {
+		GpuProfiler::pass pass(profiler, "spheres");
+		gl_render_spheres(true);
+		break;
+	}
+	}
+	/* skybox */ {
+		GpuProfiler::pass pass(profiler, "skybox");
+		gl_render_skybox();
+	}
+
+	if (useDebug) {
+		glBindFramebuffer(GL_FRAMEBUFFER, old_buffer);
+		glDeleteTextures(1, &out);
+		glDeleteFramebuffers(1, &tmp);
+	}
+
+	profiler.end_frame();
+	glFlush();
+
+	return ok;
+}
+
+bool Hw4Renderer::gl_render_marching(string &error) {
+	if (marching_worker == nullptr)
+		return true;
+
+	/* request */ if (gl.marching_outdated) {
+		gl.marching_outdated = false;
+
+		marching_input input{
+			xresolution, yresolution, zresolution,
+			view_range,
+			threshold,
+			influence,
+			{}, {}
+		};
+		for (auto const &sphere: gl.spheres) {
+			input.a.push_back(sphere.power);
+			input.c.push_back(sphere.position);
+		}
+
+		if (wait_for_marching) {
+			/* a stale result would hold the request back */
+			marching_worker->wait();
+			marching_worker->consume([](MarchingWorker::result &) {});
+		}
+		marching_worker->request(std::move(input), marching_backend == MARCHING_OPENCL);
+		if (wait_for_marching)
+			marching_worker->wait();
+	}
+	/* Until the requested mesh is built, the previous one is drawn */
+	bool ok{true};
+	marching_worker->consume([this, &ok, &error](MarchingWorker::result &built) {
+		gl.marching_mesh = nullptr;
+		profiler.add_sample("Worker", built.cl ? "build (OpenCL)" : "build (CPU)", built.started, built.finished);
+		if (!built.error.empty()) {
+			error = built.error;
+			ok = false;
+			return;
+		}
+		try {
+			if (built.cl) {
+				gl.mesh = nullptr;
+				gl.marching_mesh = cl.marching->publish();
+				for (auto const &command: cl.marching->get_timings())
+					profiler.add_sample("OpenCL", command.name, command.start, command.end);
+			} else {
+				gl.mesh = built.object->verticies.empty() ? nullptr : make_unique<SceneObject>(*built.object);
+				gl.marching_mesh = gl.mesh.get();
+			}
+		} catch (cl::Error const &e) {
+			error = string("OpenCL: ") + e.what() + ": " + to_string(e.err());
+			ok = false;
+		}
+	});
+	if (gl.marching_mesh == nullptr)
+		return ok;
+
+	/* rrrender */ {
+		gl.marching_program->use();
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, gl.skybox_texture);
+
+		glUniform1i(gl.marching_program->get_uniform(uniforms::skybox), 0);
+		glUniform1f(gl.marching_program->get_uniform(uniforms::color_power), color_power);
+		glUniform1f(gl.marching_program->get_uniform(uniforms::reflect_power), reflect_power);
+		glUniform1f(gl.marching_program->get_uniform(uniforms::refract_power), refract_power);
+		glUniform1f(gl.marching_program->get_uniform(uniforms::refract_index), refract_index);
+		gl_draw_object(*gl.marching_mesh, *gl.marching_program);
+		gl_draw_object(*gl.plane, *gl.marching_program);
+
+		glUseProgram(0);
+	}
+	return ok;
+}
+
+void Hw4Renderer::gl_render_spheres(bool box) {
+	gl.spheres_program->use();
+
+	glUniform1i(gl.spheres_program->get_uniform(uniforms::mode), 0);
+	gl.sphere_instances.clear();
+	for (auto const &sphere: gl.spheres) {
+		double rad{sqrt(threshold / sphere.power)};
+		gl.sphere_instances.push_back({glm::vec4(sphere.position, 1 / rad), glm::vec4(1, 1, 1, sphere.power)});
+	}
+	gl.sphere->set_instances(gl.sphere_instances);
+	gl.sphere->draw_instanced(gl.blocks, *gl.spheres_program);
+
+	if (box) {
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+
+		glUniform1i(gl.spheres_program->get_uniform(uniforms::mode), 1);
+		gl_draw_object(*gl.cube, *gl.spheres_program);
+
+		glDisable(GL_CULL_FACE);
+	}
+
+	glUseProgram(0);
+}
+
+void Hw4Renderer::gl_render_skybox() {
+	gl.skybox_program->use();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, gl.skybox_texture);
+
+	glUniform1f(gl.skybox_program->get_uniform(uniforms::size), 10);
+	glUniform1i(gl.skybox_program->get_uniform(uniforms::skybox), 0);
+
+	gl.skybox->animation_position = glm::translate(camera_position);
+	gl_draw_object(*gl.skybox, *gl.skybox_program);
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	glUseProgram(0);
+}
+
+void Hw4Renderer::gl_draw_object(SceneObject const &object, Program const &program) {
+	object.draw(gl.blocks, program);
+}
@@ -1,10 +1,60 @@
+#include "headless.hpp"
 #include "hw4_app.hpp"
+#include "hw4_renderer.hpp"
 #include "object.hpp"
 
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <giomm/init.h>
+#include <giomm/resource.h>
+
 #include <iostream>
+#include <stdexcept>
 #include <iterator>
 #include <fstream>
 
+/* Renders the animation from the default camera into files, see headless.hpp.
+ * Settings: spheres (count, 1 by default), mode (Hw4Renderer::display_mode_t, marching cubes by default),
+ * backend (opencl or cpu), resolution (cubes along every axis, 20 by default), threshold (1 by default),
+ * influence (of a sphere, in its radii; 0, the default, is everywhere).
+ * Every frame waits for its own mesh.
+ */
+static int run_headless(headless_options const &options) {
+	Gio::init();
+	Gio::Resource::create_from_file("hw4.gresource")->register_global();
+	HeadlessContext context(options.width, options.height);
+	Hw4Renderer renderer(options.seed);
+	renderer.set_spheres_count(options.setting<size_t>("spheres", 1));
+	renderer.display_mode = static_cast<Hw4Renderer::display_mode_t>(options.setting<int>("mode", Hw4Renderer::MARCHING_CUBES));
+	/* backend */ {
+		std::string const backend{options.setting<std::string>("backend", "opencl")};
+		if (backend != "opencl" && backend != "cpu")
+			throw std::invalid_argument("backend is opencl or cpu, not " + backend);
+		renderer.marching_backend = backend == "opencl" ? Hw4Renderer::MARCHING_OPENCL : Hw4Renderer::MARCHING_CPU;
+	}
+	renderer.xresolution = renderer.yresolution = renderer.zresolution = options.setting<int>("resolution", 20);
+	renderer.threshold = options.setting<float>("threshold", 1);
+	renderer.influence = options.setting<float>("influence", 0);
+	renderer.wait_for_marching = true;
+	/* the initial camera of the window */
+	renderer.camera_position = glm::vec3(0, 0, renderer.view_range * (1 + 1 / tan((Hw4Renderer::fov * M_PI / 180) / 2)));
+	renderer.camera_view = glm::translate(-renderer.camera_position);
+
+	std::string error;
+	bool const ok{renderer.gl_init(nullptr, [] {}, error) && context.run(options, [&](float progress, std::string &error) {
+		renderer.progress = progress;
+		renderer.geometry_changed();
+		return renderer.gl_render(options.width, options.height, error);
+	}, error) && write_profile(renderer.profiler, options, error)};
+	renderer.gl_finit();
+	if (!ok) {
+		std::cerr << "ERROR: " << error << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
 int main(int argc, char **argv) {
 //	(void) argc;
 //	(void) argv;
@@ -16,6 +66,18 @@ int main(int argc, char **argv) {
 //		std::cout << obj << std::endl;
 //	}
 
+	try {
+		headless_options options;
+		if (parse_headless_options(argc, argv, options))
+			return run_headless(options);
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	} catch (Glib::Error &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
 	try {
 		auto app{Hw4App::create(argc, argv)};
 		app->run();
@@ -0,0 +1,295 @@
+#include "marching_cl.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using cl::Buffer;
+using cl::Kernel;
+using cl::NDRange;
+using cl::NullRange;
+using std::make_unique;
+
+MarchingCl::cached_kernel::cached_kernel(Kernel const &kernel):
+	kernel(kernel) {}
+
+void MarchingCl::cached_kernel::set_raw(cl_uint index, void const *value, size_t size) {
+	if (args.size() <= index)
+		args.resize(index + 1);
+	auto bytes{static_cast<unsigned char const *>(value)};
+	auto &cached{args[index]};
+	if (cached.size() == size && std::equal(bytes, bytes + size, cached.begin()))
+		return;
+	kernel.setArg(index, size, value);
+	cached.assign(bytes, bytes + size);
+}
+
+void MarchingCl::cached_kernel::set_arg(cl_uint index, Buffer const &buffer) {
+	cl_mem mem{buffer()};
+	set_raw(index, &mem, sizeof(mem));
+}
+
+MarchingCl::scan_level::scan_level(cl::Program const &program):
+	blocks(Kernel(program, "scan_blocks")),
+	add(Kernel(program, "scan_add")) {}
+
+MarchingCl::MarchingCl(
+	cl::Context const &context,
+	cl::Device const &device,
+	cl::Program const &program,
+	bool gl_sharing
+):
+	context(context),
+	device(device),
+	program(program),
+	queue(context, device, CL_QUEUE_PROFILING_ENABLE),
+	gl_sharing(gl_sharing),
+	fill_values(Kernel(program, "fill_values")),
+	find_edges(Kernel(program, "find_edges")),
+	number_edges(Kernel(program, "number_edges")),
+	put_vertices(Kernel(program, "put_vertices")),
+	count_triangles(Kernel(program, "count_triangles")),
+	build_mesh(Kernel(program, "build_mesh"))
+{
+	size_t max_group_size{Kernel(program, "scan_blocks").getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device)};
+	scan_group_size = 2;
+	while (scan_group_size * 2 <= std::min<size_t>(max_group_size, 256))
+		scan_group_size *= 2;
+
+	/* [0]: verticies count, [1]: triangles count */
+	reserve(counts, CL_MEM_READ_WRITE, 2 * sizeof(cl_int));
+}
+
+MarchingCl::~MarchingCl() {
+	queue.finish();
+}
+
+cl::Event *MarchingCl::timed(char const *name) {
+	events.emplace_back(name, cl::Event());
+	return &events.back().second;
+}
+
+void MarchingCl::collect_timings() {
+	if (!device_calibrated && !events.empty()) {
+		/* the queue has just been waited for, so its last command ended about now */
+		int64_t const now{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()};
+		device_offset = now - static_cast<int64_t>(events.back().second.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+		device_calibrated = true;
+	}
+	for (auto const &e: events)
+		timings.push_back({
+			e.first,
+			e.second.getProfilingInfo<CL_PROFILING_COMMAND_START>() + device_offset,
+			e.second.getProfilingInfo<CL_PROFILING_COMMAND_END>() + device_offset
+		});
+	events.clear();
+}
+
+void MarchingCl::reserve(device_buffer &target, cl_mem_flags flags, size_t size) {
+	if (size <= target.size)
+		return;
+	target.size = std::max(size, target.size + target.size / 2);
+	target.buffer = Buffer(context, flags, target.size);
+}
+
+void MarchingCl::exclusive_scan(
+	std::vector<scan_level> &levels, size_t level,
+	Buffer const &data, Buffer const &result, cl_int count,
+	size_t total_offset
+) {
+	if (levels.size() == level) {
+		levels.emplace_back(program);
+		levels.back().blocks.kernel.setArg(4, cl::Local(sizeof(cl_int) * scan_group_size));
+	}
+
+	cl_int const groups((count + scan_group_size - 1) / scan_group_size);
+	/* levels may be reallocated by the recursion below, so no references are kept */
+	reserve(levels[level].sums, CL_MEM_READ_WRITE, sizeof(cl_int) * groups);
+
+	auto &blocks{levels[level].blocks};
+	blocks.set_arg(0, count);
+	blocks.set_arg(1, data);
+	blocks.set_arg(2, result);
+	blocks.set_arg(3, levels[level].sums.buffer);
+	queue.enqueueNDRangeKernel(blocks.kernel, NullRange, NDRange(groups * scan_group_size), NDRange(scan_group_size), nullptr, timed("scan_blocks"));
+
+	if (groups == 1) {
+		queue.enqueueCopyBuffer(levels[level].sums.buffer, counts.buffer, 0, total_offset, sizeof(cl_int), nullptr, timed("scan total"));
+		return;
+	}
+
+	reserve(levels[level].offsets, CL_MEM_READ_WRITE, sizeof(cl_int) * groups);
+	Buffer const sums{levels[level].sums.buffer}, offsets{levels[level].offsets.buffer};
+	exclusive_scan(levels, level + 1, sums, offsets, groups, total_offset);
+
+	auto &add{levels[level].add};
+	add.set_arg(0, count);
+	add.set_arg(1, offsets);
+	add.set_arg(2, result);
+	queue.enqueueNDRangeKernel(add.kernel, NullRange, NDRange(groups * scan_group_size), NDRange(scan_group_size), nullptr, timed("scan_add"));
+}
+
+void MarchingCl::compute(marching_input const &input) {
+	/* events of a failed run are dropped too */
+	events.clear();
+	timings.clear();
+
+	cl_int const
+		n{input.n},
+		m{input.m},
+		k{input.k};
+	cl_int const
+		vertices{(n + 1) * (m + 1) * (k + 1)},
+		edges{vertices * 3},
+		cubes{n * m * k};
+
+	bricks.build(input);
+	cl_int const
+		bricks_count{bricks.get_bricks()},
+		entries(bricks.a.size());
+
+	reserve(brick_offsets, CL_MEM_READ_ONLY, sizeof(cl_int) * (bricks_count + 1));
+	reserve(a, CL_MEM_READ_ONLY, sizeof(cl_float) * std::max(entries, 1));
+	reserve(c, CL_MEM_READ_ONLY, sizeof(cl_float4) * std::max(entries, 1));
+	reserve(values, CL_MEM_READ_WRITE, sizeof(cl_float) * vertices);
+	reserve(edge_used, CL_MEM_READ_WRITE, sizeof(cl_int) * edges);
+	reserve(vertex_ids, CL_MEM_READ_WRITE, sizeof(cl_int) * edges);
+	reserve(triangle_counts, CL_MEM_READ_WRITE, sizeof(cl_int) * cubes);
+	reserve(triangle_offsets, CL_MEM_READ_WRITE, sizeof(cl_int) * cubes);
+
+	/* fill data */ {
+		static_assert(sizeof(glm::vec4) == sizeof(cl_float4), "bricks keep spheres as float4");
+		queue.enqueueWriteBuffer(brick_offsets.buffer, false, 0, sizeof(cl_int) * (bricks_count + 1), bricks.offsets.data(), nullptr, timed("write bricks"));
+		if (entries != 0) {
+			queue.enqueueWriteBuffer(a.buffer, false, 0, sizeof(cl_float) * entries, bricks.a.data(), nullptr, timed("write bricks"));
+			queue.enqueueWriteBuffer(c.buffer, false, 0, sizeof(cl_float4) * entries, bricks.c.data(), nullptr, timed("write bricks"));
+		}
+	}
+
+	fill_values.set_arg(0, n);
+	fill_values.set_arg(1, m);
+	fill_values.set_arg(2, k);
+	fill_values.set_arg(3, input.zone);
+	fill_values.set_arg(4, bricks.size);
+	fill_values.set_arg(5, bricks.nx);
+	fill_values.set_arg(6, bricks.ny);
+	fill_values.set_arg(7, brick_offsets.buffer);
+	fill_values.set_arg(8, a.buffer);
+	fill_values.set_arg(9, c.buffer);
+	fill_values.set_arg(10, input.threshold);
+	fill_values.set_arg(11, values.buffer);
+	queue.enqueueNDRangeKernel(fill_values.kernel, NullRange, NDRange(n + 1, m + 1, k + 1), NullRange, nullptr, timed("fill_values"));
+
+	find_edges.set_arg(0, n);
+	find_edges.set_arg(1, m);
+	find_edges.set_arg(2, k);
+	find_edges.set_arg(3, values.buffer);
+	find_edges.set_arg(4, edge_used.buffer);
+	queue.enqueueNDRangeKernel(find_edges.kernel, NullRange, NDRange(n + 1, m + 1, k + 1), NullRange, nullptr, timed("find_edges"));
+
+	/* Vertex ids are the exclusive scan of edge_used, so they go in the (z, y, x, axis) order */
+	exclusive_scan(edges_scan, 0, edge_used.buffer, vertex_ids.buffer, edges, 0);
+
+	number_edges.set_arg(0, edges);
+	number_edges.set_arg(1, edge_used.buffer);
+	number_edges.set_arg(2, vertex_ids.buffer);
+	queue.enqueueNDRangeKernel(number_edges.kernel, NullRange, NDRange(edges), NullRange, nullptr, timed("number_edges"));
+
+	count_triangles.set_arg(0, n);
+	count_triangles.set_arg(1, m);
+	count_triangles.set_arg(2, k);
+	count_triangles.set_arg(3, values.buffer);
+	count_triangles.set_arg(4, triangle_counts.buffer);
+	queue.enqueueNDRangeKernel(count_triangles.kernel, NullRange, NDRange(n, m, k), NullRange, nullptr, timed("count_triangles"));
+
+	exclusive_scan(triangles_scan, 0, triangle_counts.buffer, triangle_offsets.buffer, cubes, sizeof(cl_int));
+
+	cl_int totals[2];
+	queue.enqueueReadBuffer(counts.buffer, true, 0, sizeof(totals), totals, nullptr, timed("read counts"));
+	vertex_count = totals[0];
+	triangle_count = totals[1];
+	if (vertex_count == 0 || triangle_count == 0) {
+		/* the read above waited for everything */
+		collect_timings();
+		return;
+	}
+
+	reserve(verticies, CL_MEM_READ_WRITE, sizeof(Object::vertex_data) * vertex_count);
+	reserve(triangles, CL_MEM_READ_WRITE, sizeof(Object::face) * triangle_count);
+
+	put_vertices.set_arg(0, n);
+	put_vertices.set_arg(1, m);
+	put_vertices.set_arg(2, k);
+	put_vertices.set_arg(3, input.zone);
+	put_vertices.set_arg(4, bricks.size);
+	put_vertices.set_arg(5, bricks.nx);
+	put_vertices.set_arg(6, bricks.ny);
+	put_vertices.set_arg(7, brick_offsets.buffer);
+	put_vertices.set_arg(8, a.buffer);
+	put_vertices.set_arg(9, c.buffer);
+	put_vertices.set_arg(10, values.buffer);
+	put_vertices.set_arg(11, vertex_ids.buffer);
+	put_vertices.set_arg(12, verticies.buffer);
+	queue.enqueueNDRangeKernel(put_vertices.kernel, NullRange, NDRange(n + 1, m + 1, k + 1), NullRange, nullptr, timed("put_vertices"));
+
+	build_mesh.set_arg(0, n);
+	build_mesh.set_arg(1, m);
+	build_mesh.set_arg(2, k);
+	build_mesh.set_arg(3, input.zone);
+	build_mesh.set_arg(4, values.buffer);
+	build_mesh.set_arg(5, vertex_ids.buffer);
+	build_mesh.set_arg(6, triangle_offsets.buffer);
+	build_mesh.set_arg(7, triangles.buffer);
+	queue.enqueueNDRangeKernel(build_mesh.kernel, NullRange, NDRange(n, m, k), NullRange, nullptr, timed("build_mesh"));
+
+	if (gl_sharing) {
+		queue.finish();
+	} else {
+		static_assert(sizeof(Object::vertex_data) == 9 * sizeof(cl_float), "put_vertices writes 9 floats per vertex");
+		static_assert(sizeof(Object::face) == 3 * sizeof(cl_int), "build_mesh writes 3 ints per face");
+		host_data.resize(vertex_count);
+		host_elems.resize(triangle_count);
+		queue.enqueueReadBuffer(verticies.buffer, false, 0, sizeof(Object::vertex_data) * vertex_count, host_data.data(), nullptr, timed("read mesh"));
+		queue.enqueueReadBuffer(triangles.buffer, false, 0, sizeof(Object::face) * triangle_count, host_elems.data(), nullptr, timed("read mesh"));
+		queue.finish();
+	}
+	collect_timings();
+}
+
+SceneObject const *MarchingCl::publish() {
+	if (vertex_count == 0 || triangle_count == 0)
+		return nullptr;
+
+	if (!gl_sharing) {
+		mesh = make_unique<SceneObject>(Object::manual(std::move(host_data), std::move(host_elems)));
+		host_data.clear();
+		host_elems.clear();
+		return mesh.get();
+	}
+
+	/* Device buffers are copied into the GL buffers of the mesh without leaving the device */
+	if (mesh == nullptr || vertex_count > mesh_verticies_capacity || triangle_count > mesh_faces_capacity) {
+		shared_objects.clear();
+		shared_verticies = cl::BufferGL();
+		shared_triangles = cl::BufferGL();
+		mesh_verticies_capacity = std::max(vertex_count, mesh_verticies_capacity + mesh_verticies_capacity / 2);
+		mesh_faces_capacity = std::max(triangle_count, mesh_faces_capacity + mesh_faces_capacity / 2);
+		mesh = make_unique<SceneObject>(mesh_verticies_capacity, mesh_faces_capacity);
+		shared_verticies = cl::BufferGL(context, CL_MEM_WRITE_ONLY, mesh->get_data_buffer());
+		shared_triangles = cl::BufferGL(context, CL_MEM_WRITE_ONLY, mesh->get_elems_buffer());
+		shared_objects = {shared_verticies, shared_triangles};
+	}
+	mesh->set_elems_count(triangle_count);
+
+	glFinish();
+	queue.enqueueAcquireGLObjects(&shared_objects, nullptr, timed("acquire GL"));
+	queue.enqueueCopyBuffer(verticies.buffer, shared_verticies, 0, 0, sizeof(Object::vertex_data) * vertex_count, nullptr, timed("publish"));
+	queue.enqueueCopyBuffer(triangles.buffer, shared_triangles, 0, 0, sizeof(Object::face) * triangle_count, nullptr, timed("publish"));
+	queue.enqueueReleaseGLObjects(&shared_objects, nullptr, timed("release GL"));
+	queue.finish();
+	collect_timings();
+	return mesh.get();
+}
+
+std::vector<MarchingCl::command_time> const &MarchingCl::get_timings() const {
+	return timings;
+}
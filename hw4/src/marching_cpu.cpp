@@ -0,0 +1,455 @@
+#include "marching_cpu.hpp"
+#include "marching_geometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MARCHING_CPU_X86
+#endif
+
+using glm::ivec3;
+using glm::uvec3;
+using glm::vec3;
+using glm::vec4;
+using std::vector;
+
+/* Spheres of a brick in SoA layout, so that one sphere is broadcast over a block of points.
+ * A sphere adds nothing where the squared distance is not below its r2.
+ */
+struct marching_field {
+	int spheres;
+	float const *a, *cx, *cy, *cz, *r2;
+	float threshold;
+};
+
+/* Same expression as in fill_values and put_vertices. */
+static inline float grid_coord(int i, int size, float zone) {
+	return (2.0f * i / size - 1) * zone;
+}
+
+/* HERE AND BELOW:
+ * every kernel flavour sums the spheres in the same order with the same operations,
+ * so scalar, SSE and AVX2 results are bit-identical.
+ */
+
+static void field_row_scalar(marching_field const &f, float *values, int x, int end, int n, float zone, float y, float z) {
+	for (; x < end; ++x) {
+		float px{grid_coord(x, n, zone)};
+		float res{-f.threshold};
+		for (int i{0}; i < f.spheres; ++i) {
+			float dx{f.cx[i] - px}, dy{f.cy[i] - y}, dz{f.cz[i] - z};
+			float d2{dx * dx + dy * dy + dz * dz};
+			res += d2 < f.r2[i] ? f.a[i] / d2 : 0;
+		}
+		values[x] = res;
+	}
+}
+
+static void gradient_scalar(marching_field const &f, Object::vertex_data *verticies, int count) {
+	for (int v{0}; v < count; ++v) {
+		vec3 const p{verticies[v].pos};
+		float gx{0}, gy{0}, gz{0};
+		for (int i{0}; i < f.spheres; ++i) {
+			float dx{f.cx[i] - p.x}, dy{f.cy[i] - p.y}, dz{f.cz[i] - p.z};
+			float d2{dx * dx + dy * dy + dz * dz};
+			float s{d2 < f.r2[i] ? 2 * f.a[i] / (d2 * d2) : 0};
+			gx += s * dx;
+			gy += s * dy;
+			gz += s * dz;
+		}
+		float inv{1 / std::sqrt(gx * gx + gy * gy + gz * gz)};
+		verticies[v].norm = vec3(-gx * inv, -gy * inv, -gz * inv);
+	}
+}
+
+#ifdef MARCHING_CPU_X86
+__attribute__((target("sse2")))
+static void field_row_sse(marching_field const &f, float *values, int x, int end, int n, float zone, float y, float z) {
+	int const width{4};
+	__m128 const two{_mm_set1_ps(2)}, one{_mm_set1_ps(1)}, size{_mm_set1_ps(n)}, zone4{_mm_set1_ps(zone)};
+	__m128 const py{_mm_set1_ps(y)}, pz{_mm_set1_ps(z)};
+	for (; x + width <= end; x += width) {
+		__m128 xs{_mm_cvtepi32_ps(_mm_setr_epi32(x, x + 1, x + 2, x + 3))};
+		__m128 px{_mm_mul_ps(_mm_sub_ps(_mm_div_ps(_mm_mul_ps(two, xs), size), one), zone4)};
+		__m128 res{_mm_set1_ps(-f.threshold)};
+		for (int i{0}; i < f.spheres; ++i) {
+			__m128 dx{_mm_sub_ps(_mm_set1_ps(f.cx[i]), px)};
+			__m128 dy{_mm_sub_ps(_mm_set1_ps(f.cy[i]), py)};
+			__m128 dz{_mm_sub_ps(_mm_set1_ps(f.cz[i]), pz)};
+			__m128 d2{_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz))};
+			__m128 inside{_mm_cmplt_ps(d2, _mm_set1_ps(f.r2[i]))};
+			res = _mm_add_ps(res, _mm_and_ps(inside, _mm_div_ps(_mm_set1_ps(f.a[i]), d2)));
+		}
+		_mm_storeu_ps(values + x, res);
+	}
+	field_row_scalar(f, values, x, end, n, zone, y, z);
+}
+
+__attribute__((target("sse2")))
+static void gradient_sse(marching_field const &f, Object::vertex_data *verticies, int count) {
+	int const width{4};
+	int v{0};
+	for (; v + width <= count; v += width) {
+		__m128 px{_mm_setr_ps(verticies[v].pos.x, verticies[v + 1].pos.x, verticies[v + 2].pos.x, verticies[v + 3].pos.x)};
+		__m128 py{_mm_setr_ps(verticies[v].pos.y, verticies[v + 1].pos.y, verticies[v + 2].pos.y, verticies[v + 3].pos.y)};
+		__m128 pz{_mm_setr_ps(verticies[v].pos.z, verticies[v + 1].pos.z, verticies[v + 2].pos.z, verticies[v + 3].pos.z)};
+		__m128 gx{_mm_setzero_ps()}, gy{_mm_setzero_ps()}, gz{_mm_setzero_ps()};
+		for (int i{0}; i < f.spheres; ++i) {
+			__m128 dx{_mm_sub_ps(_mm_set1_ps(f.cx[i]), px)};
+			__m128 dy{_mm_sub_ps(_mm_set1_ps(f.cy[i]), py)};
+			__m128 dz{_mm_sub_ps(_mm_set1_ps(f.cz[i]), pz)};
+			__m128 d2{_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz))};
+			__m128 inside{_mm_cmplt_ps(d2, _mm_set1_ps(f.r2[i]))};
+			__m128 s{_mm_and_ps(inside, _mm_div_ps(_mm_set1_ps(2 * f.a[i]), _mm_mul_ps(d2, d2)))};
+			gx = _mm_add_ps(gx, _mm_mul_ps(s, dx));
+			gy = _mm_add_ps(gy, _mm_mul_ps(s, dy));
+			gz = _mm_add_ps(gz, _mm_mul_ps(s, dz));
+		}
+		__m128 len2{_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), _mm_mul_ps(gz, gz))};
+		__m128 inv{_mm_div_ps(_mm_set1_ps(-1), _mm_sqrt_ps(len2))};
+		alignas(16) float nx[width], ny[width], nz[width];
+		_mm_store_ps(nx, _mm_mul_ps(gx, inv));
+		_mm_store_ps(ny, _mm_mul_ps(gy, inv));
+		_mm_store_ps(nz, _mm_mul_ps(gz, inv));
+		for (int j{0}; j < width; ++j)
+			verticies[v + j].norm = vec3(nx[j], ny[j], nz[j]);
+	}
+	gradient_scalar(f, verticies + v, count - v);
+}
+
+__attribute__((target("avx2")))
+static void field_row_avx2(marching_field const &f, float *values, int x, int end, int n, float zone, float y, float z) {
+	int const width{8};
+	__m256 const two{_mm256_set1_ps(2)}, one{_mm256_set1_ps(1)}, size{_mm256_set1_ps(n)}, zone8{_mm256_set1_ps(zone)};
+	__m256 const py{_mm256_set1_ps(y)}, pz{_mm256_set1_ps(z)};
+	__m256i const lanes{_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)};
+	for (; x + width <= end; x += width) {
+		__m256 xs{_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), lanes))};
+		__m256 px{_mm256_mul_ps(_mm256_sub_ps(_mm256_div_ps(_mm256_mul_ps(two, xs), size), one), zone8)};
+		__m256 res{_mm256_set1_ps(-f.threshold)};
+		for (int i{0}; i < f.spheres; ++i) {
+			__m256 dx{_mm256_sub_ps(_mm256_set1_ps(f.cx[i]), px)};
+			__m256 dy{_mm256_sub_ps(_mm256_set1_ps(f.cy[i]), py)};
+			__m256 dz{_mm256_sub_ps(_mm256_set1_ps(f.cz[i]), pz)};
+			__m256 d2{_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz))};
+			__m256 inside{_mm256_cmp_ps(d2, _mm256_set1_ps(f.r2[i]), _CMP_LT_OQ)};
+			res = _mm256_add_ps(res, _mm256_and_ps(inside, _mm256_div_ps(_mm256_set1_ps(f.a[i]), d2)));
+		}
+		_mm256_storeu_ps(values + x, res);
+	}
+	field_row_sse(f, values, x, end, n, zone, y, z);
+}
+
+__attribute__((target("avx2")))
+static void gradient_avx2(marching_field const &f, Object::vertex_data *verticies, int count) {
+	int const width{8};
+	/* vertex_data is 9 floats, gather pos.x/y/z of 8 verticies at once */
+	int const stride{sizeof(Object::vertex_data) / sizeof(float)};
+	__m256i const offsets{_mm256_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride)};
+	int v{0};
+	for (; v + width <= count; v += width) {
+		float const *base{&verticies[v].pos.x};
+		__m256 px{_mm256_i32gather_ps(base + 0, offsets, 4)};
+		__m256 py{_mm256_i32gather_ps(base + 1, offsets, 4)};
+		__m256 pz{_mm256_i32gather_ps(base + 2, offsets, 4)};
+		__m256 gx{_mm256_setzero_ps()}, gy{_mm256_setzero_ps()}, gz{_mm256_setzero_ps()};
+		for (int i{0}; i < f.spheres; ++i) {
+			__m256 dx{_mm256_sub_ps(_mm256_set1_ps(f.cx[i]), px)};
+			__m256 dy{_mm256_sub_ps(_mm256_set1_ps(f.cy[i]), py)};
+			__m256 dz{_mm256_sub_ps(_mm256_set1_ps(f.cz[i]), pz)};
+			__m256 d2{_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz))};
+			__m256 inside{_mm256_cmp_ps(d2, _mm256_set1_ps(f.r2[i]), _CMP_LT_OQ)};
+			__m256 s{_mm256_and_ps(inside, _mm256_div_ps(_mm256_set1_ps(2 * f.a[i]), _mm256_mul_ps(d2, d2)))};
+			gx = _mm256_add_ps(gx, _mm256_mul_ps(s, dx));
+			gy = _mm256_add_ps(gy, _mm256_mul_ps(s, dy));
+			gz = _mm256_add_ps(gz, _mm256_mul_ps(s, dz));
+		}
+		__m256 len2{_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy)), _mm256_mul_ps(gz, gz))};
+		__m256 inv{_mm256_div_ps(_mm256_set1_ps(-1), _mm256_sqrt_ps(len2))};
+		alignas(32) float nx[width], ny[width], nz[width];
+		_mm256_store_ps(nx, _mm256_mul_ps(gx, inv));
+		_mm256_store_ps(ny, _mm256_mul_ps(gy, inv));
+		_mm256_store_ps(nz, _mm256_mul_ps(gz, inv));
+		for (int j{0}; j < width; ++j)
+			verticies[v + j].norm = vec3(nx[j], ny[j], nz[j]);
+	}
+	gradient_sse(f, verticies + v, count - v);
+}
+#endif
+
+struct MarchingCpu::kernels {
+	char const *name;
+	void (*field_row)(marching_field const &f, float *values, int x, int end, int n, float zone, float y, float z);
+	void (*gradient)(marching_field const &f, Object::vertex_data *verticies, int count);
+};
+
+static MarchingCpu::kernels const &select_kernels() {
+	static MarchingCpu::kernels constexpr scalar{"scalar", field_row_scalar, gradient_scalar};
+#ifdef MARCHING_CPU_X86
+	static MarchingCpu::kernels constexpr sse{"SSE2", field_row_sse, gradient_sse};
+	static MarchingCpu::kernels constexpr avx2{"AVX2", field_row_avx2, gradient_avx2};
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return sse;
+#endif
+	return scalar;
+}
+
+/* Splits [0, count) into contiguous chunks, one per thread, calls f(chunk, begin, end). Returns chunks count. */
+template<typename F>
+static int parallel_for(unsigned threads, int count, F const &f) {
+	int const chunks{std::max(1, std::min<int>(threads, count))};
+	auto chunk_begin{[count, chunks](int chunk) { return static_cast<int>(static_cast<long long>(count) * chunk / chunks); }};
+
+	vector<std::thread> workers;
+	workers.reserve(chunks - 1);
+	for (int chunk{1}; chunk < chunks; ++chunk)
+		workers.emplace_back(f, chunk, chunk_begin(chunk), chunk_begin(chunk + 1));
+	f(0, chunk_begin(0), chunk_begin(1));
+	for (auto &worker: workers)
+		worker.join();
+	return chunks;
+}
+
+/* Turns per-chunk counts into per-chunk starting offsets, returns the total. */
+static int exclusive_scan(vector<int> &counts, int chunks) {
+	int total{0};
+	for (int i{0}; i < chunks; ++i) {
+		int count{counts[i]};
+		counts[i] = total;
+		total += count;
+	}
+	return total;
+}
+
+/* Cubes [first, last] along an axis of size cubes that may hold points of [lo, hi], false if there are none.
+ * The range is widened by a cube so that it also covers edges starting before lo.
+ */
+static bool cube_range(float lo, float hi, int size, float zone, int &first, int &last) {
+	float const from{std::floor((lo / zone + 1) * size / 2) - 1}, to{std::ceil((hi / zone + 1) * size / 2) + 1};
+	if (to < 0 || from > size - 1)
+		return false;
+	first = static_cast<int>(std::max(from, 0.0f));
+	last = static_cast<int>(std::min(to, size - 1.0f));
+	return true;
+}
+
+void marching_bricks::build(marching_input const &input) {
+	bool const sparse{input.influence > 0};
+	n = input.n;
+	m = input.m;
+	k = input.k;
+	size = sparse ? 8 : std::max({n, m, k});
+	nx = (n + size - 1) / size;
+	ny = (m + size - 1) / size;
+	nz = (k + size - 1) / size;
+
+	/* counting sort of (brick, sphere) pairs, spheres keep their order inside a brick */
+	int const spheres(input.a.size());
+	vector<ivec3> first(spheres), last(spheres, ivec3(-1));
+	offsets.assign(get_bricks() + 1, 0);
+	auto for_bricks{[this, &first, &last](int sphere, auto const &f) {
+		for (int z{first[sphere].z / size}; z <= last[sphere].z / size; ++z)
+			for (int y{first[sphere].y / size}; y <= last[sphere].y / size; ++y)
+				for (int x{first[sphere].x / size}; x <= last[sphere].x / size; ++x)
+					f((z * ny + y) * nx + x);
+	}};
+	for (int i{0}; i < spheres; ++i) {
+		float const r{sparse ? input.influence * std::sqrt(input.a[i] / input.threshold) : INFINITY};
+		vec3 const lo{input.c[i] - r}, hi{input.c[i] + r};
+		bool const touches{
+			cube_range(lo.x, hi.x, n, input.zone, first[i].x, last[i].x) &&
+			cube_range(lo.y, hi.y, m, input.zone, first[i].y, last[i].y) &&
+			cube_range(lo.z, hi.z, k, input.zone, first[i].z, last[i].z)
+		};
+		if (!touches)
+			last[i] = ivec3(-1);
+		else
+			for_bricks(i, [this](int brick) { ++offsets[brick + 1]; });
+	}
+	for (int brick{0}; brick < get_bricks(); ++brick)
+		offsets[brick + 1] += offsets[brick];
+
+	a.resize(offsets.back());
+	c.resize(offsets.back());
+	vector<int> next(offsets.begin(), offsets.end() - 1);
+	for (int i{0}; i < spheres; ++i) {
+		float const r2{sparse ? input.influence * input.influence * input.a[i] / input.threshold : INFINITY};
+		for_bricks(i, [&, this](int brick) {
+			a[next[brick]] = input.a[i];
+			c[next[brick]] = vec4(input.c[i], r2);
+			++next[brick];
+		});
+	}
+}
+
+MarchingCpu::MarchingCpu(unsigned threads):
+	threads(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+	simd(&select_kernels()),
+	chunk_counts(this->threads)
+{}
+
+unsigned MarchingCpu::get_threads() const {
+	return threads;
+}
+
+char const *MarchingCpu::get_simd_name() const {
+	return simd->name;
+}
+
+Object MarchingCpu::build(marching_input const &input) {
+	int const n{input.n}, m{input.m}, k{input.k};
+	int const v_line{n + 1};
+	int const v_plane{v_line * (m + 1)};
+	int const vertices{v_plane * (k + 1)};
+	float const zone{input.zone};
+
+	bricks.build(input);
+	cx.clear();
+	cy.clear();
+	cz.clear();
+	cr2.clear();
+	for (auto const &c: bricks.c) {
+		cx.push_back(c.x);
+		cy.push_back(c.y);
+		cz.push_back(c.z);
+		cr2.push_back(c.w);
+	}
+	auto brick_field{[this, &input](int brick) {
+		int const offset{bricks.offsets[brick]};
+		return marching_field{
+			bricks.offsets[brick + 1] - offset,
+			bricks.a.data() + offset, cx.data() + offset, cy.data() + offset, cz.data() + offset, cr2.data() + offset,
+			input.threshold
+		};
+	}};
+
+	values.resize(vertices);
+	vertex_ids.resize(vertices * 3);
+
+	/* fill values */ {
+		int const size{bricks.size};
+		parallel_for(threads, k + 1, [&, n, m, k, v_line, v_plane, zone, size](int, int begin, int end) {
+			for (int z{begin}; z < end; ++z)
+				for (int y{0}; y <= m; ++y)
+					for (int x{0}, row_end; x <= n; x = row_end) {
+						/* the last brick of the row also takes the far face */
+						row_end = x + size < n ? x + size : n + 1;
+						float *row{&values[z * v_plane + y * v_line]};
+						marching_field const f{brick_field(bricks.brick_of(x, y, z))};
+						if (f.spheres == 0) {
+							std::fill(row + x, row + row_end, -f.threshold);
+							continue;
+						}
+						simd->field_row(f, row, x, row_end, n, zone, grid_coord(y, m, zone), grid_coord(z, k, zone));
+					}
+		});
+	}
+
+	/* Edge ids are given in the (z, y, x, axis) order as the OpenCL path does on the host:
+	 * each chunk counts its crossing edges, then numbers them from its prefix offset.
+	 */
+	auto crossing{[this](int id, int alt_id) { return (values[alt_id] >= 0) != (values[id] >= 0); }};
+	int const chunks{parallel_for(threads, k + 1, [this, &crossing, n, m, k, v_line, v_plane](int chunk, int begin, int end) {
+		int count{0};
+		for (int z{begin}; z < end; ++z)
+			for (int y{0}; y <= m; ++y)
+				for (int x{0}; x <= n; ++x) {
+					int id{z * v_plane + y * v_line + x};
+					count += x < n && crossing(id, id + 1);
+					count += y < m && crossing(id, id + v_line);
+					count += z < k && crossing(id, id + v_plane);
+				}
+		chunk_counts[chunk] = count;
+	})};
+	int const vertex_count{exclusive_scan(chunk_counts, chunks)};
+
+	vector<Object::vertex_data> object_data(vertex_count);
+	vertex_bricks.resize(vertex_count);
+	/* put vertices */ {
+		float const d[3]{zone / n * 2, zone / m * 2, zone / k * 2};
+		int const step[3]{1, v_line, v_plane};
+		parallel_for(threads, k + 1, [&, n, m, k, v_line, v_plane, zone](int chunk, int begin, int end) {
+			int next_id{chunk_counts[chunk]};
+			for (int z{begin}; z < end; ++z)
+				for (int y{0}; y <= m; ++y)
+					for (int x{0}; x <= n; ++x) {
+						int id{z * v_plane + y * v_line + x};
+						bool const inside[3]{x < n, y < m, z < k};
+						vec3 const point(grid_coord(x, n, zone), grid_coord(y, m, zone), grid_coord(z, k, zone));
+						for (int axis{0}; axis < 3; ++axis) {
+							int alt_id{id + step[axis]};
+							if (!inside[axis] || !crossing(id, alt_id)) {
+								vertex_ids[id * 3 + axis] = -2;
+								continue;
+							}
+							float my_value{std::fabs(values[id])}, alt_value{std::fabs(values[alt_id])};
+							vec3 pos{point};
+							pos[axis] += d[axis] * (my_value / (my_value + alt_value));
+							object_data[next_id].pos = pos;
+							vertex_bricks[next_id] = bricks.brick_of(x, y, z);
+							vertex_ids[id * 3 + axis] = next_id++;
+						}
+					}
+		});
+		/* verticies of a brick mostly come in runs, every run takes the spheres of its brick */
+		parallel_for(threads, vertex_count, [this, &brick_field, &object_data](int, int begin, int end) {
+			while (begin < end) {
+				int run_end{begin + 1};
+				while (run_end < end && vertex_bricks[run_end] == vertex_bricks[begin])
+					++run_end;
+				simd->gradient(brick_field(vertex_bricks[begin]), object_data.data() + begin, run_end - begin);
+				begin = run_end;
+			}
+		});
+	}
+
+	auto case_id{[this, v_line, v_plane](int point_id) {
+		int result{0};
+		for (int i{0}; i < 8; ++i) {
+			int id{point_id + ((i >> 2) & 1) * v_plane + ((i >> 1) & 1) * v_line + ((i >> 0) & 1)};
+			result |= (values[id] >= 0) << i;
+		}
+		return result;
+	}};
+	int const cube_chunks{parallel_for(threads, k, [this, &case_id, n, m, v_line, v_plane](int chunk, int begin, int end) {
+		int count{0};
+		for (int z{begin}; z < end; ++z)
+			for (int y{0}; y < m; ++y)
+				for (int x{0}; x < n; ++x)
+					count += marching_case_sizes[case_id(z * v_plane + y * v_line + x)];
+		chunk_counts[chunk] = count;
+	})};
+	int const faces_count{exclusive_scan(chunk_counts, cube_chunks)};
+
+	vector<Object::face> faces(faces_count);
+	/* build mesh */ {
+		parallel_for(threads, k, [&, n, m, v_line, v_plane](int chunk, int begin, int end) {
+			auto vertex_by_edge{[&](int point_id, int edge) {
+				auto const &o(marching_edge_offsets[edge]);
+				return vertex_ids[(point_id + o[2] * v_plane + o[1] * v_line + o[0]) * 3 + o[3]];
+			}};
+			int next_id{chunk_counts[chunk]};
+			for (int z{begin}; z < end; ++z)
+				for (int y{0}; y < m; ++y)
+					for (int x{0}; x < n; ++x) {
+						int point_id{z * v_plane + y * v_line + x};
+						int c{case_id(point_id)};
+						auto const &edges(marching_edges[c]);
+						for (int i{0}; i < marching_case_sizes[c]; ++i)
+							faces[next_id++] = uvec3(
+								vertex_by_edge(point_id, edges[3 * i + 0]),
+								vertex_by_edge(point_id, edges[3 * i + 1]),
+								vertex_by_edge(point_id, edges[3 * i + 2])
+							);
+					}
+		});
+	}
+
+	return Object::manual(std::move(object_data), std::move(faces));
+}
@@ -0,0 +1,94 @@
+#include "marching_worker.hpp"
+
+#include <chrono>
+
+using std::make_unique;
+using std::string;
+using std::to_string;
+using std::unique_lock;
+
+static uint64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MarchingWorker::MarchingWorker(MarchingCpu &cpu, MarchingCl *cl, std::function<void()> notify):
+	cpu(cpu),
+	cl(cl),
+	notify(std::move(notify)),
+	thread(&MarchingWorker::run, this)
+{}
+
+MarchingWorker::~MarchingWorker() {
+	/* stop */ {
+		unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void MarchingWorker::request(marching_input input, bool use_cl) {
+	/* replace */ {
+		unique_lock<std::mutex> lock(mutex);
+		pending = make_unique<marching_input>(std::move(input));
+		pending_cl = use_cl && cl != nullptr;
+	}
+	wake.notify_one();
+}
+
+bool MarchingWorker::consume(std::function<void(result &)> const &f) {
+	result *built;
+	/* peek */ {
+		unique_lock<std::mutex> lock(mutex);
+		built = ready.get();
+	}
+	if (built == nullptr)
+		return false;
+
+	/* the worker waits for ready to be reset, so the result is not touched by it meanwhile */
+	f(*built);
+	/* release */ {
+		unique_lock<std::mutex> lock(mutex);
+		ready = nullptr;
+	}
+	wake.notify_one();
+	return true;
+}
+
+void MarchingWorker::wait() {
+	unique_lock<std::mutex> lock(mutex);
+	built.wait(lock, [this] { return pending == nullptr && !building; });
+}
+
+void MarchingWorker::run() {
+	unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || (pending != nullptr && ready == nullptr); });
+		if (stopping)
+			return;
+		auto input{std::move(pending)};
+		auto output{make_unique<result>()};
+		output->cl = pending_cl;
+		building = true;
+		lock.unlock();
+
+		output->started = now_ns();
+		try {
+			if (output->cl)
+				cl->compute(*input);
+			else
+				output->object = make_unique<Object>(cpu.build(*input));
+		} catch (cl::Error const &e) {
+			output->error = string("OpenCL: ") + e.what() + ": " + to_string(e.err());
+		} catch (std::exception const &e) {
+			output->error = e.what();
+		}
+		output->finished = now_ns();
+
+		lock.lock();
+		ready = std::move(output);
+		building = false;
+		built.notify_all();
+		notify();
+	}
+}
@@ -1,80 +1,272 @@
 #include "object.hpp"
+#include "thread_pool.hpp"
 
 #include <epoxy/gl.h>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/vector_angle.hpp>
-
-#include <locale>
-#include <cstdio>
-#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <map>
-
-static std::vector<std::string> split_by(std::string const &s, char c, bool filter = true) {
-	std::istringstream stream(s);
-	std::string elem;
-	std::vector<std::string> result;
-	while (std::getline(stream, elem, c))
-		if (elem.size() > 0 || !filter)
-			result.push_back(elem);
+#include <locale>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OBJECT_X86
+#endif
+
+/* Small open-addressing (linear probing) map from (v, vc, vn) to the vertex id. */
+class vertex_ids_map {
+private:
+	struct slot {
+		size_t v, vc, vn;
+		GLuint id;
+	};
+	static GLuint constexpr empty{static_cast<GLuint>(-1)};
+
+	std::vector<slot> slots;
+	size_t count{0};
+
+	static size_t hash(size_t v, size_t vc, size_t vn) {
+		uint64_t h{v * 0x9E3779B97F4A7C15ull};
+		h ^= (vc + 0x7F4A7C15ull) * 0xBF58476D1CE4E5B9ull;
+		h ^= (vn + 0x1CE4E5B9ull) * 0x94D049BB133111EBull;
+		return h ^ (h >> 31);
+	}
+
+	void grow() {
+		std::vector<slot> old(slots.size() * 2, slot{0, 0, 0, empty});
+		old.swap(slots);
+		size_t const mask{slots.size() - 1};
+		for (auto const &s: old) {
+			if (s.id == empty)
+				continue;
+			size_t i{hash(s.v, s.vc, s.vn) & mask};
+			while (slots[i].id != empty)
+				i = (i + 1) & mask;
+			slots[i] = s;
+		}
+	}
+
+public:
+	vertex_ids_map():
+		slots(1024, slot{0, 0, 0, empty}) {}
+
+	/* Returns the id stored for the key, inserting next_id if there was none. */
+	GLuint find_or_insert(size_t v, size_t vc, size_t vn, GLuint next_id) {
+		if (2 * (count + 1) > slots.size())
+			grow();
+		size_t const mask{slots.size() - 1};
+		size_t i{hash(v, vc, vn) & mask};
+		while (slots[i].id != empty) {
+			if (slots[i].v == v && slots[i].vc == vc && slots[i].vn == vn)
+				return slots[i].id;
+			i = (i + 1) & mask;
+		}
+		slots[i] = slot{v, vc, vn, next_id};
+		++count;
+		return next_id;
+	}
+};
+
+static bool is_blank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool is_separator(char c) {
+	return is_blank(c) || c == '\n' || c == '\0';
+}
+
+static void skip_blanks(char const *&p, char const *end) {
+	while (p != end && is_blank(*p))
+		++p;
+}
+
+/* Like std::from_chars: on success advances p past the number. */
+static bool parse_index(char const *&p, char const *end, size_t &value) {
+	char const *start{p};
+	size_t result{0};
+	while (p != end && *p >= '0' && *p <= '9')
+		result = result * 10 + (*p++ - '0');
+	if (p == start)
+		return false;
+	value = result;
+	return true;
+}
+
+/* Like std::from_chars for float, gives the same result as strtof.
+ * Short decimals (the usual OBJ case) are exact in float arithmetic,
+ * anything else is handed to strtof through a small stack copy.
+ */
+static float parse_float(char const *&p, char const *end) {
+	static float constexpr powers[]{1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+	static int constexpr max_power{10};
+	static uint64_t constexpr max_exact{uint64_t{1} << 24};
+
+	char const *start{p};
+	bool negative{false};
+	if (p != end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	uint64_t mantissa{0};
+	int digits{0}, exponent{0};
+	bool any{false}, fast{true};
+	auto take_digits{[&](bool fraction) {
+		while (p != end && *p >= '0' && *p <= '9') {
+			any = true;
+			if (mantissa != 0 || *p != '0')
+				++digits;
+			if (digits > 18)
+				fast = false;
+			else
+				mantissa = mantissa * 10 + (*p - '0');
+			if (fraction)
+				--exponent;
+			++p;
+		}
+	}};
+	take_digits(false);
+	if (p != end && *p == '.') {
+		++p;
+		take_digits(true);
+	}
+	if (any && p != end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool exponent_negative{false};
+		if (p != end && (*p == '-' || *p == '+'))
+			exponent_negative = *p++ == '-';
+		size_t value;
+		if (!parse_index(p, end, value) || value > 1000)
+			fast = false;
+		else
+			exponent += exponent_negative ? -static_cast<int>(value) : static_cast<int>(value);
+	}
+	if (p != end && !is_separator(*p))
+		fast = false;
+
+	while (mantissa != 0 && mantissa % 10 == 0 && exponent < 0) {
+		mantissa /= 10;
+		++exponent;
+	}
+	if (any && fast && mantissa <= max_exact && -max_power <= exponent && exponent <= max_power) {
+		float value{static_cast<float>(mantissa)};
+		value = (exponent < 0) ? value / powers[-exponent] : value * powers[exponent];
+		return negative ? -value : value;
+	}
+
+	char buffer[128];
+	size_t length{0};
+	for (p = start; p != end && !is_separator(*p) && length + 1 < sizeof(buffer); ++p)
+		buffer[length++] = *p;
+	buffer[length] = '\0';
+	char *tail;
+	float value{strtof(buffer, &tail)};
+	if (tail == buffer)
+		throw std::invalid_argument("Object::load: bad number");
+	p = start + (tail - buffer);
+	return value;
+}
+
+static glm::vec3 parse_vec3(char const *&p, char const *end) {
+	glm::vec3 result;
+	for (int i{0}; i != 3; ++i) {
+		skip_blanks(p, end);
+		result[i] = parse_float(p, end);
+	}
 	return result;
 }
 
 Object Object::load(std::string const &obj) {
+	return load(obj.data(), obj.size());
+}
+
+Object Object::load(char const *data, size_t size) {
 	auto old_locale{std::locale::global(std::locale::classic())};
 
 	std::vector<glm::vec3> v;
 	std::vector<glm::vec3> vn;
 	std::vector<glm::vec3> vc;
 
-	std::map<std::tuple<size_t, size_t, size_t>, GLuint> v_ids;
+	vertex_ids_map v_ids;
 
 	Object result;
 
-	for (std::string const &line: split_by(obj, '\n')) {
-		if (line.empty() || line[0] == '#')
-			continue;
-		auto tokens(split_by(line, ' '));
-		auto type(tokens[0]);
-		tokens.erase(tokens.begin());
-
-		if (type == "v") {
-			v.push_back(glm::vec3(stof(tokens[0]), stof(tokens[1]), stof(tokens[2])));
-		} else if (type == "vn") {
-			vn.push_back(glm::vec3(stof(tokens[0]), stof(tokens[1]), stof(tokens[2])));
-		} else if (type == "vc") {
-			vc.push_back(glm::vec3(stof(tokens[0]), stof(tokens[1]), stof(tokens[2])));
-		} else if (type == "f") {
-			std::vector<GLuint> verts;
-			for (auto const &t: tokens) {
-				auto elems(split_by(t, '/', false));
-				size_t constexpr bad(-1);
+	char const *p{data}, *end{data + size};
+	while (p != end) {
+		skip_blanks(p, end);
+		char const *type{p};
+		while (p != end && !is_separator(*p))
+			++p;
+		size_t const type_size(p - type);
+
+		if (type_size == 0 || type[0] == '#') {
+			/* empty line or comment */
+		} else if (type_size == 1 && type[0] == 'v') {
+			v.push_back(parse_vec3(p, end));
+		} else if (type_size == 2 && type[0] == 'v' && type[1] == 'n') {
+			vn.push_back(parse_vec3(p, end));
+		} else if (type_size == 2 && type[0] == 'v' && type[1] == 'c') {
+			vc.push_back(parse_vec3(p, end));
+		} else if (type_size == 1 && type[0] == 'f') {
+			size_t constexpr bad(-1);
+			GLuint first{0}, previous{0};
+			for (size_t corner{0}; ; ++corner) {
+				skip_blanks(p, end);
+				if (p == end || is_separator(*p))
+					break;
 
 				size_t v_id, vc_id(bad), vn_id(bad);
-				v_id = stoull(elems[0]) - 1;
-				if (elems.size() >= 2 && !elems[1].empty())
-					vc_id = stoull(elems[1]) - 1;
-				if (elems.size() >= 3 && !elems[2].empty())
-					vn_id = stoull(elems[2]) - 1;
-
-				std::tuple<size_t, size_t, size_t> id{v_id, vc_id, vn_id};
-				if (v_ids.count(id) == 0) {
+				if (!parse_index(p, end, v_id))
+					throw std::invalid_argument("Object::load: bad face");
+				--v_id;
+				if (p != end && *p == '/') {
+					++p;
+					if (parse_index(p, end, vc_id))
+						--vc_id;
+					if (p != end && *p == '/') {
+						++p;
+						if (parse_index(p, end, vn_id))
+							--vn_id;
+					}
+				}
+				while (p != end && !is_separator(*p))
+					++p;
+
+				GLuint const next_id(result.verticies.size());
+				GLuint const id{v_ids.find_or_insert(v_id, vc_id, vn_id, next_id)};
+				if (id == next_id) {
 					vertex_data vertex;
-					vertex.pos   = v[v_id];
-					vertex.norm  = (vn_id == bad) ? glm::vec3{0, 0, 0} : vn[vn_id];
-					vertex.color = (vc_id == bad) ? glm::vec3{1, 1, 1} : vc[vc_id];
+					vertex.pos   = v.at(v_id);
+					vertex.norm  = (vn_id == bad) ? glm::vec3{0, 0, 0} : vn.at(vn_id);
+					vertex.color = (vc_id == bad) ? glm::vec3{1, 1, 1} : vc.at(vc_id);
 					result.verticies.push_back(vertex);
-					v_ids[id] = result.verticies.size() - 1;
 				}
-				verts.push_back(v_ids[id]);
-			}
-			for (size_t i{1}; i + 1 < verts.size(); ++i) {
-				result.faces.emplace_back(verts[0], verts[i], verts[i + 1]);
+
+				if (corner == 0)
+					first = id;
+				else if (corner >= 2)
+					result.faces.emplace_back(first, previous, id);
+				previous = id;
 			}
 		} else {
-			std::cout << "UNKNOWN TYPE " << type << std::endl;
+			std::cout << "UNKNOWN TYPE ";
+			std::cout.write(type, type_size) << std::endl;
 		}
+
+		while (p != end && *p != '\n')
+			++p;
+		if (p != end)
+			++p;
 	}
 	std::locale::global(old_locale);
 	return result;
@@ -87,23 +279,220 @@ Object Object::manual(std::vector<vertex_data> const &data, std::vector<glm::uve
 	return result;
 }
 
-void Object::recalculate_normals() {
-	std::vector<glm::vec3> new_normals(verticies.size());
-	for (size_t id{0}; id != faces.size(); ++id) {
-		GLuint const i{faces[id][0]};
-		GLuint const j{faces[id][1]};
-		GLuint const k{faces[id][2]};
-		auto const &a{verticies[i].pos};
-		auto const &b{verticies[j].pos};
-		auto const &c{verticies[k].pos};
-		glm::vec3 norm{glm::normalize(glm::cross(b - a, c - a))};
+Object Object::manual(std::vector<vertex_data> &&data, std::vector<glm::uvec3> &&elems) {
+	Object result;
+	result.verticies = std::move(data);
+	result.faces = std::move(elems);
+	return result;
+}
+
+static char constexpr binary_magic[4]{'M', 'E', 'S', 'H'};
+static_assert(sizeof(Object::vertex_data) == 9 * sizeof(float), "vertex_data must stay packed for binary meshes");
+static_assert(sizeof(Object::face) == 3 * sizeof(uint32_t), "face must stay packed for binary meshes");
+
+Object::binary_view Object::view_binary(void const *data, size_t size) {
+	auto const bytes{static_cast<char const *>(data)};
+	binary_header header;
+	if (size < sizeof(header))
+		throw std::invalid_argument("Object::view_binary: truncated header");
+	std::memcpy(&header, bytes, sizeof(header));
+	if (std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0)
+		throw std::invalid_argument("Object::view_binary: not a binary mesh");
+	if (header.version != binary_version)
+		throw std::invalid_argument("Object::view_binary: unsupported version " + std::to_string(header.version));
+
+	size_t const verticies_size{sizeof(vertex_data) * header.verticies_count};
+	size_t const faces_size{sizeof(face) * header.faces_count};
+	if (size != sizeof(header) + verticies_size + faces_size)
+		throw std::invalid_argument("Object::view_binary: size does not match the header");
+	if (reinterpret_cast<uintptr_t>(bytes) % alignof(vertex_data) != 0)
+		throw std::invalid_argument("Object::view_binary: misaligned data");
+
+	binary_view result;
+	result.verticies = reinterpret_cast<vertex_data const *>(bytes + sizeof(header));
+	result.verticies_count = header.verticies_count;
+	result.faces = reinterpret_cast<face const *>(bytes + sizeof(header) + verticies_size);
+	result.faces_count = header.faces_count;
+	/* checked once here, so the users may index the verticies without */
+	for (size_t i{0}; i != result.faces_count; ++i)
+		for (int j{0}; j != 3; ++j)
+			if (result.faces[i][j] >= result.verticies_count)
+				throw std::invalid_argument("Object::view_binary: face " + std::to_string(i) + " has no vertex " + std::to_string(result.faces[i][j]));
+	return result;
+}
+
+Object Object::load_binary(void const *data, size_t size) {
+	binary_view view{view_binary(data, size)};
+	Object result;
+	result.verticies.assign(view.verticies, view.verticies + view.verticies_count);
+	result.faces.assign(view.faces, view.faces + view.faces_count);
+	return result;
+}
+
+void Object::save_binary(std::ostream &s) const {
+	binary_header header;
+	std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+	header.version = binary_version;
+	header.verticies_count = verticies.size();
+	header.faces_count = faces.size();
+	s.write(reinterpret_cast<char const *>(&header), sizeof(header));
+	s.write(reinterpret_cast<char const *>(verticies.data()), sizeof(vertex_data) * verticies.size());
+	s.write(reinterpret_cast<char const *>(faces.data()), sizeof(face) * faces.size());
+}
 
-		new_normals[i] += norm * angle(normalize(b - a), normalize(c - a));
-		new_normals[j] += norm * angle(normalize(a - b), normalize(c - b));
-		new_normals[k] += norm * angle(normalize(a - c), normalize(b - c));
+
+/* Normals of faces [begin, end) weighted by the angle of each corner, stored as three planes of corners:
+ * corner c of face f is at c * faces.size() + f. Degenerate faces weigh nothing.
+ */
+static void corner_normals(
+	std::vector<Object::vertex_data> const &verticies, std::vector<Object::face> const &faces,
+	size_t begin, size_t end, float *x, float *y, float *z
+) {
+	size_t const count{faces.size()};
+	size_t f{begin};
+#ifdef OBJECT_X86
+	/* four faces at a time, every lane is a face */
+	auto const acos{[](__m128 v) {
+		/* Abramowitz and Stegun 4.4.46: acos(x) = sqrt(1 - x) * P(x) on [0, 1], within 2e-8 */
+		__m128 const one{_mm_set1_ps(1)};
+		__m128 const negative{_mm_cmplt_ps(v, _mm_setzero_ps())};
+		__m128 const a{_mm_min_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), v), one)};
+		__m128 p{_mm_set1_ps(-0.0012624911f)};
+		for (float k: {0.0066700901f, -0.0170881256f, 0.0308918810f, -0.0501743046f, 0.0889789874f, -0.2145988016f, 1.5707963050f})
+			p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(k));
+		__m128 const r{_mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(one, a)), p)};
+		__m128 const flipped{_mm_sub_ps(_mm_set1_ps(3.14159265f), r)};
+		return _mm_or_ps(_mm_and_ps(negative, flipped), _mm_andnot_ps(negative, r));
+	}};
+	for (; f + 4 <= end; f += 4) {
+		alignas(16) float p[9][4];
+		for (size_t l{0}; l != 4; ++l)
+			for (size_t c{0}; c != 3; ++c) {
+				glm::vec3 const &v{verticies[faces[f + l][c]].pos};
+				p[3 * c][l] = v.x;
+				p[3 * c + 1][l] = v.y;
+				p[3 * c + 2][l] = v.z;
+			}
+		__m128 const ax{_mm_load_ps(p[0])}, ay{_mm_load_ps(p[1])}, az{_mm_load_ps(p[2])};
+		__m128 const bx{_mm_load_ps(p[3])}, by{_mm_load_ps(p[4])}, bz{_mm_load_ps(p[5])};
+		__m128 const cx{_mm_load_ps(p[6])}, cy{_mm_load_ps(p[7])}, cz{_mm_load_ps(p[8])};
+		__m128 const abx{_mm_sub_ps(bx, ax)}, aby{_mm_sub_ps(by, ay)}, abz{_mm_sub_ps(bz, az)};
+		__m128 const acx{_mm_sub_ps(cx, ax)}, acy{_mm_sub_ps(cy, ay)}, acz{_mm_sub_ps(cz, az)};
+		__m128 const bcx{_mm_sub_ps(cx, bx)}, bcy{_mm_sub_ps(cy, by)}, bcz{_mm_sub_ps(cz, bz)};
+		auto const dot{[](__m128 x0, __m128 y0, __m128 z0, __m128 x1, __m128 y1, __m128 z1) {
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_mul_ps(z0, z1));
+		}};
+		__m128 const nx{_mm_sub_ps(_mm_mul_ps(aby, acz), _mm_mul_ps(abz, acy))};
+		__m128 const ny{_mm_sub_ps(_mm_mul_ps(abz, acx), _mm_mul_ps(abx, acz))};
+		__m128 const nz{_mm_sub_ps(_mm_mul_ps(abx, acy), _mm_mul_ps(aby, acx))};
+		__m128 const n2{dot(nx, ny, nz, nx, ny, nz)};
+		__m128 const valid{_mm_cmpgt_ps(n2, _mm_setzero_ps())};
+		__m128 const n_inv{_mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(n2))};
+		__m128 const ab{_mm_sqrt_ps(dot(abx, aby, abz, abx, aby, abz))};
+		__m128 const ac{_mm_sqrt_ps(dot(acx, acy, acz, acx, acy, acz))};
+		__m128 const bc{_mm_sqrt_ps(dot(bcx, bcy, bcz, bcx, bcy, bcz))};
+		__m128 const angles[3]{
+			acos(_mm_div_ps(dot(abx, aby, abz, acx, acy, acz), _mm_mul_ps(ab, ac))),
+			acos(_mm_div_ps(_mm_sub_ps(_mm_setzero_ps(), dot(abx, aby, abz, bcx, bcy, bcz)), _mm_mul_ps(ab, bc))),
+			acos(_mm_div_ps(dot(acx, acy, acz, bcx, bcy, bcz), _mm_mul_ps(ac, bc)))
+		};
+		for (size_t c{0}; c != 3; ++c) {
+			/* the mask drops the NaNs of degenerate faces */
+			__m128 const w{_mm_and_ps(valid, _mm_mul_ps(angles[c], n_inv))};
+			_mm_storeu_ps(x + c * count + f, _mm_mul_ps(nx, w));
+			_mm_storeu_ps(y + c * count + f, _mm_mul_ps(ny, w));
+			_mm_storeu_ps(z + c * count + f, _mm_mul_ps(nz, w));
+		}
+	}
+#endif
+	for (; f != end; ++f) {
+		glm::vec3 const &a{verticies[faces[f][0]].pos};
+		glm::vec3 const &b{verticies[faces[f][1]].pos};
+		glm::vec3 const &c{verticies[faces[f][2]].pos};
+		glm::vec3 const ab{b - a}, ac{c - a}, bc{c - b};
+		glm::vec3 const n{glm::cross(ab, ac)};
+		float const n_length{glm::length(n)};
+		float angles[3]{0, 0, 0};
+		if (n_length > 0) {
+			float const ab_length{glm::length(ab)}, ac_length{glm::length(ac)}, bc_length{glm::length(bc)};
+			angles[0] = std::acos(glm::clamp(glm::dot(ab, ac) / (ab_length * ac_length), -1.0f, 1.0f));
+			angles[1] = std::acos(glm::clamp(-glm::dot(ab, bc) / (ab_length * bc_length), -1.0f, 1.0f));
+			angles[2] = std::acos(glm::clamp(glm::dot(ac, bc) / (ac_length * bc_length), -1.0f, 1.0f));
+		}
+		for (size_t i{0}; i != 3; ++i) {
+			glm::vec3 const w{n_length > 0 ? n * (angles[i] / n_length) : glm::vec3(0)};
+			x[i * count + f] = w.x;
+			y[i * count + f] = w.y;
+			z[i * count + f] = w.z;
+		}
 	}
-	for (size_t i{0}; i != verticies.size(); ++i)
-		verticies[i].norm = glm::normalize(new_normals[i]);
+}
+
+void Object::recalculate_normals(unsigned threads) {
+	size_t const count{faces.size()};
+	/* a thread gets at least this many faces or verticies */
+	size_t const grain{16384};
+	ThreadPool pool(threads);
+
+	std::unique_ptr<float[]> const x{new float[3 * count]}, y{new float[3 * count]}, z{new float[3 * count]};
+	/* in groups of four faces, so the same faces go through the SIMD path whatever the threads */
+	pool.run((count + 3) / 4, grain / 4, [&](size_t begin, size_t end) {
+		corner_normals(verticies, faces, 4 * begin, std::min(4 * end, count), x.get(), y.get(), z.get());
+	});
+
+	/* the verticies are split in parts, and every part sums the corners that fall into it in face order,
+	 * so the sums do not depend on the threads
+	 */
+	size_t const verticies_count{verticies.size()};
+	size_t const parts{std::max<size_t>(1, std::min<size_t>(pool.get_threads(), verticies_count / grain))};
+	double const part_scale{static_cast<double>(parts) / std::max<size_t>(1, verticies_count)};
+	auto const part_of{[&](size_t i) {
+		return std::min(parts - 1, static_cast<size_t>(i * part_scale));
+	}};
+	auto const sum_corner{[&](size_t f, size_t c) {
+		verticies[faces[f][c]].norm += glm::vec3(x[c * count + f], y[c * count + f], z[c * count + f]);
+	}};
+	pool.run(verticies_count, grain, [&](size_t begin, size_t end) {
+		for (size_t i{begin}; i != end; ++i)
+			verticies[i].norm = glm::vec3(0);
+	});
+	if (parts == 1) {
+		for (size_t f{0}; f != count; ++f)
+			for (size_t c{0}; c != 3; ++c)
+				sum_corner(f, c);
+	} else {
+		/* the corners 3 * f + c sorted by part by counting: every thread counts and then places the corners
+		 * of its range of faces, the ranges of a part following in face order
+		 */
+		std::vector<size_t> offsets(parts * parts);
+		pool.run(parts, 1, [&](size_t range, size_t) {
+			size_t *const counts{&offsets[range * parts]};
+			for (size_t f{count * range / parts}; f != count * (range + 1) / parts; ++f)
+				for (size_t c{0}; c != 3; ++c)
+					++counts[part_of(faces[f][c])];
+		});
+		size_t total{0};
+		for (size_t part{0}; part != parts; ++part)
+			for (size_t range{0}; range != parts; ++range)
+				total += std::exchange(offsets[range * parts + part], total);
+		std::unique_ptr<GLuint[]> const corners{new GLuint[3 * count]};
+		pool.run(parts, 1, [&](size_t range, size_t) {
+			size_t *const next{&offsets[range * parts]};
+			for (size_t f{count * range / parts}; f != count * (range + 1) / parts; ++f)
+				for (size_t c{0}; c != 3; ++c)
+					corners[next[part_of(faces[f][c])]++] = 3 * f + c;
+		});
+		/* a part ends where its corners of the last range do */
+		pool.run(parts, 1, [&](size_t part, size_t) {
+			size_t const begin{(part == 0) ? 0 : offsets[(parts - 1) * parts + part - 1]}, end{offsets[(parts - 1) * parts + part]};
+			for (size_t j{begin}; j != end; ++j)
+				sum_corner(corners[j] / 3, corners[j] % 3);
+		});
+	}
+	pool.run(verticies_count, grain, [&](size_t begin, size_t end) {
+		for (size_t i{begin}; i != end; ++i)
+			verticies[i].norm = glm::normalize(verticies[i].norm);
+	});
 }
 
 void Object::normals_as_colors() {
@@ -111,6 +500,237 @@ void Object::normals_as_colors() {
 		verticies[i].color = (verticies[i].norm + glm::vec3(1, 1, 1)) / 2.0f;
 }
 
+/* FIFO cache of verticies: they are stamped when transformed and stay in the cache for cache_size more transforms */
+class vertex_cache {
+private:
+	std::vector<size_t> stamps;
+	size_t const size;
+	size_t time;
+
+public:
+	vertex_cache(size_t verticies, size_t size):
+		stamps(verticies, 0),
+		size(size),
+		time(size + 1)
+	{}
+
+	bool has(GLuint v) const {
+		return time - stamps[v] <= size;
+	}
+
+	/* How long ago the vertex was transformed */
+	size_t age(GLuint v) const {
+		return time - stamps[v];
+	}
+
+	/* Transforms the vertex unless it is cached, tells whether it was transformed */
+	bool use(GLuint v) {
+		if (has(v))
+			return false;
+		stamps[v] = time++;
+		return true;
+	}
+
+	void flush() {
+		time += size + 1;
+	}
+};
+
+Object::cache_stats Object::analyze_vertex_cache(size_t cache_size) const {
+	vertex_cache cache(verticies.size(), cache_size);
+	size_t transformed{0};
+	for (auto const &f: faces)
+		for (size_t c{0}; c != 3; ++c)
+			transformed += cache.use(f[c]);
+	return {
+		faces.empty() ? 0 : static_cast<float>(transformed) / faces.size(),
+		verticies.empty() ? 0 : static_cast<float>(transformed) / verticies.size()
+	};
+}
+
+void Object::optimize_faces(size_t cache_size, float overdraw_threshold) {
+	size_t const count{faces.size()};
+	size_t const verticies_count{verticies.size()};
+	if (count == 0)
+		return;
+
+	/* faces of every vertex (CSR) */
+	std::vector<GLuint> first(verticies_count + 1, 0);
+	for (auto const &f: faces)
+		for (size_t c{0}; c != 3; ++c)
+			++first[f[c] + 1];
+	for (size_t i{0}; i != verticies_count; ++i)
+		first[i + 1] += first[i];
+	std::vector<GLuint> adjacent(3 * count);
+	/* fill */ {
+		std::vector<GLuint> next(first.begin(), first.end() - 1);
+		for (size_t f{0}; f != count; ++f)
+			for (size_t c{0}; c != 3; ++c)
+				adjacent[next[faces[f][c]]++] = f;
+	}
+
+	/* Tipsify: fans the faces around a vertex, then goes on with a vertex of them that stays in the cache,
+	 * and when there is none, with the latest vertex with faces left
+	 */
+	std::vector<GLuint> order;
+	order.reserve(count);
+	/* starts of clusters, which begin where the cache is cold */
+	std::vector<size_t> hard{0};
+	/* faces left around every vertex */
+	std::vector<GLuint> live(verticies_count);
+	for (size_t i{0}; i != verticies_count; ++i)
+		live[i] = first[i + 1] - first[i];
+	std::vector<bool> emitted(count, false);
+	std::vector<GLuint> dead_ends, candidates;
+	vertex_cache cache(verticies_count, cache_size);
+	size_t constexpr none{static_cast<size_t>(-1)};
+	size_t cursor{0};
+	for (size_t fanning{0}; fanning != none;) {
+		candidates.clear();
+		for (GLuint j{first[fanning]}; j != first[fanning + 1]; ++j) {
+			GLuint const f{adjacent[j]};
+			if (emitted[f])
+				continue;
+			emitted[f] = true;
+			order.push_back(f);
+			for (size_t c{0}; c != 3; ++c) {
+				GLuint const v{faces[f][c]};
+				dead_ends.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				cache.use(v);
+			}
+		}
+
+		/* the oldest vertex that would still be in the cache after its faces are fanned */
+		size_t next{none};
+		size_t best{0};
+		for (GLuint v: candidates) {
+			if (live[v] == 0)
+				continue;
+			size_t const priority{cache.age(v) + 2 * live[v] <= cache_size ? cache.age(v) : 0};
+			if (next == none || priority > best) {
+				next = v;
+				best = priority;
+			}
+		}
+		if (next == none) {
+			while (next == none && !dead_ends.empty()) {
+				GLuint const v{dead_ends.back()};
+				dead_ends.pop_back();
+				if (live[v] != 0)
+					next = v;
+			}
+			for (; next == none && cursor != verticies_count; ++cursor)
+				if (live[cursor] != 0)
+					next = cursor;
+			if (next != none && !cache.has(next) && hard.back() != order.size())
+				hard.push_back(order.size());
+		}
+		fanning = next;
+	}
+	hard.push_back(count);
+	if (overdraw_threshold <= 0) {
+		std::vector<face> result;
+		result.reserve(count);
+		for (GLuint f: order)
+			result.push_back(faces[f]);
+		faces = std::move(result);
+		return;
+	}
+
+	/* splits every cluster after the shortest prefix whose ACMR is low enough, starting with a cold cache */
+	std::vector<size_t> clusters;
+	vertex_cache soft(verticies_count, cache_size);
+	for (size_t h{0}; h + 1 != hard.size(); ++h) {
+		size_t const begin{hard[h]}, end{hard[h + 1]};
+		size_t transformed{0};
+		soft.flush();
+		for (size_t i{begin}; i != end; ++i)
+			for (size_t c{0}; c != 3; ++c)
+				transformed += soft.use(faces[order[i]][c]);
+		float const limit{overdraw_threshold * transformed / (end - begin)};
+
+		clusters.push_back(begin);
+		soft.flush();
+		transformed = 0;
+		for (size_t i{begin}; i != end; ++i) {
+			for (size_t c{0}; c != 3; ++c)
+				transformed += soft.use(faces[order[i]][c]);
+			if (i + 1 != end && transformed <= limit * (i + 1 - clusters.back())) {
+				clusters.push_back(i + 1);
+				soft.flush();
+				transformed = 0;
+			}
+		}
+	}
+	clusters.push_back(count);
+
+	/* the clusters farther out of the center along their normal go first (the occlusion potential of Sander et al.),
+	 * centers are weighted by face areas
+	 */
+	auto const face_normal{[&](GLuint f) {
+		glm::vec3 const &a{verticies[faces[f][0]].pos};
+		return glm::cross(verticies[faces[f][1]].pos - a, verticies[faces[f][2]].pos - a);
+	}};
+	auto const face_center{[&](GLuint f) {
+		return (verticies[faces[f][0]].pos + verticies[faces[f][1]].pos + verticies[faces[f][2]].pos) / 3.0f;
+	}};
+	glm::vec3 center{0};
+	float area{0};
+	for (size_t f{0}; f != count; ++f) {
+		float const a{glm::length(face_normal(f))};
+		center += face_center(f) * a;
+		area += a;
+	}
+	if (area > 0)
+		center /= area;
+	std::vector<float> potentials(clusters.size() - 1);
+	for (size_t k{0}; k + 1 != clusters.size(); ++k) {
+		glm::vec3 normal{0}, cluster_center{0};
+		float cluster_area{0};
+		for (size_t i{clusters[k]}; i != clusters[k + 1]; ++i) {
+			glm::vec3 const n{face_normal(order[i])};
+			float const a{glm::length(n)};
+			normal += n;
+			cluster_center += face_center(order[i]) * a;
+			cluster_area += a;
+		}
+		float const normal_length{glm::length(normal)};
+		potentials[k] = (cluster_area > 0 && normal_length > 0) ? glm::dot(cluster_center / cluster_area - center, normal / normal_length) : 0;
+	}
+	std::vector<size_t> sorted(potentials.size());
+	for (size_t k{0}; k != sorted.size(); ++k)
+		sorted[k] = k;
+	std::stable_sort(sorted.begin(), sorted.end(), [&](size_t a, size_t b) {
+		return potentials[a] > potentials[b];
+	});
+
+	std::vector<face> result;
+	result.reserve(count);
+	for (size_t k: sorted)
+		for (size_t i{clusters[k]}; i != clusters[k + 1]; ++i)
+			result.push_back(faces[order[i]]);
+	faces = std::move(result);
+}
+
+void Object::optimize_vertex_fetch() {
+	GLuint constexpr none{static_cast<GLuint>(-1)};
+	std::vector<GLuint> remap(verticies.size(), none);
+	std::vector<vertex_data> result;
+	result.reserve(verticies.size());
+	for (auto &f: faces)
+		for (size_t c{0}; c != 3; ++c) {
+			GLuint &v{remap[f[c]]};
+			if (v == none) {
+				v = result.size();
+				result.push_back(verticies[f[c]]);
+			}
+			f[c] = v;
+		}
+	verticies = std::move(result);
+}
+
 std::ostream &operator<<(std::ostream &s, Object const &o) {
 	s << "Object: " << o.verticies.size() << " verticies, " << o.faces.size() << " faces.\n";
 	for (size_t i{0}; i != o.verticies.size(); ++i) {
@@ -127,3 +747,29 @@ std::ostream &operator<<(std::ostream &s, Object const &o) {
 	}
 	return s;
 }
+
+MappedMesh::MappedMesh(std::string const &path) {
+	int fd{open(path.c_str(), O_RDONLY)};
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		int error{errno};
+		close(fd);
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	size = info.st_size;
+	data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int error{errno};
+	close(fd);
+	if (data == MAP_FAILED)
+		throw std::system_error(error, std::generic_category(), path);
+}
+
+MappedMesh::~MappedMesh() {
+	munmap(data, size);
+}
+
+Object::binary_view MappedMesh::view() const {
+	return Object::view_binary(data, size);
+}
@@ -12,104 +12,137 @@ static void check(std::string const &name) {
 		std::cout << "Check " << name << " FAILED " << std::hex << error << std::endl;
 }
 
-SceneObject::SceneObject(Object const &obj) {
+SceneObject::SceneObject(Object const &obj):
+	SceneObject(Object::binary_view{obj.verticies.data(), obj.verticies.size(), obj.faces.data(), obj.faces.size()}) {}
+
+SceneObject::SceneObject(Object::binary_view const &mesh) {
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
 
 	glGenBuffers(1, &data);
 	glBindBuffer(GL_ARRAY_BUFFER, data);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Object::vertex_data) * obj.verticies.size(), obj.verticies.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Object::vertex_data) * mesh.verticies_count, mesh.verticies, GL_STATIC_DRAW);
 
 	glGenBuffers(1, &elems);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
-	elems_count = obj.faces.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(decltype(obj.faces)::value_type) * elems_count, obj.faces.data(), GL_STATIC_DRAW);
+	elems_count = mesh.faces_count;
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Object::face) * elems_count, mesh.faces, GL_STATIC_DRAW);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	set_attributes();
+
+	/* the element buffer binding is a part of the VAO, it stays */
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 };
 
+SceneObject::SceneObject(size_t verticies_count, size_t faces_count) {
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &data);
+	glBindBuffer(GL_ARRAY_BUFFER, data);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Object::vertex_data) * verticies_count, nullptr, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &elems);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+	elems_count = faces_count;
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Object::face) * elems_count, nullptr, GL_DYNAMIC_DRAW);
+
+	set_attributes();
+
+	/* the element buffer binding is a part of the VAO, it stays */
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SceneObject::set_attributes() {
+	struct {
+		GLuint location;
+		size_t offset;
+	} const attributes[]{
+		{Program::position_location, offsetof(Object::vertex_data, pos)},
+		{Program::normal_location, offsetof(Object::vertex_data, norm)},
+		{Program::color_location, offsetof(Object::vertex_data, color)}
+	};
+	for (auto const &attribute: attributes) {
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location,
+			3, GL_FLOAT,
+			GL_FALSE,
+			sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(attribute.offset)
+		);
+	}
+	glVertexAttrib4f(Program::instance_position_location, 0, 0, 0, 1);
+	glVertexAttrib4f(Program::instance_color_location, 1, 1, 1, 1);
+}
+
 SceneObject::~SceneObject() {
+	glDeleteBuffers(1, &instances);
 	glDeleteBuffers(1, &data);
 	glDeleteBuffers(1, &elems);
+	glDeleteVertexArrays(1, &instanced_vao);
 	glDeleteVertexArrays(1, &vao);
 }
 
-void SceneObject::draw(
-	glm::mat4 const &v, glm::mat4 const &p,
-	GLuint m_attribute, GLuint mv_attribute, GLuint mvp_attribute,
-	GLuint m_inv_attribute, GLuint mv_inv_attribute, GLuint mvp_inv_attribute
-) const {
+void SceneObject::draw(UniformBlocks &blocks, Program const &program) const {
 	glBindVertexArray(vao);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
-
-	glm::mat4 m(position * animation_position), m_inv(glm::inverse(m));
-	glm::mat4 mv(v * m), mv_inv(glm::inverse(mv));
-	glm::mat4 mvp(p * mv), mvp_inv(glm::inverse(mvp));
-	glUniformMatrix4fv(m_attribute      , 1, GL_FALSE, &m      [0][0]);
-	glUniformMatrix4fv(mv_attribute     , 1, GL_FALSE, &mv     [0][0]);
-	glUniformMatrix4fv(mvp_attribute    , 1, GL_FALSE, &mvp    [0][0]);
-	glUniformMatrix4fv(m_inv_attribute  , 1, GL_FALSE, &m_inv  [0][0]);
-	glUniformMatrix4fv(mv_inv_attribute , 1, GL_FALSE, &mv_inv [0][0]);
-	glUniformMatrix4fv(mvp_inv_attribute, 1, GL_FALSE, &mvp_inv[0][0]);
-
+	blocks.set_object(program, position * animation_position);
 	glDrawElements(GL_TRIANGLES, elems_count * 3, GL_UNSIGNED_INT, nullptr);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 }
 
-void SceneObject::set_attribute_to_position(GLuint attribute) const {
-	if (attribute == Program::no_id)
-		return;
-
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, data);
-	
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute,
-		3, GL_FLOAT,
-		GL_FALSE,
-		sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offsetof(Object::vertex_data, pos))
-	);
-	
+void SceneObject::set_instances(std::vector<instance> const &list) {
+	if (instances == 0) {
+		glGenVertexArrays(1, &instanced_vao);
+		glBindVertexArray(instanced_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, data);
+		set_attributes();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elems);
+		glGenBuffers(1, &instances);
+		glBindBuffer(GL_ARRAY_BUFFER, instances);
+		struct {
+			GLuint location;
+			size_t offset;
+		} const attributes[]{
+			{Program::instance_position_location, offsetof(instance, position_scale)},
+			{Program::instance_color_location, offsetof(instance, color_power)}
+		};
+		for (auto const &attribute: attributes) {
+			glEnableVertexAttribArray(attribute.location);
+			glVertexAttribPointer(attribute.location,
+				4, GL_FLOAT,
+				GL_FALSE,
+				sizeof(instance), reinterpret_cast<GLvoid const *>(attribute.offset)
+			);
+			glVertexAttribDivisor(attribute.location, 1);
+		}
+		glBindVertexArray(0);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, instances);
+	}
+	instances_count = list.size();
+	glBufferData(GL_ARRAY_BUFFER, sizeof(instance) * list.size(), list.data(), GL_STREAM_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
 
-void SceneObject::set_attribute_to_normal(GLuint attribute) const {
-	if (attribute == Program::no_id)
+void SceneObject::draw_instanced(UniformBlocks &blocks, Program const &program) const {
+	if (instances_count == 0)
 		return;
-
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, data);
-	
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute,
-		3, GL_FLOAT,
-		GL_FALSE,
-		sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offsetof(Object::vertex_data, norm))
-	);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(instanced_vao);
+	blocks.set_object(program, position * animation_position);
+	glDrawElementsInstanced(GL_TRIANGLES, elems_count * 3, GL_UNSIGNED_INT, nullptr, instances_count);
 	glBindVertexArray(0);
 }
 
-void SceneObject::set_attribute_to_color(GLuint attribute) const {
-	if (attribute == Program::no_id)
-		return;
+GLuint SceneObject::get_data_buffer() const {
+	return data;
+}
 
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, data);
+GLuint SceneObject::get_elems_buffer() const {
+	return elems;
+}
 
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute,
-		3, GL_FLOAT,
-		GL_FALSE,
-		sizeof(Object::vertex_data), reinterpret_cast<GLvoid const *>(offsetof(Object::vertex_data, color))
-	);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+void SceneObject::set_elems_count(size_t count) {
+	elems_count = count;
 }
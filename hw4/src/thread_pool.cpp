@@ -0,0 +1,67 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+using std::unique_lock;
+
+ThreadPool::ThreadPool(unsigned threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned i{1}; i < threads; ++i)
+		workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+	/* stop */ {
+		unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto &worker: workers)
+		worker.join();
+}
+
+unsigned ThreadPool::get_threads() const {
+	return workers.size() + 1;
+}
+
+void ThreadPool::work() {
+	unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || next < parts; });
+		if (stopping)
+			return;
+		size_t const part{next++};
+		auto const &loop{*f};
+		size_t const begin{count * part / parts}, end{count * (part + 1) / parts};
+		lock.unlock();
+		loop(begin, end);
+		lock.lock();
+		if (--remaining == 0)
+			finished.notify_one();
+	}
+}
+
+void ThreadPool::run(size_t count, size_t grain, std::function<void(size_t, size_t)> const &f) {
+	size_t const parts{std::max<size_t>(1, std::min<size_t>(get_threads(), count / std::max<size_t>(1, grain)))};
+	if (parts == 1) {
+		f(0, count);
+		return;
+	}
+	/* start */ {
+		unique_lock<std::mutex> lock(mutex);
+		this->f = &f;
+		this->count = count;
+		this->parts = parts;
+		/* the first part is the caller's */
+		next = 1;
+		remaining = parts - 1;
+	}
+	wake.notify_all();
+	f(0, count / parts);
+	unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return remaining == 0; });
+	this->parts = 0;
+	next = 0;
+	this->f = nullptr;
+}
@@ -0,0 +1,397 @@
+#include "object.hpp"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/vector_angle.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Every heap allocation of the process goes through here, so the loaders can be measured. */
+static size_t allocations{0};
+
+void *operator new(size_t size) {
+	++allocations;
+	if (void *result{std::malloc(size == 0 ? 1 : size)})
+		return result;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+static std::string read_file(std::string const &path) {
+	std::ifstream f(path, std::ios::binary);
+	if (!f)
+		throw std::runtime_error("Cannot open " + path);
+	return std::string(std::istreambuf_iterator<char>{f}, {});
+}
+
+/* A w x h grid of quads with shared normals, written the way OBJ exporters do. */
+static std::string synthetic_obj(size_t faces) {
+	size_t w{1};
+	while (2 * w * w < faces)
+		++w;
+	size_t const h{w};
+
+	std::string result;
+	char line[128];
+	for (size_t y{0}; y <= h; ++y)
+		for (size_t x{0}; x <= w; ++x) {
+			float const fx{static_cast<float>(x) / w}, fy{static_cast<float>(y) / h};
+			std::snprintf(line, sizeof(line), "v %f %f %f\n", fx, .1f * fx * fy, fy);
+			result += line;
+		}
+	result += "vn 0.000000 1.000000 0.000000\n";
+	for (size_t y{0}; y != h; ++y)
+		for (size_t x{0}; x != w; ++x) {
+			size_t const a{y * (w + 1) + x + 1}, b{a + 1}, c{b + w + 1}, d{a + w + 1};
+			std::snprintf(line, sizeof(line), "f %zu//1 %zu//1 %zu//1 %zu//1\n", a, b, c, d);
+			result += line;
+		}
+	return result;
+}
+
+/* Repeat count of a benchmark from the command line, at least one run to report */
+static int parse_repeats(char const *arg) {
+	int const result{std::stoi(arg)};
+	if (result < 1)
+		throw std::invalid_argument("repeats must be positive");
+	return result;
+}
+
+struct timing {
+	/* seconds */
+	double best, mean;
+	/* seconds of CPU time of the process in the best run, of all its threads */
+	double best_cpu;
+};
+
+static void nothing() {}
+
+/* Times repeats runs of run, calling after between them untimed */
+template<typename Run, typename After = void (*)()>
+static timing time_runs(int repeats, Run const &run, After const &after = nothing) {
+	timing result{0, 0, 0};
+	for (int i{0}; i != repeats; ++i) {
+		std::clock_t const cpu_start{std::clock()};
+		auto const start{std::chrono::steady_clock::now()};
+		run();
+		auto const finish{std::chrono::steady_clock::now()};
+		std::clock_t const cpu_finish{std::clock()};
+		after();
+
+		double const seconds{std::chrono::duration<double>(finish - start).count()};
+		if (i == 0 || seconds < result.best) {
+			result.best = seconds;
+			result.best_cpu = static_cast<double>(cpu_finish - cpu_start) / CLOCKS_PER_SEC;
+		}
+		result.mean += seconds / repeats;
+	}
+	return result;
+}
+
+static void bench_load(std::string const &name, std::string const &obj, int repeats) {
+	size_t verticies{0}, faces{0}, allocated{0};
+	/* reserved up front, so only the allocations of the load are counted */
+	std::vector<Object> result;
+	result.reserve(1);
+	auto const times{time_runs(repeats, [&] {
+		size_t const before{allocations};
+		result.push_back(Object::load(obj.data(), obj.size()));
+		allocated = allocations - before;
+	}, [&] {
+		verticies = result.back().verticies.size();
+		faces = result.back().faces.size();
+		/* freed outside of the time */
+		result.clear();
+	})};
+
+	double const megabytes{obj.size() / 1e6};
+	std::printf(
+		"%s: %.2f MB, %zu verticies, %zu faces\n"
+		"  best %.3f ms (%.1f MB/s), mean %.3f ms, %zu allocations per load\n",
+		name.c_str(), megabytes, verticies, faces,
+		times.best * 1e3, megabytes / times.best, times.mean * 1e3, allocated
+	);
+}
+
+static void convert(std::string const &from, std::string const &to, bool normals, bool colors, bool optimize) {
+	std::string const obj{read_file(from)};
+	Object result{Object::load(obj.data(), obj.size())};
+	if (normals)
+		result.recalculate_normals();
+	if (colors)
+		result.normals_as_colors();
+	if (optimize) {
+		result.optimize_faces();
+		result.optimize_vertex_fetch();
+	}
+
+	std::ofstream f(to, std::ios::binary);
+	result.save_binary(f);
+	if (!f)
+		throw std::runtime_error("Cannot write " + to);
+}
+
+/* Startup cost of both mesh paths up to the point where data would be handed to glBufferData.
+ * The copy into a staging buffer stands in for the upload itself.
+ */
+static void bench_mesh(std::string const &obj_path, std::string const &mesh_path, int repeats) {
+	std::string const obj{read_file(obj_path)};
+	std::vector<char> staging;
+
+	auto measure{[&](char const *name, auto &&load) {
+		double const best{time_runs(repeats, [&] {
+			Object::binary_view const view{load()};
+			size_t const verticies_size{sizeof(Object::vertex_data) * view.verticies_count};
+			size_t const faces_size{sizeof(Object::face) * view.faces_count};
+			staging.resize(verticies_size + faces_size);
+			std::memcpy(staging.data(), view.verticies, verticies_size);
+			std::memcpy(staging.data() + verticies_size, view.faces, faces_size);
+		}).best};
+		std::printf("  %-6s best %.3f ms (%.1f MB/s of mesh data)\n", name, best * 1e3, staging.size() / 1e6 / best);
+	}};
+
+	std::printf("%s vs %s:\n", obj_path.c_str(), mesh_path.c_str());
+	std::unique_ptr<Object> parsed;
+	measure("text", [&] {
+		parsed = std::make_unique<Object>(Object::load(obj.data(), obj.size()));
+		return Object::binary_view{
+			parsed->verticies.data(), parsed->verticies.size(),
+			parsed->faces.data(), parsed->faces.size()
+		};
+	});
+	std::unique_ptr<MappedMesh> mapped;
+	measure("binary", [&] {
+		mapped = nullptr;
+		mapped = std::make_unique<MappedMesh>(mesh_path);
+		return mapped->view();
+	});
+}
+
+/* The scalar single-threaded loop Object::recalculate_normals used to be, for comparison */
+static void recalculate_normals_scalar(Object &o) {
+	std::vector<glm::vec3> new_normals(o.verticies.size());
+	for (size_t id{0}; id != o.faces.size(); ++id) {
+		size_t const i{o.faces[id][0]};
+		size_t const j{o.faces[id][1]};
+		size_t const k{o.faces[id][2]};
+		auto const &a{o.verticies[i].pos};
+		auto const &b{o.verticies[j].pos};
+		auto const &c{o.verticies[k].pos};
+		glm::vec3 norm{glm::normalize(glm::cross(b - a, c - a))};
+
+		new_normals[i] += norm * glm::angle(glm::normalize(b - a), glm::normalize(c - a));
+		new_normals[j] += norm * glm::angle(glm::normalize(a - b), glm::normalize(c - b));
+		new_normals[k] += norm * glm::angle(glm::normalize(a - c), glm::normalize(b - c));
+	}
+	for (size_t i{0}; i != o.verticies.size(); ++i)
+		o.verticies[i].norm = glm::normalize(new_normals[i]);
+}
+
+/* Time of Object::recalculate_normals on 1, 2, 4... threads up to max_threads, against the scalar loop,
+ * and the largest difference of a normal component from it. The CPU time of all the threads next to the wall time
+ * shows how much of the work the cores share.
+ */
+static void bench_normals(std::string const &name, std::string const &obj, int repeats, unsigned max_threads) {
+	Object object{Object::load(obj.data(), obj.size())};
+	std::printf("%s: %zu verticies, %zu faces, %u cores\n", name.c_str(), object.verticies.size(), object.faces.size(), std::thread::hardware_concurrency());
+
+	double const scalar{time_runs(repeats, [&] { recalculate_normals_scalar(object); }).best};
+	std::vector<glm::vec3> reference(object.verticies.size());
+	for (size_t i{0}; i != reference.size(); ++i)
+		reference[i] = object.verticies[i].norm;
+	std::printf("  scalar       best %.3f ms\n", scalar * 1e3);
+
+	double single{0};
+	for (unsigned threads{1};; threads = std::min(2 * threads, max_threads)) {
+		timing const times{time_runs(repeats, [&] { object.recalculate_normals(threads); })};
+		double const seconds{times.best};
+		if (threads == 1)
+			single = seconds;
+		float error{0};
+		for (size_t i{0}; i != reference.size(); ++i) {
+			glm::vec3 const d{object.verticies[i].norm - reference[i]};
+			/* NaN where the scalar loop met a degenerate face */
+			if (reference[i] == reference[i])
+				error = std::max({error, std::abs(d.x), std::abs(d.y), std::abs(d.z)});
+		}
+		std::printf(
+			"  %2u threads   best %.3f ms (%.3f ms CPU), %.2fx of scalar, %.2fx of 1 thread, max difference %.2e\n",
+			threads, seconds * 1e3, times.best_cpu * 1e3, scalar / seconds, single / seconds, error
+		);
+		if (threads == max_threads)
+			break;
+	}
+}
+
+/* Bytes read from the vertex buffer per byte of verticies, through a direct-mapped cache of 64-byte lines */
+static float vertex_overfetch(Object const &o) {
+	size_t constexpr line{64}, lines{256};
+	std::vector<size_t> tags(lines, static_cast<size_t>(-1));
+	size_t fetched{0};
+	for (auto const &f: o.faces)
+		for (size_t c{0}; c != 3; ++c) {
+			size_t const begin{f[c] * sizeof(Object::vertex_data)};
+			for (size_t address{begin / line}; address <= (begin + sizeof(Object::vertex_data) - 1) / line; ++address)
+				if (tags[address % lines] != address) {
+					tags[address % lines] = address;
+					fetched += line;
+				}
+		}
+	return o.verticies.empty() ? 0 : static_cast<float>(fetched) / (o.verticies.size() * sizeof(Object::vertex_data));
+}
+
+/* ACMR and ATVR for several cache sizes and the vertex overfetch, as loaded, after Tipsify alone
+ * and after the whole optimization, with its time
+ */
+static void bench_optimize(std::string const &name, std::string const &obj) {
+	Object const loaded{Object::load(obj.data(), obj.size())};
+	std::printf("%s: %zu verticies, %zu faces\n", name.c_str(), loaded.verticies.size(), loaded.faces.size());
+
+	auto report{[](char const *name, Object const &o) {
+		std::printf("  %-9s", name);
+		for (size_t cache_size: {8, 16, 32}) {
+			auto const stats{o.analyze_vertex_cache(cache_size)};
+			std::printf(" | %.3f %.3f", stats.acmr, stats.atvr);
+		}
+		std::printf(" | %.2f\n", vertex_overfetch(o));
+	}};
+	auto measure{[](Object &o, auto &&optimize) {
+		return time_runs(1, [&] {
+			optimize(o);
+		}).best;
+	}};
+
+	std::printf("  %-9s | ACMR/ATVR 8  | ACMR/ATVR 16 | ACMR/ATVR 32 | overfetch\n", "");
+	report("loaded", loaded);
+	Object tipsify{loaded};
+	double const tipsify_time{measure(tipsify, [](Object &o) {
+		o.optimize_faces(16, 0);
+		o.optimize_vertex_fetch();
+	})};
+	report("tipsify", tipsify);
+	Object optimized{loaded};
+	double const optimized_time{measure(optimized, [](Object &o) {
+		o.optimize_faces();
+		o.optimize_vertex_fetch();
+	})};
+	report("overdraw", optimized);
+	std::printf("  optimized in %.3f ms, %.3f ms without the overdraw step\n", optimized_time * 1e3, tipsify_time * 1e3);
+}
+
+static int usage(char const *self) {
+	std::fprintf(stderr,
+		"Usage:\n"
+		"  %s bench-load <file.obj> [repeats]\n"
+		"  %s bench-load --synthetic <faces> [repeats]\n"
+		"  %s convert [--recalculate-normals] [--normals-as-colors] [--optimize] <file.obj> <file.mesh>\n"
+		"  %s bench-mesh <file.obj> <file.mesh> [repeats]\n"
+		"  %s bench-normals <file.obj> [repeats [max threads]]\n"
+		"  %s bench-normals --synthetic <faces> [repeats [max threads]]\n"
+		"  %s bench-optimize <file.obj>\n"
+		"  %s bench-optimize --synthetic <faces>\n",
+		self, self, self, self, self, self, self, self
+	);
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2)
+		return usage(argv[0]);
+	std::string const command{argv[1]};
+
+	try {
+		if (command == "bench-load" && argc >= 3) {
+			int repeats{5};
+			if (std::string(argv[2]) == "--synthetic") {
+				if (argc < 4)
+					return usage(argv[0]);
+				size_t const faces{std::stoul(argv[3])};
+				if (argc >= 5)
+					repeats = parse_repeats(argv[4]);
+				bench_load("synthetic", synthetic_obj(faces), repeats);
+			} else {
+				if (argc >= 4)
+					repeats = parse_repeats(argv[3]);
+				bench_load(argv[2], read_file(argv[2]), repeats);
+			}
+			return 0;
+		}
+		if (command == "bench-normals" && argc >= 3) {
+			bool const synthetic{std::string(argv[2]) == "--synthetic"};
+			int const first{synthetic ? 4 : 3};
+			if (argc < first)
+				return usage(argv[0]);
+			int const repeats{(argc > first) ? parse_repeats(argv[first]) : 5};
+			/* every core by default */
+			unsigned max_threads{std::max(1u, std::thread::hardware_concurrency())};
+			if (argc > first + 1) {
+				int const given{std::stoi(argv[first + 1])};
+				if (given < 1)
+					throw std::invalid_argument("max threads must be positive");
+				max_threads = given;
+			}
+			if (synthetic)
+				bench_normals("synthetic", synthetic_obj(std::stoul(argv[3])), repeats, max_threads);
+			else
+				bench_normals(argv[2], read_file(argv[2]), repeats, max_threads);
+			return 0;
+		}
+		if (command == "bench-optimize" && argc >= 3) {
+			if (std::string(argv[2]) == "--synthetic") {
+				if (argc < 4)
+					return usage(argv[0]);
+				bench_optimize("synthetic", synthetic_obj(std::stoul(argv[3])));
+			} else {
+				bench_optimize(argv[2], read_file(argv[2]));
+			}
+			return 0;
+		}
+		if (command == "convert") {
+			bool normals{false}, colors{false}, optimize{false};
+			int i{2};
+			for (; i < argc && argv[i][0] == '-'; ++i) {
+				std::string const option{argv[i]};
+				if (option == "--recalculate-normals")
+					normals = true;
+				else if (option == "--normals-as-colors")
+					colors = true;
+				else if (option == "--optimize")
+					optimize = true;
+				else
+					return usage(argv[0]);
+			}
+			if (argc - i != 2)
+				return usage(argv[0]);
+			convert(argv[i], argv[i + 1], normals, colors, optimize);
+			return 0;
+		}
+		if (command == "bench-mesh" && argc >= 4) {
+			bench_mesh(argv[2], argv[3], (argc >= 5) ? parse_repeats(argv[4]) : 5);
+			return 0;
+		}
+	} catch (std::exception const &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return usage(argv[0]);
+}